@@ -1,5 +1,15 @@
 import sys
 import os
+import argparse
+
+parser = argparse.ArgumentParser(prog='build_library_zip')
+parser.add_argument('-windows', action='store_true', help='Building the windows library (passed by Makefile.linux)')
+parser.add_argument('-no-prune', dest='prune', action='store_false', help='Pack whole packages, even modules nothing imports')
+parser.add_argument('-keep', action='append', default=[], help='Package to pack whole (modules imported by name at runtime)')
+parser.add_argument('-scriptlet', action='append', default=[], help='Scriptlet whose generated code is an import root')
+parser.add_argument('-keep-docstrings', dest='strip', action='store_false', help='Store bytecode as compiled, with docstrings and asserts')
+parser.add_argument('-report', help='Write the per package size report to this file too')
+args = parser.parse_args()
 
 sys.path.insert(0, os.path.join('resources','library_patches'))
 sys.path.insert(0, os.path.join('..','..','pupy'))
@@ -8,13 +18,16 @@ import additional_imports
 import Crypto
 import pp
 import unicodedata # this is a builtin on linux and .pyd on windows that needs to be embedded
+
+EXTRA_DEPENDENCIES = [
+    'Crypto', 'yaml', 'rpyc', 'pyasn1', 'rsa',
+    'encodings.idna', 'stringprep',
+]
+
 all_dependencies=set(
     [
         x.split('.')[0] for x,m in sys.modules.iteritems() if not '(built-in)' in str(m) and x != '__main__'
-    ] + [
-        'Crypto', 'yaml', 'rpyc', 'pyasn1', 'rsa',
-        'encodings.idna', 'stringprep',
-    ]
+    ] + EXTRA_DEPENDENCIES
 )
 
 all_dependencies = list(set(all_dependencies))
@@ -28,6 +41,140 @@ from glob import glob
 import zipfile
 import shutil
 import compileall
+import modulefinder
+import ast
+import imp
+import marshal
+import struct
+
+# Packages whose modules are looked up by name at runtime, so the import graph
+# doesn't see them: codecs, and transports enumerated by network.conf
+KEEP_WHOLE = [ 'encodings', 'network' ]
+
+def module_name(zipname):
+    """ a/b/__init__.pyc -> a.b, a/b.so -> a.b """
+    name = zipname.rsplit('.', 1)[0]
+    if name.endswith('/__init__'):
+        name = name[:-9]
+    return name.replace('/', '.')
+
+def package_modules(package):
+    """ dotted names of every module file below an imported package """
+    mod = __import__(package, fromlist=['__name__'])
+    if not hasattr(mod, '__path__'):
+        return [ package ]
+
+    path = os.path.dirname(mod.__path__[0])
+    names = set()
+    for root, dirs, files in os.walk(mod.__path__[0]):
+        for f in files:
+            base, ext = os.path.splitext(f)
+            if ext in ('.py', '.pyc', '.pyo', '.so', '.pyd'):
+                names.add(module_name(
+                    os.path.join(root[len(path)+1:], base + ext).replace('\\', '/')))
+    return names
+
+def scriptlet_code(name):
+    """ code the scriptlet would push, with default arguments """
+    generator = __import__('scriptlets.{}.generator'.format(name), fromlist=['ScriptletGenerator'])
+    return generator.ScriptletGenerator().generate()
+
+def import_closure(keep_whole, scriptlets):
+    """ every module reachable from the bootloader (pupyimporter + pp and what it
+    imports, additional_imports included), the scriptlets and kept packages """
+    finder = modulefinder.ModuleFinder()
+    finder.run_script(os.path.join('..', '..', 'pupy', 'packages', 'all', 'pupyimporter.py'))
+
+    roots = [ 'pp', 'unicodedata' ] + EXTRA_DEPENDENCIES
+    for package in keep_whole:
+        try:
+            roots.extend(package_modules(package))
+        except ImportError as e:
+            print 'KEEP: {} not found: {}'.format(package, e)
+
+    for root in roots:
+        try:
+            finder.import_hook(root)
+        except (ImportError, SyntaxError) as e:
+            print 'PRUNE: {} not followed: {}'.format(root, e)
+
+    for name in scriptlets:
+        try:
+            code = scriptlet_code(name)
+        except Exception as e:
+            print 'SCRIPTLET: {} skipped: {}'.format(name, e)
+            continue
+
+        scriptlet = os.path.join('resources', 'scriptlet_{}.py'.format(name))
+        with open(scriptlet, 'w') as f:
+            f.write(code)
+        try:
+            finder.run_script(scriptlet)
+        finally:
+            os.unlink(scriptlet)
+
+    return set(finder.modules)
+
+class Optimizer(ast.NodeTransformer):
+    """ what -OO does: no docstrings, no asserts """
+
+    def strip_docstring(self, node):
+        self.generic_visit(node)
+        if node.body and isinstance(node.body[0], ast.Expr) and isinstance(node.body[0].value, ast.Str):
+            if len(node.body) > 1:
+                node.body = node.body[1:]
+            else:
+                node.body = [ ast.copy_location(ast.Pass(), node.body[0]) ]
+        return node
+
+    visit_Module = visit_ClassDef = visit_FunctionDef = strip_docstring
+
+    def visit_Assert(self, node):
+        return ast.copy_location(ast.Pass(), node)
+
+def optimized_bytecode(pypath, zipname):
+    """ .pyo contents, or None if the source doesn't compile """
+    with open(pypath, 'rU') as f:
+        source = f.read()
+
+    try:
+        tree = Optimizer().visit(ast.parse(source, zipname))
+        code = compile(tree, zipname, 'exec')
+    except (SyntaxError, TypeError, ValueError) as e:
+        print 'OPTIMIZE: {}: {}'.format(zipname, e)
+        return None
+
+    mtime = int(os.stat(pypath).st_mtime)
+    return imp.get_magic() + struct.pack('<I', mtime & 0xFFFFFFFF) + marshal.dumps(code)
+
+def size_report(zf):
+    """ raw and compressed bytes per top-level package, largest first """
+    packages = {}
+    for info in zf.infolist():
+        package = info.filename.split('/', 1)[0].rsplit('.', 1)[0]
+        files, size, csize = packages.get(package, (0, 0, 0))
+        packages[package] = (files + 1, size + info.file_size, csize + info.compress_size)
+
+    lines = [ '{:<32} {:>6} {:>12} {:>12}'.format('PACKAGE', 'FILES', 'SIZE', 'COMPRESSED') ]
+    for package, (files, size, csize) in sorted(packages.iteritems(), key=lambda x: -x[1][2]):
+        lines.append('{:<32} {:>6} {:>12} {:>12}'.format(package, files, size, csize))
+
+    lines.append('{:<32} {:>6} {:>12} {:>12}'.format(
+        'TOTAL',
+        sum(x[0] for x in packages.itervalues()),
+        sum(x[1] for x in packages.itervalues()),
+        sum(x[2] for x in packages.itervalues())
+    ))
+
+    return '\n'.join(lines)
+
+closure = None
+if args.prune:
+    closure = import_closure(KEEP_WHOLE + args.keep, args.scriptlet)
+    print "CLOSURE: {} modules".format(len(closure))
+
+def reachable(zipname):
+    return closure is None or module_name(zipname) in closure
 
 zf = zipfile.ZipFile(os.path.join('resources','library.zip'), mode='w', compression=zipfile.ZIP_DEFLATED)
 
@@ -50,7 +197,15 @@ try:
 
                         pypath = os.path.join(root,f+ext)
                         if os.path.exists(pypath):
-                            if ext == '.py':
+                            bytecode = None
+                            source = os.path.join(root,f+'.py')
+                            if args.strip and ext in ('.pyo', '.pyc', '.py') and os.path.exists(source):
+                                bytecode = optimized_bytecode(source, '/'.join([root[len(path)+1:], f + '.py']).replace('\\', '/'))
+                                # otherwise the file as found, compiled below if it's the source
+                                if bytecode is not None:
+                                    ext = '.pyo'
+
+                            if bytecode is None and ext == '.py':
                                 compileall.compile_file(pypath)
                                 for extc in ( '.pyc', '.pyo' ):
                                     if os.path.exists(os.path.join(root,f+extc)):
@@ -67,15 +222,41 @@ try:
                             ]):
                                 continue
 
+                            if not reachable(zipname):
+                                print('pruning file : {}'.format(zipname))
+                                continue
+
                             print('adding file : {}'.format(zipname))
-                            zf.write(os.path.join(root,f+ext), zipname)
+                            if bytecode is not None:
+                                zf.writestr(zipname, bytecode)
+                            else:
+                                zf.write(os.path.join(root,f+ext), zipname)
         else:
             if '<memimport>' in mdep.__file__:
                 continue
 
+            if not reachable(dep + '.py'):
+                print('pruning %s'%dep)
+                continue
+
             _, ext = os.path.splitext(mdep.__file__)
-            print('adding %s -> %s'%(mdep.__file__, dep+ext))
-            zf.write(mdep.__file__, dep+ext)
+            source = os.path.splitext(mdep.__file__)[0] + '.py'
+            bytecode = None
+            if args.strip and ext in ('.pyo', '.pyc', '.py') and os.path.exists(source):
+                bytecode = optimized_bytecode(source, dep + '.py')
+
+            if bytecode is not None:
+                print('adding %s -> %s'%(source, dep+'.pyo'))
+                zf.writestr(dep+'.pyo', bytecode)
+            else:
+                print('adding %s -> %s'%(mdep.__file__, dep+ext))
+                zf.write(mdep.__file__, dep+ext)
+
+    report = size_report(zf)
+    print report
+    if args.report:
+        with open(args.report, 'w') as f:
+            f.write(report + '\n')
 
 finally:
     zf.close()
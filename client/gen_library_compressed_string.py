@@ -1,10 +1,31 @@
 #!/usr/bin/env python
 # -*- coding: utf-8 -*-
 import StringIO, zipfile, os.path, imp, sys
-import marshal
-import zlib
+import struct
+import argparse
 
-def get_encoded_library_string():
+try:
+	from resource_codec import compress
+except ImportError:
+	import zlib
+	compress = lambda data, codec: zlib.compress(data, 9)
+
+# Indexed library archive (all integers are little-endian uint32):
+#
+#   header  : magic 'PLB1', count
+#   table   : count * (name_offset, name_size, data_offset, csize, usize)
+#   names   : NUL-terminated module paths, sorted
+#   data    : every entry compressed on its own (zlib, or LZ4 frames with
+#             -codec lz4; the linux loader tells them apart by magic)
+#
+# Offsets are relative to the start of the archive. The table is sorted by
+# name, so the client can look up (and inflate) a single module on demand.
+
+LIBRARY_MAGIC = 'PLB1'
+LIBRARY_HEADER = struct.Struct('<4sI')
+LIBRARY_ENTRY = struct.Struct('<IIIII')
+
+def get_library_modules():
 	filepath=None
 	filepath=os.path.join("resources","library.zip")
 
@@ -13,14 +34,48 @@ def get_encoded_library_string():
 
 	zip = zipfile.ZipFile(f)
 
-	modules = dict([
+	return dict([
 		(z.filename, zip.open(z.filename,).read()) for z in zip.infolist() \
 		if os.path.splitext(z.filename)[1] in [
 			'.py', '.pyd', '.dll', '.pyc', '.pyo', '.so'
 		]
 	])
 
-	return zlib.compress(marshal.dumps(modules),9)
+def get_encoded_library_string(modules, codec='zlib'):
+	names = sorted(modules.iterkeys())
+
+	table = []
+	names_blob = []
+	data_blob = []
+
+	names_offset = LIBRARY_HEADER.size + LIBRARY_ENTRY.size * len(names)
+	names_size = sum([ len(name) + 1 for name in names ])
+	data_offset = names_offset + names_size
+
+	for name in names:
+		content = modules[name]
+		compressed = compress(content, codec)
+		table.append(LIBRARY_ENTRY.pack(
+			names_offset, len(name), data_offset, len(compressed), len(content)
+		))
+		names_blob.append(name + '\0')
+		data_blob.append(compressed)
+		names_offset += len(name) + 1
+		data_offset += len(compressed)
+
+	return ''.join(
+		[ LIBRARY_HEADER.pack(LIBRARY_MAGIC, len(names)) ] + table + names_blob + data_blob
+	)
+
+if __name__=="__main__":
+	parser = argparse.ArgumentParser(prog='gen_library_compressed_string')
+	parser.add_argument(
+		'-codec',
+		choices=('zlib', 'lz4'),
+		default='zlib',
+		help='Per-module codec (windows loader supports zlib only)'
+	)
+	args = parser.parse_args()
 
-with open(os.path.join("resources","library_compressed_string.txt"),'wb') as w:
-	w.write(get_encoded_library_string())
+	with open(os.path.join("resources","library_compressed_string.txt"),'wb') as w:
+		w.write(get_encoded_library_string(get_library_modules(), args.codec))
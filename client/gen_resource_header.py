@@ -1,29 +1,87 @@
 #!/usr/bin/env python
 # -*- coding: UTF8 -*-
 import sys
-import binascii
+import argparse
+
+try:
+	from resource_codec import compress, CODECS
+except ImportError:
+	CODECS = ( 'none', )
+	compress = lambda data, codec: data
 
 MAX_CHAR_PER_LINE=50
 
+C_BYTES = [ "'\\x%02x',"%i for i in xrange(256) ]
+
+def c_source(name, file_bytes):
+	""" char array with a trailing NUL, one line per MAX_CHAR_PER_LINE bytes """
+	lines = [
+		''.join(C_BYTES[c] for c in bytearray(file_bytes[i:i+MAX_CHAR_PER_LINE]))
+		for i in xrange(0, len(file_bytes), MAX_CHAR_PER_LINE)
+	]
+
+	return ''.join([
+		"int %s_size = %s;"%(name, len(file_bytes)),
+		"\nchar %s_start[] = {\n"%name,
+		'\n'.join(lines),
+		"\n'\\x00' };\n"
+	])
+
+def asm_source(name, path, size):
+	""" GNU as stub which pulls the file in with .incbin, so neither python
+	nor the compiler ever see the bytes. Symbols are the same as with the C
+	array, including the trailing NUL which is not counted in _size """
+	return '\n'.join([
+		'\t.section .rodata',
+		'\t.global %s_start'%name,
+		'\t.type %s_start, @object'%name,
+		'\t.balign 16',
+		'%s_start:'%name,
+		'\t.incbin "%s"'%path.replace('\\', '/'),
+		'\t.byte 0',
+		'\t.size %s_start, .-%s_start'%(name, name),
+		'',
+		'\t.global %s_size'%name,
+		'\t.type %s_size, @object'%name,
+		'\t.balign 4',
+		'%s_size:'%name,
+		'\t.int %d'%size,
+		'\t.size %s_size, 4'%name,
+		'',
+		'\t.section .note.GNU-stack,"",@progbits',
+		''
+	])
+
 if __name__=="__main__":
-	h_file=""
-	file_bytes=b""
-	with open(sys.argv[1], "rb") as f:
-		file_bytes=f.read()
-	h_file += "int %s_size = %s;"%(sys.argv[1].replace(".","_").replace("\\","_").replace("/","_"), len(file_bytes))
-	h_file += "\nchar %s_start[] = {\n"%sys.argv[1].replace(".","_").replace("\\","_").replace("/","_")
-	current_size=0
-
-	for c in file_bytes:
-		h_file+="'\\x%s',"%binascii.hexlify(c)
-		current_size+=1
-		if current_size>MAX_CHAR_PER_LINE:
-			current_size=0
-			h_file+="\n"
-		
-	h_file += "'\\x00' };\n"
-
-	with open(sys.argv[1].replace(".","_").replace("\\","_").replace("/","_")+".c",'w') as w:
-		w.write(h_file)
-		
-	
+	parser = argparse.ArgumentParser(prog='gen_resource_header')
+	parser.add_argument(
+		'-codec',
+		choices=CODECS,
+		default='none',
+		help='Compress the resource before embedding it'
+	)
+	parser.add_argument(
+		'-format',
+		choices=( 'c', 'asm' ),
+		default='c',
+		help='Emit a C array (<name>.c) or an assembler .incbin stub (<name>.S)'
+	)
+	parser.add_argument('resource')
+	args = parser.parse_args()
+	name = args.resource.replace(".","_").replace("\\","_").replace("/","_")
+
+	with open(args.resource, "rb") as f:
+		file_bytes=compress(f.read(), args.codec)
+
+	if args.format == 'asm':
+		path = args.resource
+		if args.codec != 'none':
+			path = name+".bin"
+			with open(path, 'wb') as w:
+				w.write(file_bytes)
+
+		with open(name+".S",'w') as w:
+			w.write(asm_source(name, path, len(file_bytes)))
+	else:
+		with open(name+".c",'w') as w:
+			w.write(c_source(name, file_bytes))
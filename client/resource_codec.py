@@ -0,0 +1,56 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+import zlib
+import gzip
+import StringIO
+import tempfile
+import subprocess
+
+# Codecs understood by the loader (client/sources-linux/decompress.c picks
+# one by magic bytes). Windows loader only knows zlib/gzip.
+
+CODECS = ( 'none', 'zlib', 'gzip', 'lz4' )
+
+def lz4_compress(data):
+	try:
+		import lz4.frame
+		return lz4.frame.compress(
+			data, compression_level=lz4.frame.COMPRESSIONLEVEL_MAX,
+			store_size=True
+		)
+	except ImportError:
+		pass
+
+	# The loader needs the content size in the frame header, lz4 tool
+	# stores it only when reading from a regular file
+	with tempfile.NamedTemporaryFile() as source:
+		source.write(data)
+		source.flush()
+
+		lz4 = subprocess.Popen(
+			[ 'lz4', '-9', '-q', '--content-size', '-c', source.name ],
+			stdout=subprocess.PIPE
+		)
+		compressed, _ = lz4.communicate()
+		if lz4.returncode:
+			raise ValueError('lz4 failed with code {}'.format(lz4.returncode))
+
+	return compressed
+
+def gzip_compress(data):
+	f = StringIO.StringIO()
+	with gzip.GzipFile(fileobj=f, mode='wb', compresslevel=9, mtime=0) as z:
+		z.write(data)
+	return f.getvalue()
+
+def compress(data, codec):
+	if codec == 'none':
+		return data
+	elif codec == 'zlib':
+		return zlib.compress(data, 9)
+	elif codec == 'gzip':
+		return gzip_compress(data)
+	elif codec == 'lz4':
+		return lz4_compress(data)
+	else:
+		raise ValueError('Unknown codec: {}'.format(codec))
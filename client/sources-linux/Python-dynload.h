@@ -53,6 +53,14 @@ extern void Py_XDECREF(PyObject *ob);
 #define PyInt_Check(op) PyObject_IsInstance(op, &PyInt_Type) /* ??? */
 #define Py_None (&_Py_NoneStruct)
 
+/* Object header of release builds, for exact type checks */
+typedef struct {
+	Py_ssize_t ob_refcnt;
+	PyObject *ob_type;
+} PyObject_HEAD_LAYOUT;
+
+#define Py_TYPE(op) (((PyObject_HEAD_LAYOUT *)(op))->ob_type)
+
 #define DL_EXPORT(x) x
 
 #define Py_InitModule3(name, methods, doc) \
@@ -0,0 +1,732 @@
+#ifdef STANDALONE
+#  include <Python.h>
+typedef PyTypeObject type_t;
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef STANDALONE
+#  include "Python-dynload.h"
+typedef PyObject type_t;
+#endif
+
+static char module_doc[] =
+"rpyc brine dump/load, installed by network/lib/brine.py";
+
+/* Built with STANDALONE as a regular extension for the server, see pupy/setup.py */
+
+/*
+
+  Same wire format as rpyc.core.brine: a one byte tag per object, small
+  ints are the tag itself, lengths and doubles are big endian. Objects
+  are dispatched on their exact type like brine does (bool is not an
+  int, subclasses are not dumpable).
+
+*/
+
+#define TAG_NONE            0x00
+#define TAG_EMPTY_STR       0x01
+#define TAG_EMPTY_TUPLE     0x02
+#define TAG_TRUE            0x03
+#define TAG_FALSE           0x04
+#define TAG_NOT_IMPLEMENTED 0x05
+#define TAG_ELLIPSIS        0x06
+#define TAG_UNICODE         0x08
+#define TAG_LONG            0x09
+#define TAG_STR1            0x0a
+#define TAG_STR_L1          0x0e
+#define TAG_STR_L4          0x0f
+#define TAG_TUP1            0x10
+#define TAG_TUP_L1          0x14
+#define TAG_TUP_L4          0x15
+#define TAG_INT_L1          0x16
+#define TAG_INT_L4          0x17
+#define TAG_FLOAT           0x18
+#define TAG_SLICE           0x19
+#define TAG_FSET            0x1a
+#define TAG_COMPLEX         0x1b
+
+/* ints -0x30..0x9f are dumped as the single byte value + 0x50 */
+#define IMM_INT_MIN  (-0x30)
+#define IMM_INT_MAX  0x9f
+#define IMM_INT_BIAS 0x50
+#define IMM_TAG_MIN  (IMM_INT_MIN + IMM_INT_BIAS)
+#define IMM_TAG_MAX  (IMM_INT_MAX + IMM_INT_BIAS)
+
+#define MAX_DEPTH 1024
+#define MAX_INT_REPR 64
+
+static int little_endian;
+
+typedef struct output {
+	unsigned char *data;
+	size_t size;
+	size_t capacity;
+} output_t;
+
+typedef struct input {
+	const unsigned char *data;
+	size_t size;
+	size_t pos;
+} input_t;
+
+static int out_reserve(output_t *out, size_t size)
+{
+	size_t capacity;
+	unsigned char *data;
+
+	if (out->size + size <= out->capacity)
+		return 0;
+
+	capacity = out->capacity? out->capacity : 256;
+	while (capacity < out->size + size)
+		capacity <<= 1;
+
+	data = realloc(out->data, capacity);
+	if (!data) {
+		PyErr_SetString(PyExc_Exception, "out of memory");
+		return -1;
+	}
+
+	out->data = data;
+	out->capacity = capacity;
+	return 0;
+}
+
+static int out_put(output_t *out, const void *data, size_t size)
+{
+	if (out_reserve(out, size) == -1)
+		return -1;
+
+	memcpy(out->data + out->size, data, size);
+	out->size += size;
+	return 0;
+}
+
+static int out_byte(output_t *out, unsigned char byte)
+{
+	if (out_reserve(out, 1) == -1)
+		return -1;
+
+	out->data[out->size++] = byte;
+	return 0;
+}
+
+/* tag_l1 with a one byte length below 256, tag_l4 with four bytes otherwise */
+static int out_length(output_t *out, unsigned char tag_l1, unsigned char tag_l4, size_t length)
+{
+	unsigned char header[5];
+
+	if (length < 256) {
+		header[0] = tag_l1;
+		header[1] = (unsigned char) length;
+		return out_put(out, header, 2);
+	}
+
+	if (length > 0xFFFFFFFFUL) {
+		PyErr_SetString(PyExc_Exception, "brine: object too large");
+		return -1;
+	}
+
+	header[0] = tag_l4;
+	header[1] = (unsigned char) (length >> 24);
+	header[2] = (unsigned char) (length >> 16);
+	header[3] = (unsigned char) (length >> 8);
+	header[4] = (unsigned char) length;
+	return out_put(out, header, 5);
+}
+
+static int out_double(output_t *out, double value)
+{
+	unsigned char bytes[8];
+	unsigned char swapped[8];
+	int i;
+
+	memcpy(bytes, &value, sizeof(bytes));
+	if (!little_endian)
+		return out_put(out, bytes, sizeof(bytes));
+
+	for (i = 0; i < 8; i++)
+		swapped[i] = bytes[7 - i];
+
+	return out_put(out, swapped, sizeof(swapped));
+}
+
+static int dump_str(output_t *out, const char *data, size_t size)
+{
+	int err;
+
+	if (size == 0)
+		return out_byte(out, TAG_EMPTY_STR);
+
+	if (size <= 4)
+		err = out_byte(out, (unsigned char) (TAG_STR1 + size - 1));
+	else
+		err = out_length(out, TAG_STR_L1, TAG_STR_L4, size);
+
+	if (err == -1)
+		return -1;
+
+	return out_put(out, data, size);
+}
+
+/* decimal repr, or the immediate tag when it's a small int */
+static int dump_int_repr(output_t *out, const char *repr, size_t size)
+{
+	char *end;
+	long value;
+
+	if (size <= 4) {
+		value = strtol(repr, &end, 10);
+		if (end == repr + size && value >= IMM_INT_MIN && value <= IMM_INT_MAX)
+			return out_byte(out, (unsigned char) (value + IMM_INT_BIAS));
+	}
+
+	if (out_length(out, TAG_INT_L1, TAG_INT_L4, size) == -1)
+		return -1;
+
+	return out_put(out, repr, size);
+}
+
+static int dump_object(output_t *out, PyObject *obj, int depth);
+
+static int dump_items(output_t *out, PyObject *tuple, int depth)
+{
+	Py_ssize_t size = PyTuple_Size(tuple);
+	Py_ssize_t i;
+	int err;
+
+	if (size == 0)
+		return out_byte(out, TAG_EMPTY_TUPLE);
+
+	if (size <= 4)
+		err = out_byte(out, (unsigned char) (TAG_TUP1 + size - 1));
+	else
+		err = out_length(out, TAG_TUP_L1, TAG_TUP_L4, size);
+
+	if (err == -1)
+		return -1;
+
+	for (i = 0; i < size; i++)
+		if (dump_object(out, PyTuple_GetItem(tuple, i), depth + 1) == -1)
+			return -1;
+
+	return 0;
+}
+
+static int dump_slice(output_t *out, PyObject *obj, int depth)
+{
+	static char *fields[] = { "start", "stop", "step" };
+	PyObject *field;
+	int i;
+
+	if (out_byte(out, TAG_SLICE) == -1 || out_byte(out, TAG_TUP1 + 2) == -1)
+		return -1;
+
+	for (i = 0; i < 3; i++) {
+		field = PyObject_GetAttrString(obj, fields[i]);
+		if (!field)
+			return -1;
+
+		if (dump_object(out, field, depth + 1) == -1) {
+			Py_DECREF(field);
+			return -1;
+		}
+
+		Py_DECREF(field);
+	}
+
+	return 0;
+}
+
+static int undumpable(PyObject *obj)
+{
+	PyObject *name = PyObject_GetAttrString((PyObject *) Py_TYPE(obj), "__name__");
+
+	if (name) {
+		PyErr_Format(PyExc_TypeError, "cannot dump %s", PyString_AsString(name));
+		Py_DECREF(name);
+	}
+
+	return -1;
+}
+
+static int dump_object(output_t *out, PyObject *obj, int depth)
+{
+	type_t *type = Py_TYPE(obj);
+	PyObject *tmp;
+	char *data;
+	Py_ssize_t size;
+	char repr[MAX_INT_REPR];
+	long value;
+	int err;
+
+	if (depth > MAX_DEPTH) {
+		PyErr_SetString(PyExc_Exception, "brine: object nested too deep");
+		return -1;
+	}
+
+	if (type == &PyString_Type) {
+		if (PyString_AsStringAndSize(obj, &data, &size) == -1)
+			return -1;
+		return dump_str(out, data, size);
+	}
+
+	if (type == &PyInt_Type) {
+		value = PyInt_AsLong(obj);
+		if (value >= IMM_INT_MIN && value <= IMM_INT_MAX)
+			return out_byte(out, (unsigned char) (value + IMM_INT_BIAS));
+
+		size = snprintf(repr, sizeof(repr), "%ld", value);
+		return dump_int_repr(out, repr, size);
+	}
+
+	if (type == &PyTuple_Type)
+		return dump_items(out, obj, depth);
+
+	if (obj == Py_None)
+		return out_byte(out, TAG_NONE);
+
+	if (type == &PyBool_Type)
+		return out_byte(out, obj == (PyObject *) &_Py_TrueStruct? TAG_TRUE : TAG_FALSE);
+
+	if (type == &PyLong_Type) {
+		tmp = PyObject_Str(obj);
+		if (!tmp)
+			return -1;
+
+		err = -1;
+		if (out_byte(out, TAG_LONG) != -1 &&
+			PyString_AsStringAndSize(tmp, &data, &size) != -1)
+			err = dump_int_repr(out, data, size);
+
+		Py_DECREF(tmp);
+		return err;
+	}
+
+	if (type == &PyUnicode_Type) {
+		tmp = PyObject_CallMethod(obj, "encode", "s", "utf-8");
+		if (!tmp)
+			return -1;
+
+		err = -1;
+		if (out_byte(out, TAG_UNICODE) != -1 &&
+			PyString_AsStringAndSize(tmp, &data, &size) != -1)
+			err = dump_str(out, data, size);
+
+		Py_DECREF(tmp);
+		return err;
+	}
+
+	if (type == &PyFloat_Type) {
+		if (out_byte(out, TAG_FLOAT) == -1)
+			return -1;
+		return out_double(out, PyFloat_AsDouble(obj));
+	}
+
+	if (type == &PyComplex_Type) {
+		if (out_byte(out, TAG_COMPLEX) == -1 ||
+			out_double(out, PyComplex_RealAsDouble(obj)) == -1)
+			return -1;
+		return out_double(out, PyComplex_ImagAsDouble(obj));
+	}
+
+	if (type == &PyFrozenSet_Type) {
+		tmp = PySequence_Tuple(obj);
+		if (!tmp)
+			return -1;
+
+		err = -1;
+		if (out_byte(out, TAG_FSET) != -1)
+			err = dump_items(out, tmp, depth);
+
+		Py_DECREF(tmp);
+		return err;
+	}
+
+	if (type == &PySlice_Type)
+		return dump_slice(out, obj, depth);
+
+	if (obj == &_Py_NotImplementedStruct)
+		return out_byte(out, TAG_NOT_IMPLEMENTED);
+
+	if (obj == &_Py_EllipsisObject)
+		return out_byte(out, TAG_ELLIPSIS);
+
+	return undumpable(obj);
+}
+
+static const unsigned char *in_read(input_t *in, size_t size)
+{
+	const unsigned char *data;
+
+	if (in->size - in->pos < size) {
+		PyErr_SetString(PyExc_Exception, "brine: truncated data");
+		return NULL;
+	}
+
+	data = in->data + in->pos;
+	in->pos += size;
+	return data;
+}
+
+static int in_length(input_t *in, int l4, size_t *length)
+{
+	const unsigned char *data = in_read(in, l4? 4 : 1);
+
+	if (!data)
+		return -1;
+
+	if (l4)
+		*length = ((size_t) data[0] << 24) | ((size_t) data[1] << 16) |
+			((size_t) data[2] << 8) | (size_t) data[3];
+	else
+		*length = data[0];
+
+	return 0;
+}
+
+static int in_double(input_t *in, double *value)
+{
+	const unsigned char *data = in_read(in, 8);
+	unsigned char bytes[8];
+	int i;
+
+	if (!data)
+		return -1;
+
+	for (i = 0; i < 8; i++)
+		bytes[i] = little_endian? data[7 - i] : data[i];
+
+	memcpy(value, bytes, sizeof(bytes));
+	return 0;
+}
+
+static PyObject *load_object(input_t *in, int depth);
+
+static PyObject *load_str(input_t *in, size_t size)
+{
+	const unsigned char *data = in_read(in, size);
+
+	if (!data)
+		return NULL;
+
+	return PyString_FromStringAndSize((const char *) data, size);
+}
+
+static PyObject *load_int(input_t *in, size_t size)
+{
+	const unsigned char *data = in_read(in, size);
+	char stack_repr[MAX_INT_REPR];
+	char *repr = stack_repr;
+	char *end;
+	long value;
+	PyObject *result;
+
+	if (!data)
+		return NULL;
+
+	if (size >= sizeof(stack_repr)) {
+		repr = malloc(size + 1);
+		if (!repr) {
+			PyErr_SetString(PyExc_Exception, "out of memory");
+			return NULL;
+		}
+	}
+
+	memcpy(repr, data, size);
+	repr[size] = '\0';
+
+	/* int() of a repr that doesn't fit a C long is a long */
+	errno = 0;
+	value = strtol(repr, &end, 10);
+	if (size && end == repr + size && errno != ERANGE)
+		result = PyInt_FromLong(value);
+	else
+		result = PyLong_FromString(repr, NULL, 10);
+
+	if (repr != stack_repr)
+		free(repr);
+
+	return result;
+}
+
+static PyObject *load_tuple(input_t *in, size_t size, int depth)
+{
+	PyObject *tuple;
+	PyObject *item;
+	size_t i;
+
+	/* every item is at least one byte */
+	if (in->size - in->pos < size) {
+		PyErr_SetString(PyExc_Exception, "brine: truncated data");
+		return NULL;
+	}
+
+	tuple = PyTuple_New(size);
+	if (!tuple)
+		return NULL;
+
+	for (i = 0; i < size; i++) {
+		item = load_object(in, depth + 1);
+		if (!item) {
+			Py_DECREF(tuple);
+			return NULL;
+		}
+		PyTuple_SetItem(tuple, i, item);
+	}
+
+	return tuple;
+}
+
+static PyObject *load_wrapped(input_t *in, int tag, int depth)
+{
+	PyObject *inner = load_object(in, depth + 1);
+	PyObject *result = NULL;
+
+	if (!inner)
+		return NULL;
+
+	switch (tag) {
+	case TAG_UNICODE:
+		result = PyObject_CallMethod(inner, "decode", "s", "utf-8");
+		break;
+
+	case TAG_LONG:
+		result = PyNumber_Long(inner);
+		break;
+
+	case TAG_FSET:
+		result = PyFrozenSet_New(inner);
+		break;
+
+	case TAG_SLICE:
+		if (Py_TYPE(inner) != &PyTuple_Type || PyTuple_Size(inner) != 3) {
+			PyErr_SetString(PyExc_Exception, "brine: invalid slice");
+			break;
+		}
+
+		result = PySlice_New(
+			PyTuple_GetItem(inner, 0),
+			PyTuple_GetItem(inner, 1),
+			PyTuple_GetItem(inner, 2)
+		);
+		break;
+	}
+
+	Py_DECREF(inner);
+	return result;
+}
+
+static PyObject *load_object(input_t *in, int depth)
+{
+	const unsigned char *data;
+	size_t length;
+	double real, imag;
+	int tag;
+
+	if (depth > MAX_DEPTH) {
+		PyErr_SetString(PyExc_Exception, "brine: object nested too deep");
+		return NULL;
+	}
+
+	data = in_read(in, 1);
+	if (!data)
+		return NULL;
+
+	tag = *data;
+
+	if (tag >= IMM_TAG_MIN && tag <= IMM_TAG_MAX)
+		return PyInt_FromLong(tag - IMM_INT_BIAS);
+
+	switch (tag) {
+	case TAG_NONE:
+		Py_INCREF(Py_None);
+		return Py_None;
+
+	case TAG_EMPTY_STR:
+		return PyString_FromStringAndSize("", 0);
+
+	case TAG_EMPTY_TUPLE:
+		return PyTuple_New(0);
+
+	case TAG_TRUE:
+	case TAG_FALSE:
+		return PyBool_FromLong(tag == TAG_TRUE);
+
+	case TAG_NOT_IMPLEMENTED:
+		Py_INCREF(&_Py_NotImplementedStruct);
+		return &_Py_NotImplementedStruct;
+
+	case TAG_ELLIPSIS:
+		Py_INCREF(&_Py_EllipsisObject);
+		return &_Py_EllipsisObject;
+
+	case TAG_STR1:
+	case TAG_STR1 + 1:
+	case TAG_STR1 + 2:
+	case TAG_STR1 + 3:
+		return load_str(in, tag - TAG_STR1 + 1);
+
+	case TAG_STR_L1:
+	case TAG_STR_L4:
+		if (in_length(in, tag == TAG_STR_L4, &length) == -1)
+			return NULL;
+		return load_str(in, length);
+
+	case TAG_TUP1:
+	case TAG_TUP1 + 1:
+	case TAG_TUP1 + 2:
+	case TAG_TUP1 + 3:
+		return load_tuple(in, tag - TAG_TUP1 + 1, depth);
+
+	case TAG_TUP_L1:
+	case TAG_TUP_L4:
+		if (in_length(in, tag == TAG_TUP_L4, &length) == -1)
+			return NULL;
+		return load_tuple(in, length, depth);
+
+	case TAG_INT_L1:
+	case TAG_INT_L4:
+		if (in_length(in, tag == TAG_INT_L4, &length) == -1)
+			return NULL;
+		return load_int(in, length);
+
+	case TAG_FLOAT:
+		if (in_double(in, &real) == -1)
+			return NULL;
+		return PyFloat_FromDouble(real);
+
+	case TAG_COMPLEX:
+		if (in_double(in, &real) == -1 || in_double(in, &imag) == -1)
+			return NULL;
+		return PyComplex_FromDoubles(real, imag);
+
+	case TAG_UNICODE:
+	case TAG_LONG:
+	case TAG_SLICE:
+	case TAG_FSET:
+		return load_wrapped(in, tag, depth);
+	}
+
+	PyErr_Format(PyExc_Exception, "brine: unknown tag 0x%02x", tag);
+	return NULL;
+}
+
+static int is_dumpable(PyObject *obj, int depth)
+{
+	type_t *type = Py_TYPE(obj);
+	PyObject *tmp;
+	Py_ssize_t i;
+	int result;
+
+	if (depth > MAX_DEPTH)
+		return 0;
+
+	if (type == &PyString_Type || type == &PyInt_Type || obj == Py_None ||
+		type == &PyBool_Type || type == &PyLong_Type || type == &PyUnicode_Type ||
+		type == &PyFloat_Type || type == &PyComplex_Type ||
+		obj == &_Py_NotImplementedStruct || obj == &_Py_EllipsisObject)
+		return 1;
+
+	if (type == &PyTuple_Type) {
+		for (i = 0; i < PyTuple_Size(obj); i++)
+			if (!is_dumpable(PyTuple_GetItem(obj, i), depth + 1))
+				return 0;
+		return 1;
+	}
+
+	if (type == &PyFrozenSet_Type) {
+		tmp = PySequence_Tuple(obj);
+		if (!tmp) {
+			PyErr_Clear();
+			return 0;
+		}
+
+		result = is_dumpable(tmp, depth);
+		Py_DECREF(tmp);
+		return result;
+	}
+
+	if (type == &PySlice_Type) {
+		tmp = Py_BuildValue("(NNN)",
+			PyObject_GetAttrString(obj, "start"),
+			PyObject_GetAttrString(obj, "stop"),
+			PyObject_GetAttrString(obj, "step"));
+		if (!tmp) {
+			PyErr_Clear();
+			return 0;
+		}
+
+		result = is_dumpable(tmp, depth);
+		Py_DECREF(tmp);
+		return result;
+	}
+
+	return 0;
+}
+
+static PyObject *Py_dump(PyObject *self, PyObject *args)
+{
+	PyObject *obj;
+	PyObject *result = NULL;
+	output_t out = { NULL, 0, 0 };
+
+	if (!PyArg_ParseTuple(args, "O", &obj))
+		return NULL;
+
+	if (dump_object(&out, obj, 0) != -1)
+		result = PyString_FromStringAndSize((const char *) out.data, out.size);
+
+	free(out.data);
+	return result;
+}
+
+static PyObject *Py_load(PyObject *self, PyObject *args)
+{
+	const char *data;
+	int size;
+	input_t in;
+
+	if (!PyArg_ParseTuple(args, "s#", &data, &size))
+		return NULL;
+
+	in.data = (const unsigned char *) data;
+	in.size = size;
+	in.pos = 0;
+
+	return load_object(&in, 0);
+}
+
+static PyObject *Py_dumpable(PyObject *self, PyObject *args)
+{
+	PyObject *obj;
+
+	if (!PyArg_ParseTuple(args, "O", &obj))
+		return NULL;
+
+	return PyBool_FromLong(is_dumpable(obj, 0));
+}
+
+static PyMethodDef methods[] = {
+	{ "dump", Py_dump, METH_VARARGS, "dump(obj) -> brine encoded string" },
+	{ "load", Py_load, METH_VARARGS, "load(data) -> obj" },
+	{ "dumpable", Py_dumpable, METH_VARARGS, "dumpable(obj) -> True if dump would encode it" },
+	{ NULL, NULL },		/* Sentinel */
+};
+
+DL_EXPORT(void)
+init_pupybrine(void)
+{
+	union {
+		unsigned short value;
+		unsigned char bytes[2];
+	} probe;
+
+	probe.value = 1;
+	little_endian = probe.bytes[0];
+
+	Py_InitModule3("_pupybrine", methods, module_doc);
+}
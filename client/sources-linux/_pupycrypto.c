@@ -0,0 +1,897 @@
+#ifdef STANDALONE
+#  include <Python.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRYPTO_AESNI
+#endif
+
+#ifndef STANDALONE
+#  include "Python-dynload.h"
+#endif
+
+#include "handles.h"
+
+static char module_doc[] =
+"AES-CBC/CTR, SHA256, HMAC-SHA256 and PBKDF2 for network/lib/transports";
+
+/* Built with STANDALONE as a regular extension for the server, see pupy/setup.py */
+
+/*
+
+  Handle based API like _pupybuffer: CBC carries the last cipher block and
+  CTR the counter and unused keystream from one call to the next, so a
+  handle stands for one direction of a stream.
+
+  AES is the usual four tables implementation, with tables generated at
+  init instead of being embedded. The decryption key schedule already has
+  InvMixColumns applied, which is the layout both the equivalent inverse
+  cipher and AESDEC expect, so the AES-NI kernels share it.
+
+*/
+
+#define AES_BLOCK 16
+#define AES_MAX_ROUNDS 14
+
+#define SHA256_BLOCK 64
+#define SHA256_DIGEST 32
+
+#define GETU32(p) \
+	(((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | \
+	 ((uint32_t) (p)[2] << 8) | (uint32_t) (p)[3])
+
+#define PUTU32(p, v) do { \
+	(p)[0] = (uint8_t) ((v) >> 24); (p)[1] = (uint8_t) ((v) >> 16); \
+	(p)[2] = (uint8_t) ((v) >> 8); (p)[3] = (uint8_t) (v); \
+} while (0)
+
+typedef enum {
+	AES_MODE_CBC,
+	AES_MODE_CTR
+} aes_mode_t;
+
+typedef struct aes {
+	uint8_t ek[AES_MAX_ROUNDS + 1][AES_BLOCK];
+	uint8_t dk[AES_MAX_ROUNDS + 1][AES_BLOCK];
+	int rounds;
+	aes_mode_t mode;
+	uint8_t iv[AES_BLOCK];     /* CBC: last cipher block, CTR: next counter */
+	uint8_t stream[AES_BLOCK]; /* CTR: keystream of the previous counter */
+	size_t used;
+} aes_t;
+
+static uint8_t S[256];
+static uint8_t Si[256];
+static uint32_t Te[4][256];
+static uint32_t Td[4][256];
+
+static uint8_t xtime(uint8_t x)
+{
+	return (uint8_t) ((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+}
+
+static uint8_t gmul(uint8_t a, uint8_t b)
+{
+	uint8_t p = 0;
+
+	while (b) {
+		if (b & 1)
+			p ^= a;
+		a = xtime(a);
+		b >>= 1;
+	}
+
+	return p;
+}
+
+#define ROTL8(x, n) ((uint8_t) (((x) << (n)) | ((x) >> (8 - (n)))))
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void aes_tables_init(void)
+{
+	uint8_t p = 1, q = 1;
+	int i, j;
+
+	/* Walk the multiplicative group with generator 3, q tracks 1/p */
+	do {
+		p = p ^ xtime(p);
+
+		q ^= q << 1;
+		q ^= q << 2;
+		q ^= q << 4;
+		if (q & 0x80)
+			q ^= 0x09;
+
+		S[p] = q ^ ROTL8(q, 1) ^ ROTL8(q, 2) ^ ROTL8(q, 3) ^ ROTL8(q, 4) ^ 0x63;
+	} while (p != 1);
+
+	S[0] = 0x63;
+
+	for (i = 0; i < 256; i++)
+		Si[S[i]] = (uint8_t) i;
+
+	for (i = 0; i < 256; i++) {
+		uint8_t s = S[i];
+		uint8_t si = Si[i];
+
+		Te[0][i] = ((uint32_t) xtime(s) << 24) | ((uint32_t) s << 16) |
+			((uint32_t) s << 8) | (uint32_t) (xtime(s) ^ s);
+
+		Td[0][i] = ((uint32_t) gmul(si, 14) << 24) | ((uint32_t) gmul(si, 9) << 16) |
+			((uint32_t) gmul(si, 13) << 8) | (uint32_t) gmul(si, 11);
+
+		for (j = 1; j < 4; j++) {
+			Te[j][i] = ROTR32(Te[0][i], 8 * j);
+			Td[j][i] = ROTR32(Td[0][i], 8 * j);
+		}
+	}
+}
+
+static uint32_t aes_subword(uint32_t w)
+{
+	return ((uint32_t) S[w >> 24] << 24) | ((uint32_t) S[(w >> 16) & 0xff] << 16) |
+		((uint32_t) S[(w >> 8) & 0xff] << 8) | (uint32_t) S[w & 0xff];
+}
+
+static int aes_setkey(aes_t *aes, const uint8_t *key, size_t keylen)
+{
+	uint32_t w[4 * (AES_MAX_ROUNDS + 1)];
+	uint8_t rcon = 1;
+	int nk, total, i, r;
+
+	if (keylen != 16 && keylen != 24 && keylen != 32)
+		return -1;
+
+	nk = (int) keylen / 4;
+	aes->rounds = nk + 6;
+	total = 4 * (aes->rounds + 1);
+
+	for (i = 0; i < nk; i++)
+		w[i] = GETU32(key + 4 * i);
+
+	for (; i < total; i++) {
+		uint32_t t = w[i - 1];
+
+		if (i % nk == 0) {
+			t = aes_subword((t << 8) | (t >> 24)) ^ ((uint32_t) rcon << 24);
+			rcon = xtime(rcon);
+		} else if (nk > 6 && i % nk == 4) {
+			t = aes_subword(t);
+		}
+
+		w[i] = w[i - nk] ^ t;
+	}
+
+	for (r = 0; r <= aes->rounds; r++) {
+		for (i = 0; i < 4; i++) {
+			uint32_t t = w[4 * (aes->rounds - r) + i];
+
+			PUTU32(aes->ek[r] + 4 * i, w[4 * r + i]);
+
+			if (r > 0 && r < aes->rounds)
+				t = Td[0][S[t >> 24]] ^ Td[1][S[(t >> 16) & 0xff]] ^
+					Td[2][S[(t >> 8) & 0xff]] ^ Td[3][S[t & 0xff]];
+
+			PUTU32(aes->dk[r] + 4 * i, t);
+		}
+	}
+
+	memset(w, 0, sizeof(w));
+	return 0;
+}
+
+static void aes_encrypt_block(const aes_t *aes, const uint8_t *in, uint8_t *out)
+{
+	const uint8_t *rk = aes->ek[0];
+	uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+	int r;
+
+	s0 = GETU32(in) ^ GETU32(rk);
+	s1 = GETU32(in + 4) ^ GETU32(rk + 4);
+	s2 = GETU32(in + 8) ^ GETU32(rk + 8);
+	s3 = GETU32(in + 12) ^ GETU32(rk + 12);
+
+	for (r = 1; r < aes->rounds; r++) {
+		rk += AES_BLOCK;
+		t0 = Te[0][s0 >> 24] ^ Te[1][(s1 >> 16) & 0xff] ^ Te[2][(s2 >> 8) & 0xff] ^ Te[3][s3 & 0xff] ^ GETU32(rk);
+		t1 = Te[0][s1 >> 24] ^ Te[1][(s2 >> 16) & 0xff] ^ Te[2][(s3 >> 8) & 0xff] ^ Te[3][s0 & 0xff] ^ GETU32(rk + 4);
+		t2 = Te[0][s2 >> 24] ^ Te[1][(s3 >> 16) & 0xff] ^ Te[2][(s0 >> 8) & 0xff] ^ Te[3][s1 & 0xff] ^ GETU32(rk + 8);
+		t3 = Te[0][s3 >> 24] ^ Te[1][(s0 >> 16) & 0xff] ^ Te[2][(s1 >> 8) & 0xff] ^ Te[3][s2 & 0xff] ^ GETU32(rk + 12);
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+	}
+
+	rk += AES_BLOCK;
+	t0 = ((uint32_t) S[s0 >> 24] << 24) ^ ((uint32_t) S[(s1 >> 16) & 0xff] << 16) ^
+		((uint32_t) S[(s2 >> 8) & 0xff] << 8) ^ (uint32_t) S[s3 & 0xff] ^ GETU32(rk);
+	t1 = ((uint32_t) S[s1 >> 24] << 24) ^ ((uint32_t) S[(s2 >> 16) & 0xff] << 16) ^
+		((uint32_t) S[(s3 >> 8) & 0xff] << 8) ^ (uint32_t) S[s0 & 0xff] ^ GETU32(rk + 4);
+	t2 = ((uint32_t) S[s2 >> 24] << 24) ^ ((uint32_t) S[(s3 >> 16) & 0xff] << 16) ^
+		((uint32_t) S[(s0 >> 8) & 0xff] << 8) ^ (uint32_t) S[s1 & 0xff] ^ GETU32(rk + 8);
+	t3 = ((uint32_t) S[s3 >> 24] << 24) ^ ((uint32_t) S[(s0 >> 16) & 0xff] << 16) ^
+		((uint32_t) S[(s1 >> 8) & 0xff] << 8) ^ (uint32_t) S[s2 & 0xff] ^ GETU32(rk + 12);
+
+	PUTU32(out, t0);
+	PUTU32(out + 4, t1);
+	PUTU32(out + 8, t2);
+	PUTU32(out + 12, t3);
+}
+
+static void aes_decrypt_block(const aes_t *aes, const uint8_t *in, uint8_t *out)
+{
+	const uint8_t *rk = aes->dk[0];
+	uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+	int r;
+
+	s0 = GETU32(in) ^ GETU32(rk);
+	s1 = GETU32(in + 4) ^ GETU32(rk + 4);
+	s2 = GETU32(in + 8) ^ GETU32(rk + 8);
+	s3 = GETU32(in + 12) ^ GETU32(rk + 12);
+
+	for (r = 1; r < aes->rounds; r++) {
+		rk += AES_BLOCK;
+		t0 = Td[0][s0 >> 24] ^ Td[1][(s3 >> 16) & 0xff] ^ Td[2][(s2 >> 8) & 0xff] ^ Td[3][s1 & 0xff] ^ GETU32(rk);
+		t1 = Td[0][s1 >> 24] ^ Td[1][(s0 >> 16) & 0xff] ^ Td[2][(s3 >> 8) & 0xff] ^ Td[3][s2 & 0xff] ^ GETU32(rk + 4);
+		t2 = Td[0][s2 >> 24] ^ Td[1][(s1 >> 16) & 0xff] ^ Td[2][(s0 >> 8) & 0xff] ^ Td[3][s3 & 0xff] ^ GETU32(rk + 8);
+		t3 = Td[0][s3 >> 24] ^ Td[1][(s2 >> 16) & 0xff] ^ Td[2][(s1 >> 8) & 0xff] ^ Td[3][s0 & 0xff] ^ GETU32(rk + 12);
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+	}
+
+	rk += AES_BLOCK;
+	t0 = ((uint32_t) Si[s0 >> 24] << 24) ^ ((uint32_t) Si[(s3 >> 16) & 0xff] << 16) ^
+		((uint32_t) Si[(s2 >> 8) & 0xff] << 8) ^ (uint32_t) Si[s1 & 0xff] ^ GETU32(rk);
+	t1 = ((uint32_t) Si[s1 >> 24] << 24) ^ ((uint32_t) Si[(s0 >> 16) & 0xff] << 16) ^
+		((uint32_t) Si[(s3 >> 8) & 0xff] << 8) ^ (uint32_t) Si[s2 & 0xff] ^ GETU32(rk + 4);
+	t2 = ((uint32_t) Si[s2 >> 24] << 24) ^ ((uint32_t) Si[(s1 >> 16) & 0xff] << 16) ^
+		((uint32_t) Si[(s0 >> 8) & 0xff] << 8) ^ (uint32_t) Si[s3 & 0xff] ^ GETU32(rk + 8);
+	t3 = ((uint32_t) Si[s3 >> 24] << 24) ^ ((uint32_t) Si[(s2 >> 16) & 0xff] << 16) ^
+		((uint32_t) Si[(s1 >> 8) & 0xff] << 8) ^ (uint32_t) Si[s0 & 0xff] ^ GETU32(rk + 12);
+
+	PUTU32(out, t0);
+	PUTU32(out + 4, t1);
+	PUTU32(out + 8, t2);
+	PUTU32(out + 12, t3);
+}
+
+static void ctr_increment(uint8_t *counter)
+{
+	int i;
+
+	for (i = AES_BLOCK - 1; i >= 0; i--)
+		if (++counter[i])
+			break;
+}
+
+static void xor_block(uint8_t *out, const uint8_t *a, const uint8_t *b)
+{
+	int i;
+
+	for (i = 0; i < AES_BLOCK; i++)
+		out[i] = a[i] ^ b[i];
+}
+
+typedef void (*aes_kernel_t)(aes_t *aes, uint8_t *out, const uint8_t *in, size_t blocks);
+
+static void cbc_encrypt_soft(aes_t *aes, uint8_t *out, const uint8_t *in, size_t blocks)
+{
+	uint8_t block[AES_BLOCK];
+
+	for (; blocks; blocks--, in += AES_BLOCK, out += AES_BLOCK) {
+		xor_block(block, in, aes->iv);
+		aes_encrypt_block(aes, block, aes->iv);
+		memcpy(out, aes->iv, AES_BLOCK);
+	}
+}
+
+static void cbc_decrypt_soft(aes_t *aes, uint8_t *out, const uint8_t *in, size_t blocks)
+{
+	uint8_t block[AES_BLOCK];
+
+	for (; blocks; blocks--, in += AES_BLOCK, out += AES_BLOCK) {
+		aes_decrypt_block(aes, in, block);
+		xor_block(out, block, aes->iv);
+		memcpy(aes->iv, in, AES_BLOCK);
+	}
+}
+
+static void ctr_crypt_soft(aes_t *aes, uint8_t *out, const uint8_t *in, size_t blocks)
+{
+	uint8_t block[AES_BLOCK];
+
+	for (; blocks; blocks--, in += AES_BLOCK, out += AES_BLOCK) {
+		aes_encrypt_block(aes, aes->iv, block);
+		ctr_increment(aes->iv);
+		xor_block(out, in, block);
+	}
+}
+
+#ifdef CRYPTO_AESNI
+#define AESNI_LOAD_KEYS(keys, schedule, rounds) do { \
+	int _r; \
+	for (_r = 0; _r <= (rounds); _r++) \
+		(keys)[_r] = _mm_loadu_si128((const __m128i *) (schedule)[_r]); \
+} while (0)
+
+__attribute__((target("aes,sse2")))
+static void cbc_encrypt_aesni(aes_t *aes, uint8_t *out, const uint8_t *in, size_t blocks)
+{
+	__m128i k[AES_MAX_ROUNDS + 1];
+	__m128i iv = _mm_loadu_si128((const __m128i *) aes->iv);
+	int r;
+
+	AESNI_LOAD_KEYS(k, aes->ek, aes->rounds);
+
+	for (; blocks; blocks--, in += AES_BLOCK, out += AES_BLOCK) {
+		iv = _mm_xor_si128(iv, _mm_loadu_si128((const __m128i *) in));
+		iv = _mm_xor_si128(iv, k[0]);
+		for (r = 1; r < aes->rounds; r++)
+			iv = _mm_aesenc_si128(iv, k[r]);
+		iv = _mm_aesenclast_si128(iv, k[aes->rounds]);
+		_mm_storeu_si128((__m128i *) out, iv);
+	}
+
+	_mm_storeu_si128((__m128i *) aes->iv, iv);
+}
+
+__attribute__((target("aes,sse2")))
+static void cbc_decrypt_aesni(aes_t *aes, uint8_t *out, const uint8_t *in, size_t blocks)
+{
+	__m128i k[AES_MAX_ROUNDS + 1];
+	__m128i iv = _mm_loadu_si128((const __m128i *) aes->iv);
+	int r;
+
+	AESNI_LOAD_KEYS(k, aes->dk, aes->rounds);
+
+	/* Unlike encryption, blocks don't depend on each other: keep four in flight */
+	for (; blocks >= 4; blocks -= 4, in += 4 * AES_BLOCK, out += 4 * AES_BLOCK) {
+		__m128i c0 = _mm_loadu_si128((const __m128i *) in);
+		__m128i c1 = _mm_loadu_si128((const __m128i *) (in + AES_BLOCK));
+		__m128i c2 = _mm_loadu_si128((const __m128i *) (in + 2 * AES_BLOCK));
+		__m128i c3 = _mm_loadu_si128((const __m128i *) (in + 3 * AES_BLOCK));
+		__m128i b0 = _mm_xor_si128(c0, k[0]);
+		__m128i b1 = _mm_xor_si128(c1, k[0]);
+		__m128i b2 = _mm_xor_si128(c2, k[0]);
+		__m128i b3 = _mm_xor_si128(c3, k[0]);
+
+		for (r = 1; r < aes->rounds; r++) {
+			b0 = _mm_aesdec_si128(b0, k[r]);
+			b1 = _mm_aesdec_si128(b1, k[r]);
+			b2 = _mm_aesdec_si128(b2, k[r]);
+			b3 = _mm_aesdec_si128(b3, k[r]);
+		}
+
+		b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, k[aes->rounds]), iv);
+		b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, k[aes->rounds]), c0);
+		b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, k[aes->rounds]), c1);
+		b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, k[aes->rounds]), c2);
+		iv = c3;
+
+		_mm_storeu_si128((__m128i *) out, b0);
+		_mm_storeu_si128((__m128i *) (out + AES_BLOCK), b1);
+		_mm_storeu_si128((__m128i *) (out + 2 * AES_BLOCK), b2);
+		_mm_storeu_si128((__m128i *) (out + 3 * AES_BLOCK), b3);
+	}
+
+	for (; blocks; blocks--, in += AES_BLOCK, out += AES_BLOCK) {
+		__m128i c = _mm_loadu_si128((const __m128i *) in);
+		__m128i b = _mm_xor_si128(c, k[0]);
+
+		for (r = 1; r < aes->rounds; r++)
+			b = _mm_aesdec_si128(b, k[r]);
+
+		_mm_storeu_si128((__m128i *) out,
+			_mm_xor_si128(_mm_aesdeclast_si128(b, k[aes->rounds]), iv));
+		iv = c;
+	}
+
+	_mm_storeu_si128((__m128i *) aes->iv, iv);
+}
+
+__attribute__((target("aes,sse2")))
+static void ctr_crypt_aesni(aes_t *aes, uint8_t *out, const uint8_t *in, size_t blocks)
+{
+	__m128i k[AES_MAX_ROUNDS + 1];
+	uint8_t counters[4][AES_BLOCK];
+	int r, i;
+
+	AESNI_LOAD_KEYS(k, aes->ek, aes->rounds);
+
+	while (blocks) {
+		size_t n = blocks < 4 ? blocks : 4;
+		__m128i b[4];
+
+		for (i = 0; i < (int) n; i++) {
+			memcpy(counters[i], aes->iv, AES_BLOCK);
+			ctr_increment(aes->iv);
+			b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *) counters[i]), k[0]);
+		}
+
+		for (r = 1; r < aes->rounds; r++)
+			for (i = 0; i < (int) n; i++)
+				b[i] = _mm_aesenc_si128(b[i], k[r]);
+
+		for (i = 0; i < (int) n; i++) {
+			b[i] = _mm_aesenclast_si128(b[i], k[aes->rounds]);
+			b[i] = _mm_xor_si128(b[i], _mm_loadu_si128((const __m128i *) (in + i * AES_BLOCK)));
+			_mm_storeu_si128((__m128i *) (out + i * AES_BLOCK), b[i]);
+		}
+
+		in += n * AES_BLOCK;
+		out += n * AES_BLOCK;
+		blocks -= n;
+	}
+}
+#endif
+
+static aes_kernel_t cbc_encrypt = cbc_encrypt_soft;
+static aes_kernel_t cbc_decrypt = cbc_decrypt_soft;
+static aes_kernel_t ctr_crypt = ctr_crypt_soft;
+static int aesni = 0;
+
+static void ctr_stream(aes_t *aes, uint8_t *out, const uint8_t *in, size_t size)
+{
+	size_t blocks;
+
+	/* Finish the keystream block the previous call started */
+	for (; size && aes->used < AES_BLOCK; size--)
+		*out++ = *in++ ^ aes->stream[aes->used++];
+
+	blocks = size / AES_BLOCK;
+	if (blocks) {
+		ctr_crypt(aes, out, in, blocks);
+		in += blocks * AES_BLOCK;
+		out += blocks * AES_BLOCK;
+		size -= blocks * AES_BLOCK;
+	}
+
+	if (size) {
+		aes_encrypt_block(aes, aes->iv, aes->stream);
+		ctr_increment(aes->iv);
+
+		for (aes->used = 0; aes->used < size; aes->used++)
+			out[aes->used] = in[aes->used] ^ aes->stream[aes->used];
+	}
+}
+
+typedef struct sha256 {
+	uint32_t state[8];
+	uint64_t length;
+	uint8_t block[SHA256_BLOCK];
+	size_t used;
+} sha256_t;
+
+static const uint32_t K256[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void sha256_compress(uint32_t *state, const uint8_t *block)
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = GETU32(block + 4 * i);
+
+	for (; i < 64; i++) {
+		uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+	for (i = 0; i < 64; i++) {
+		uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) +
+			((e & f) ^ (~e & g)) + K256[i] + w[i];
+		uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) +
+			((a & b) ^ (a & c) ^ (b & c));
+
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void sha256_init(sha256_t *ctx)
+{
+	static const uint32_t H0[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	memcpy(ctx->state, H0, sizeof(H0));
+	ctx->length = 0;
+	ctx->used = 0;
+}
+
+static void sha256_update(sha256_t *ctx, const uint8_t *data, size_t size)
+{
+	ctx->length += size;
+
+	if (ctx->used) {
+		size_t n = SHA256_BLOCK - ctx->used;
+		if (n > size)
+			n = size;
+
+		memcpy(ctx->block + ctx->used, data, n);
+		ctx->used += n;
+		data += n;
+		size -= n;
+
+		if (ctx->used < SHA256_BLOCK)
+			return;
+
+		sha256_compress(ctx->state, ctx->block);
+		ctx->used = 0;
+	}
+
+	for (; size >= SHA256_BLOCK; size -= SHA256_BLOCK, data += SHA256_BLOCK)
+		sha256_compress(ctx->state, data);
+
+	memcpy(ctx->block, data, size);
+	ctx->used = size;
+}
+
+static void sha256_final(sha256_t *ctx, uint8_t *digest)
+{
+	uint64_t bits = ctx->length << 3;
+	int i;
+
+	ctx->block[ctx->used++] = 0x80;
+	if (ctx->used > SHA256_BLOCK - 8) {
+		memset(ctx->block + ctx->used, 0, SHA256_BLOCK - ctx->used);
+		sha256_compress(ctx->state, ctx->block);
+		ctx->used = 0;
+	}
+
+	memset(ctx->block + ctx->used, 0, SHA256_BLOCK - 8 - ctx->used);
+	PUTU32(ctx->block + SHA256_BLOCK - 8, (uint32_t) (bits >> 32));
+	PUTU32(ctx->block + SHA256_BLOCK - 4, (uint32_t) bits);
+	sha256_compress(ctx->state, ctx->block);
+
+	for (i = 0; i < 8; i++)
+		PUTU32(digest + 4 * i, ctx->state[i]);
+}
+
+typedef struct hmac_sha256 {
+	sha256_t inner;
+	sha256_t outer;
+} hmac_sha256_t;
+
+static void hmac_sha256_init(hmac_sha256_t *ctx, const uint8_t *key, size_t keylen)
+{
+	uint8_t pad[SHA256_BLOCK];
+	uint8_t digest[SHA256_DIGEST];
+	int i;
+
+	if (keylen > SHA256_BLOCK) {
+		sha256_init(&ctx->inner);
+		sha256_update(&ctx->inner, key, keylen);
+		sha256_final(&ctx->inner, digest);
+		key = digest;
+		keylen = SHA256_DIGEST;
+	}
+
+	memset(pad, 0, sizeof(pad));
+	memcpy(pad, key, keylen);
+
+	for (i = 0; i < SHA256_BLOCK; i++)
+		pad[i] ^= 0x36;
+
+	sha256_init(&ctx->inner);
+	sha256_update(&ctx->inner, pad, SHA256_BLOCK);
+
+	for (i = 0; i < SHA256_BLOCK; i++)
+		pad[i] ^= 0x36 ^ 0x5c;
+
+	sha256_init(&ctx->outer);
+	sha256_update(&ctx->outer, pad, SHA256_BLOCK);
+
+	memset(pad, 0, sizeof(pad));
+	memset(digest, 0, sizeof(digest));
+}
+
+static void hmac_sha256_final(hmac_sha256_t *ctx, uint8_t *digest)
+{
+	sha256_final(&ctx->inner, digest);
+	sha256_update(&ctx->outer, digest, SHA256_DIGEST);
+	sha256_final(&ctx->outer, digest);
+}
+
+static void pbkdf2_sha256(
+	const uint8_t *password, size_t password_size,
+	const uint8_t *salt, size_t salt_size,
+	unsigned long iterations, uint8_t *out, size_t size)
+{
+	hmac_sha256_t base, ctx;
+	uint8_t u[SHA256_DIGEST];
+	uint8_t t[SHA256_DIGEST];
+	uint8_t index[4];
+	uint32_t block;
+	unsigned long i;
+	int j;
+
+	/* Keyed pads are hashed once, every iteration starts from a copy */
+	hmac_sha256_init(&base, password, password_size);
+
+	for (block = 1; size; block++) {
+		size_t n = size < SHA256_DIGEST ? size : SHA256_DIGEST;
+
+		PUTU32(index, block);
+
+		ctx = base;
+		sha256_update(&ctx.inner, salt, salt_size);
+		sha256_update(&ctx.inner, index, sizeof(index));
+		hmac_sha256_final(&ctx, u);
+		memcpy(t, u, SHA256_DIGEST);
+
+		for (i = 1; i < iterations; i++) {
+			ctx = base;
+			sha256_update(&ctx.inner, u, SHA256_DIGEST);
+			hmac_sha256_final(&ctx, u);
+
+			for (j = 0; j < SHA256_DIGEST; j++)
+				t[j] ^= u[j];
+		}
+
+		memcpy(out, t, n);
+		out += n;
+		size -= n;
+	}
+
+	memset(&base, 0, sizeof(base));
+	memset(&ctx, 0, sizeof(ctx));
+	memset(u, 0, sizeof(u));
+	memset(t, 0, sizeof(t));
+}
+
+static handles_t handles;
+
+static aes_t *get_aes(PyObject *args, const char **data, int *size) {
+	long handle;
+	aes_t *aes;
+
+	if (!PyArg_ParseTuple(args, "ls#", &handle, data, size))
+		return NULL;
+
+	aes = (aes_t *) handle_get(&handles, handle);
+	if (!aes)
+		PyErr_SetString(PyExc_Exception, "invalid cipher handle");
+
+	return aes;
+}
+
+static PyObject *aes_new(PyObject *args, aes_mode_t mode)
+{
+	const char *key;
+	int keylen;
+	const char *iv;
+	int ivlen;
+	aes_t *aes;
+	long handle;
+
+	if (!PyArg_ParseTuple(args, "s#s#", &key, &keylen, &iv, &ivlen))
+		return NULL;
+
+	if (ivlen != AES_BLOCK) {
+		PyErr_SetString(PyExc_Exception, "iv must be 16 bytes");
+		return NULL;
+	}
+
+	aes = (aes_t *) malloc(sizeof(aes_t));
+	if (!aes) {
+		PyErr_SetString(PyExc_Exception, "out of memory");
+		return NULL;
+	}
+
+	if (aes_setkey(aes, (const uint8_t *) key, keylen) == -1) {
+		free(aes);
+		PyErr_SetString(PyExc_Exception, "key must be 16, 24 or 32 bytes");
+		return NULL;
+	}
+
+	aes->mode = mode;
+	aes->used = AES_BLOCK;
+	memcpy(aes->iv, iv, AES_BLOCK);
+
+	handle = handle_new(&handles, aes);
+	if (!handle) {
+		memset(aes, 0, sizeof(aes_t));
+		free(aes);
+		PyErr_SetString(PyExc_Exception, "out of cipher handles");
+		return NULL;
+	}
+
+	return PyInt_FromLong(handle);
+}
+
+static PyObject *aes_crypt(PyObject *args, int encrypt)
+{
+	const char *data;
+	int size;
+	PyObject *result;
+	uint8_t *out;
+	aes_t *aes = get_aes(args, &data, &size);
+	if (!aes)
+		return NULL;
+
+	if (aes->mode == AES_MODE_CBC && size % AES_BLOCK) {
+		PyErr_SetString(PyExc_Exception, "data must be a multiple of 16 bytes");
+		return NULL;
+	}
+
+	result = PyString_FromStringAndSize(NULL, size);
+	if (!result)
+		return NULL;
+
+	out = (uint8_t *) PyString_AsString(result);
+
+	if (aes->mode == AES_MODE_CTR)
+		ctr_stream(aes, out, (const uint8_t *) data, size);
+	else if (encrypt)
+		cbc_encrypt(aes, out, (const uint8_t *) data, size / AES_BLOCK);
+	else
+		cbc_decrypt(aes, out, (const uint8_t *) data, size / AES_BLOCK);
+
+	return result;
+}
+
+static PyObject *Py_aes_cbc(PyObject *self, PyObject *args)
+{
+	return aes_new(args, AES_MODE_CBC);
+}
+
+static PyObject *Py_aes_ctr(PyObject *self, PyObject *args)
+{
+	return aes_new(args, AES_MODE_CTR);
+}
+
+static PyObject *Py_aes_encrypt(PyObject *self, PyObject *args)
+{
+	return aes_crypt(args, 1);
+}
+
+static PyObject *Py_aes_decrypt(PyObject *self, PyObject *args)
+{
+	return aes_crypt(args, 0);
+}
+
+static PyObject *Py_aes_free(PyObject *self, PyObject *args)
+{
+	long handle;
+	aes_t *aes;
+
+	if (!PyArg_ParseTuple(args, "l", &handle))
+		return NULL;
+
+	aes = (aes_t *) handle_release(&handles, handle);
+	if (!aes) {
+		PyErr_SetString(PyExc_Exception, "invalid cipher handle");
+		return NULL;
+	}
+
+	memset(aes, 0, sizeof(aes_t));
+	free(aes);
+
+	return Py_BuildValue("");
+}
+
+static PyObject *Py_aesni(PyObject *self, PyObject *args)
+{
+	return PyBool_FromLong(aesni);
+}
+
+static PyObject *Py_sha256(PyObject *self, PyObject *args)
+{
+	const char *data;
+	int size;
+	sha256_t ctx;
+	uint8_t digest[SHA256_DIGEST];
+
+	if (!PyArg_ParseTuple(args, "s#", &data, &size))
+		return NULL;
+
+	sha256_init(&ctx);
+	sha256_update(&ctx, (const uint8_t *) data, size);
+	sha256_final(&ctx, digest);
+
+	return PyString_FromStringAndSize((const char *) digest, SHA256_DIGEST);
+}
+
+static PyObject *Py_hmac_sha256(PyObject *self, PyObject *args)
+{
+	const char *key;
+	int keylen;
+	const char *data;
+	int size;
+	hmac_sha256_t ctx;
+	uint8_t digest[SHA256_DIGEST];
+
+	if (!PyArg_ParseTuple(args, "s#s#", &key, &keylen, &data, &size))
+		return NULL;
+
+	hmac_sha256_init(&ctx, (const uint8_t *) key, keylen);
+	sha256_update(&ctx.inner, (const uint8_t *) data, size);
+	hmac_sha256_final(&ctx, digest);
+	memset(&ctx, 0, sizeof(ctx));
+
+	return PyString_FromStringAndSize((const char *) digest, SHA256_DIGEST);
+}
+
+static PyObject *Py_pbkdf2_sha256(PyObject *self, PyObject *args)
+{
+	const char *password;
+	int password_size;
+	const char *salt;
+	int salt_size;
+	int iterations;
+	int keylen;
+	PyObject *result;
+
+	if (!PyArg_ParseTuple(args, "s#s#ii", &password, &password_size,
+			&salt, &salt_size, &iterations, &keylen))
+		return NULL;
+
+	if (iterations < 1 || keylen < 0) {
+		PyErr_SetString(PyExc_Exception, "invalid iterations or key length");
+		return NULL;
+	}
+
+	result = PyString_FromStringAndSize(NULL, keylen);
+	if (!result)
+		return NULL;
+
+	pbkdf2_sha256(
+		(const uint8_t *) password, password_size,
+		(const uint8_t *) salt, salt_size,
+		iterations, (uint8_t *) PyString_AsString(result), keylen);
+
+	return result;
+}
+
+static PyMethodDef methods[] = {
+	{ "aes_cbc", Py_aes_cbc, METH_VARARGS, "aes_cbc(key, iv) -> handle" },
+	{ "aes_ctr", Py_aes_ctr, METH_VARARGS, "aes_ctr(key, counter block) -> handle" },
+	{ "aes_encrypt", Py_aes_encrypt, METH_VARARGS, "aes_encrypt(handle, data) -> string" },
+	{ "aes_decrypt", Py_aes_decrypt, METH_VARARGS, "aes_decrypt(handle, data) -> string" },
+	{ "aes_free", Py_aes_free, METH_VARARGS, "aes_free(handle)" },
+	{ "aesni", Py_aesni, METH_NOARGS, "aesni() -> True if AES-NI is used" },
+	{ "sha256", Py_sha256, METH_VARARGS, "sha256(data) -> digest" },
+	{ "hmac_sha256", Py_hmac_sha256, METH_VARARGS, "hmac_sha256(key, data) -> digest" },
+	{ "pbkdf2_sha256", Py_pbkdf2_sha256, METH_VARARGS,
+	  "pbkdf2_sha256(password, salt, iterations, keylen) -> key" },
+	{ NULL, NULL },		/* Sentinel */
+};
+
+DL_EXPORT(void)
+init_pupycrypto(void)
+{
+	aes_tables_init();
+
+#ifdef CRYPTO_AESNI
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("aes")) {
+		cbc_encrypt = cbc_encrypt_aesni;
+		cbc_decrypt = cbc_decrypt_aesni;
+		ctr_crypt = ctr_crypt_aesni;
+		aesni = 1;
+	}
+#endif
+
+	Py_InitModule3("_pupycrypto", methods, module_doc);
+}
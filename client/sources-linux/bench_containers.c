@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "list.h"
+#include "vector.h"
+#include "ring.h"
+#include "lfstack.h"
+
+/*
+
+  make bench-containers [BENCH_OPS=n]
+
+  The containers against the mutex protected LIST they can stand in for,
+  with 1 to 8 threads hammering the same instance:
+
+  queue:   half the threads push, the others shift (list_push/list_shift
+           against ring_push/ring_shift)
+  stack:   every thread pushes then pops (list, vector, lfstack)
+  get:     every thread reads random indexes of 1024 items (list, vector)
+
+  An op is a read, or a value pushed and popped back. Every value pushed is
+  popped exactly once, the sums are checked.
+
+*/
+
+#define CAPACITY 1024
+#define MAX_THREADS 8
+
+typedef enum { WORKLOAD_QUEUE, WORKLOAD_STACK, WORKLOAD_GET } workload_t;
+
+typedef struct _BENCH
+{
+	const char * name;
+	void * (*create)(void);
+	void (*destroy)(void * container);
+	bool (*push)(void * container, void * data);
+	void * (*pop)(void * container);
+	void * (*get)(void * container, unsigned int index);
+} BENCH, *PBENCH;
+
+static void * list_new(void) { return list_create(); }
+static void list_free(void * c) { list_destroy(c); }
+static bool list_put(void * c, void * data) { return list_push(c, data); }
+static void * list_take(void * c) { return list_pop(c); }
+static void * list_first(void * c) { return list_shift(c); }
+static void * list_at(void * c, unsigned int i) { return list_get(c, i); }
+
+static void * vector_new(void) { return vector_create(CAPACITY); }
+static void vector_free(void * c) { vector_destroy(c); }
+static bool vector_put(void * c, void * data) { return vector_push(c, data); }
+static void * vector_take(void * c) { return vector_pop(c); }
+static void * vector_at(void * c, unsigned int i) { return vector_get(c, i); }
+
+static void * ring_new(void) { return ring_create(CAPACITY); }
+static void ring_free(void * c) { ring_destroy(c); }
+static bool ring_put(void * c, void * data) { return ring_push(c, data); }
+static void * ring_take(void * c) { return ring_shift(c); }
+
+static void * lfstack_new(void) { return lfstack_create(CAPACITY * MAX_THREADS); }
+static void lfstack_free(void * c) { lfstack_destroy(c); }
+static bool lfstack_put(void * c, void * data) { return lfstack_push(c, data); }
+static void * lfstack_take(void * c) { return lfstack_pop(c); }
+
+static BENCH queues[] = {
+	{ "list", list_new, list_free, list_put, list_first, NULL },
+	{ "ring", ring_new, ring_free, ring_put, ring_take, NULL },
+};
+
+static BENCH stacks[] = {
+	{ "list", list_new, list_free, list_put, list_take, NULL },
+	{ "vector", vector_new, vector_free, vector_put, vector_take, NULL },
+	{ "lfstack", lfstack_new, lfstack_free, lfstack_put, lfstack_take, NULL },
+};
+
+static BENCH indexed[] = {
+	{ "list", list_new, list_free, list_put, NULL, list_at },
+	{ "vector", vector_new, vector_free, vector_put, NULL, vector_at },
+};
+
+typedef struct _WORKER
+{
+	PBENCH bench;
+	void * container;
+	pthread_barrier_t * barrier;
+	unsigned long ops;
+	unsigned int id;
+	uint64_t sum;          ///< Sum of the values pushed or popped.
+	pthread_t thread;
+} WORKER, *PWORKER;
+
+static
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* values are never 0, a NULL pop means empty */
+static
+void * value(PWORKER w, unsigned long i) {
+	return (void *) (uintptr_t) ((uint64_t) w->id << 32 | (i + 1));
+}
+
+static
+void * producer(void * arg) {
+	PWORKER w = arg;
+	pthread_barrier_wait(w->barrier);
+	for (unsigned long i = 0; i < w->ops; i++) {
+		void * data = value(w, i);
+		while (!w->bench->push(w->container, data))
+			sched_yield();
+		w->sum += (uintptr_t) data;
+	}
+	return NULL;
+}
+
+static
+void * consumer(void * arg) {
+	PWORKER w = arg;
+	pthread_barrier_wait(w->barrier);
+	for (unsigned long i = 0; i < w->ops; i++) {
+		void * data;
+		while (!(data = w->bench->pop(w->container)))
+			sched_yield();
+		w->sum += (uintptr_t) data;
+	}
+	return NULL;
+}
+
+static
+void * pusher_popper(void * arg) {
+	PWORKER w = arg;
+	pthread_barrier_wait(w->barrier);
+	for (unsigned long i = 0; i < w->ops; i++) {
+		void * data = value(w, i);
+		if (!w->bench->push(w->container, data))
+			abort();
+		void * popped = w->bench->pop(w->container);
+		if (!popped)
+			abort();
+		/* pushed minus popped, 0 in total when nothing got lost */
+		w->sum += (uintptr_t) data - (uintptr_t) popped;
+	}
+	return NULL;
+}
+
+static
+void * reader(void * arg) {
+	PWORKER w = arg;
+	unsigned int seed = w->id;
+	pthread_barrier_wait(w->barrier);
+	for (unsigned long i = 0; i < w->ops; i++)
+		w->sum += (uintptr_t) w->bench->get(w->container, rand_r(&seed) % CAPACITY);
+	return NULL;
+}
+
+static
+int run(const char * workload, workload_t kind, PBENCH bench, unsigned int threads, unsigned long ops) {
+	WORKER workers[MAX_THREADS];
+	pthread_barrier_t barrier;
+	void * container = bench->create();
+	uint64_t expected = 0;
+
+	if (!container) {
+		fprintf(stderr, "%s: can't create %s\n", workload, bench->name);
+		return -1;
+	}
+
+	if (kind == WORKLOAD_GET) {
+		for (unsigned int i = 0; i < CAPACITY; i++)
+			bench->push(container, (void *) (uintptr_t) (i + 1));
+		/* rand_r is deterministic, the reads are replayed for the check */
+		for (unsigned int t = 0; t < threads; t++) {
+			unsigned int seed = t;
+			for (unsigned long i = 0; i < ops / threads; i++)
+				expected += rand_r(&seed) % CAPACITY + 1;
+		}
+	}
+
+	pthread_barrier_init(&barrier, NULL, threads + 1);
+	for (unsigned int t = 0; t < threads; t++) {
+		void * (*func)(void *);
+		PWORKER w = &workers[t];
+		memset(w, 0, sizeof(WORKER));
+		w->bench = bench;
+		w->container = container;
+		w->barrier = &barrier;
+		w->id = t;
+		w->ops = ops / threads;
+
+		if (kind == WORKLOAD_GET)
+			func = reader;
+		else if (kind == WORKLOAD_QUEUE && threads > 1) {
+			/* pairs of producer and consumer, a single thread does both */
+			w->ops = ops / threads * 2;
+			w->id = t / 2;
+			func = t & 1 ? consumer : producer;
+		}
+		else
+			func = pusher_popper;
+
+		pthread_create(&w->thread, NULL, func, w);
+	}
+
+	double started = now();
+	pthread_barrier_wait(&barrier);
+	uint64_t pushed = 0, popped = 0, total = 0;
+	unsigned long done = 0;
+	for (unsigned int t = 0; t < threads; t++) {
+		pthread_join(workers[t].thread, NULL);
+		if (kind != WORKLOAD_QUEUE || threads == 1) {
+			done += workers[t].ops;
+			total += workers[t].sum;
+		}
+		else if (t & 1)
+			popped += workers[t].sum;
+		else {
+			/* an item through the queue is an op */
+			done += workers[t].ops;
+			pushed += workers[t].sum;
+		}
+	}
+	double elapsed = now() - started;
+	pthread_barrier_destroy(&barrier);
+	bench->destroy(container);
+
+	if (total != expected || pushed != popped) {
+		fprintf(stderr, "%s/%s, %u threads: values lost or duplicated\n", workload, bench->name, threads);
+		return -1;
+	}
+
+	printf("%-6s %-8s %u threads %10.0f ops/s\n", workload, bench->name, threads, done / elapsed);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long ops = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	static const struct {
+		const char * workload;
+		workload_t kind;
+		PBENCH benches;
+		size_t count;
+	} workloads[] = {
+		{ "queue", WORKLOAD_QUEUE, queues, sizeof(queues) / sizeof(BENCH) },
+		{ "stack", WORKLOAD_STACK, stacks, sizeof(stacks) / sizeof(BENCH) },
+		{ "get", WORKLOAD_GET, indexed, sizeof(indexed) / sizeof(BENCH) },
+	};
+
+	for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+		for (unsigned int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+			for (size_t b = 0; b < workloads[w].count; b++) {
+				if (run(workloads[w].workload, workloads[w].kind, &workloads[w].benches[b], threads, ops))
+					return 1;
+			}
+		}
+	}
+
+	return 0;
+}
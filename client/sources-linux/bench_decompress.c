@@ -0,0 +1,221 @@
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "decompress.h"
+
+/*
+
+  make bench-decompress [BENCH_RUNS=n]
+
+  decompress() (one inflate into a mapping sized from the trailer) against
+  the zpipe loop it replaced (8K input and output windows, a write() per
+  output window), on a payload resource: resources/python27.so by default.
+  Both write to an unlinked temporary file like the loader does; the
+  outputs are compared.
+
+*/
+
+#define LEGACY_CHUNK 8196
+
+static
+int legacy_decompress(int fd, const char *buf, size_t size) {
+	int ret;
+	unsigned have;
+	z_stream strm;
+	unsigned char out[LEGACY_CHUNK];
+
+	strm.zalloc = Z_NULL;
+	strm.zfree = Z_NULL;
+	strm.opaque = Z_NULL;
+	strm.avail_in = 0;
+	strm.next_in = Z_NULL;
+	ret = inflateInit2(&strm, 15+32);
+
+	if (ret != Z_OK)
+		return ret;
+
+	do {
+		strm.avail_in = size < LEGACY_CHUNK? size : LEGACY_CHUNK;
+		if (strm.avail_in == 0)
+			break;
+
+		strm.next_in = (Bytef *) buf;
+
+		buf += strm.avail_in;
+		size -= strm.avail_in;
+
+		do {
+			strm.avail_out = LEGACY_CHUNK;
+			strm.next_out = out;
+			ret = inflate(&strm, Z_NO_FLUSH);
+			switch (ret) {
+			case Z_NEED_DICT:
+				ret = Z_DATA_ERROR;
+			case Z_DATA_ERROR:
+			case Z_MEM_ERROR:
+				(void)inflateEnd(&strm);
+				return ret;
+			}
+			have = LEGACY_CHUNK - strm.avail_out;
+			unsigned char *ptr = out;
+			while (have) {
+				int n = write(fd, ptr, have);
+				if (n == -1) {
+					(void)inflateEnd(&strm);
+					return Z_ERRNO;
+				}
+				have -= n;
+				ptr += n;
+			}
+		} while (strm.avail_out == 0);
+	} while (ret != Z_STREAM_END);
+
+	(void)inflateEnd(&strm);
+	return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+}
+
+static
+int buffer_decompress(int fd, const char *buf, size_t size) {
+	size_t usize = decompress_size(buf, size);
+	char *out = malloc(usize);
+	if (!out)
+		return Z_MEM_ERROR;
+
+	int ret = decompress_buffer(out, usize, buf, size);
+	free(out);
+	return ret;
+}
+
+static
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static
+int compare_double(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+	return x < y ? -1 : x > y;
+}
+
+static
+int temporary(void) {
+	char path[] = "/tmp/bench_decompress.XXXXXX";
+	int fd = mkstemp(path);
+	if (fd != -1)
+		unlink(path);
+	return fd;
+}
+
+static
+uLong file_crc(int fd) {
+	struct stat st;
+	if (fstat(fd, &st) == -1 || !st.st_size)
+		return 0;
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+		return 0;
+
+	uLong crc = crc32(crc32(0, Z_NULL, 0), data, st.st_size);
+	munmap(data, st.st_size);
+	return crc;
+}
+
+static
+int run(const char *name, int (*func)(int, const char *, size_t),
+		const char *buf, size_t size, int runs, uLong *crc) {
+	double times[runs];
+	int fd = temporary();
+	if (fd == -1) {
+		perror("mkstemp");
+		return -1;
+	}
+
+	for (int i = 0; i < runs; i++) {
+		if (ftruncate(fd, 0) == -1 || lseek(fd, 0, SEEK_SET) == -1) {
+			perror("ftruncate");
+			close(fd);
+			return -1;
+		}
+
+		double started = now();
+		int ret = func(fd, buf, size);
+		times[i] = now() - started;
+
+		if (ret != Z_OK) {
+			fprintf(stderr, "%s: failed (%d)\n", name, ret);
+			close(fd);
+			return -1;
+		}
+	}
+
+	if (crc)
+		*crc = file_crc(fd);
+	close(fd);
+
+	qsort(times, runs, sizeof(double), compare_double);
+	size_t usize = decompress_size(buf, size);
+	printf("%-22s best %8.2fms  median %8.2fms  %7.1f MB/s\n", name,
+		   times[0] * 1000, times[runs / 2] * 1000, usize / times[runs / 2] / (1 << 20));
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	const char *path = argc > 1 ? argv[1] : "resources/python27.so";
+	int runs = argc > 2 ? atoi(argv[2]) : 20;
+	if (runs < 1)
+		runs = 1;
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd == -1 || fstat(fd, &st) == -1) {
+		perror(path);
+		return 1;
+	}
+
+	char *buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (buf == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	codec_t codec = decompress_codec(buf, st.st_size);
+	size_t usize = decompress_size(buf, st.st_size);
+	printf("%s: %ld bytes, %zu uncompressed, %d runs\n", path, (long) st.st_size, usize, runs);
+
+	uLong single = 0, legacy = 0;
+	if (run("decompress (mapped)", decompress, buf, st.st_size, runs, &single))
+		return 1;
+
+	if (usize && run("decompress_buffer", buffer_decompress, buf, st.st_size, runs, NULL))
+		return 1;
+
+	/* the old loop only knew gzip/zlib */
+	if (codec != CODEC_GZIP && codec != CODEC_ZLIB) {
+		printf("not a gzip stream, no legacy loop\n");
+		return 0;
+	}
+
+	if (run("legacy zpipe loop", legacy_decompress, buf, st.st_size, runs, &legacy))
+		return 1;
+
+	if (single != legacy) {
+		fprintf(stderr, "outputs differ: crc32 %08lx != %08lx\n", single, legacy);
+		return 1;
+	}
+
+	printf("outputs match, crc32 %08lx\n", single);
+	return 0;
+}
@@ -1,69 +1,341 @@
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <zlib.h>
+
 #include "decompress.h"
+#include "debug.h"
 
-/* Zpipe code */
+/*
 
-#define CHUNK 8196
+  Payloads are compressed blobs tagged by their magic: gzip (the default,
+  also zlib for library entries) or an LZ4 frame. The uncompressed size is
+  known upfront (gzip ISIZE trailer, LZ4 content size), so size the
+  destination once and decode the whole stream in one call; only gzip
+  streams we can't trust (multi-member, >4G, lying trailer) go through the
+  chunked zpipe loop, which inflates every member.
 
-int decompress(int fd, const char *buf, size_t size) {
+*/
+
+#define MIN_CHUNK (64 << 10)
+#define MAX_CHUNK (1 << 20)
+
+#define LZ4_MAGIC "\x04\x22\x4d\x18"
+#define LZ4_FLG_VERSION_MASK 0xc0
+#define LZ4_FLG_VERSION 0x40
+#define LZ4_FLG_BLOCK_CHECKSUM 0x10
+#define LZ4_FLG_CONTENT_SIZE 0x08
+#define LZ4_FLG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLG_DICT_ID 0x01
+#define LZ4_BLOCK_UNCOMPRESSED 0x80000000u
+#define LZ4_MIN_MATCH 4
+
+static inline
+uint32_t read_le32(const unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+codec_t decompress_codec(const char *buf, size_t size) {
+	if (size >= 18 && buf[0] == '\x1f' && buf[1] == '\x8b')
+		return CODEC_GZIP;
+
+	if (size >= 7 && !memcmp(buf, LZ4_MAGIC, 4))
+		return CODEC_LZ4;
+
+	/* zlib: CM=8, CINFO<=7, header checksum */
+	if (size >= 6 && (buf[0] & 0x8f) == 0x08 &&
+		!((((unsigned char) buf[0]) << 8 | (unsigned char) buf[1]) % 31))
+		return CODEC_ZLIB;
+
+	return CODEC_NONE;
+}
+
+size_t decompress_size(const char *buf, size_t size) {
+	const unsigned char *p = (const unsigned char *) buf;
+
+	switch (decompress_codec(buf, size)) {
+	case CODEC_GZIP:
+		return read_le32(p + size - 4);
+
+	case CODEC_LZ4:
+		if ((p[4] & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION ||
+			!(p[4] & LZ4_FLG_CONTENT_SIZE) || size < 15)
+			return 0;
+
+		return read_le32(p + 6) | (sizeof(size_t) > 4 ? (uint64_t) read_le32(p + 10) << 32 : 0);
+
+	default:
+		return 0;
+	}
+}
+
+static
+int lz4_decode_block(unsigned char *obase, unsigned char **pop, unsigned char *oend,
+					 const unsigned char *ip, const unsigned char *iend) {
+	unsigned char *op = *pop;
+
+	while (ip < iend) {
+		unsigned int token = *ip++;
+		size_t length = token >> 4;
+
+		if (length == 15) {
+			unsigned char b;
+			do {
+				if (ip >= iend)
+					return Z_DATA_ERROR;
+				b = *ip++;
+				length += b;
+			} while (b == 255);
+		}
+
+		if (length > (size_t) (iend - ip) || length > (size_t) (oend - op))
+			return Z_DATA_ERROR;
+
+		memcpy(op, ip, length);
+		op += length;
+		ip += length;
+
+		/* last sequence has literals only */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return Z_DATA_ERROR;
+
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		if (!offset || offset > (size_t) (op - obase))
+			return Z_DATA_ERROR;
+
+		length = token & 15;
+		if (length == 15) {
+			unsigned char b;
+			do {
+				if (ip >= iend)
+					return Z_DATA_ERROR;
+				b = *ip++;
+				length += b;
+			} while (b == 255);
+		}
+
+		length += LZ4_MIN_MATCH;
+		if (length > (size_t) (oend - op))
+			return Z_DATA_ERROR;
+
+		const unsigned char *match = op - offset;
+		if (offset >= length) {
+			memcpy(op, match, length);
+			op += length;
+		} else {
+			while (length--)
+				*op++ = *match++;
+		}
+	}
+
+	*pop = op;
+	return Z_OK;
+}
+
+/* LZ4 frame decoder. Linked blocks are fine since the whole output is
+   in one buffer; checksums are skipped */
+static
+int lz4_decompress_buffer(char *out, size_t out_size, const char *buf, size_t size) {
+	const unsigned char *ip = (const unsigned char *) buf;
+	const unsigned char *iend = ip + size;
+	unsigned char *obase = (unsigned char *) out;
+	unsigned char *op = obase;
+	unsigned char *oend = obase + out_size;
+
+	unsigned int flags = ip[4];
+	if ((flags & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION || (flags & LZ4_FLG_DICT_ID)) {
+		dprint("Unsupported LZ4 frame flags: %02x\n", flags);
+		return Z_DATA_ERROR;
+	}
+
+	ip += 4 + 2 + ((flags & LZ4_FLG_CONTENT_SIZE)? 8 : 0) + 1;
+
+	for (;;) {
+		if (iend - ip < 4)
+			return Z_DATA_ERROR;
+
+		uint32_t block_size = read_le32(ip);
+		ip += 4;
+
+		if (!block_size)
+			break;
+
+		bool uncompressed = block_size & LZ4_BLOCK_UNCOMPRESSED;
+		block_size &= ~LZ4_BLOCK_UNCOMPRESSED;
+
+		if (block_size > (size_t) (iend - ip))
+			return Z_DATA_ERROR;
+
+		if (uncompressed) {
+			if (block_size > (size_t) (oend - op))
+				return Z_DATA_ERROR;
+
+			memcpy(op, ip, block_size);
+			op += block_size;
+		} else {
+			int ret = lz4_decode_block(obase, &op, oend, ip, ip + block_size);
+			if (ret != Z_OK)
+				return ret;
+		}
+
+		ip += block_size;
+		if (flags & LZ4_FLG_BLOCK_CHECKSUM)
+			ip += 4;
+	}
+
+	if (flags & LZ4_FLG_CONTENT_CHECKSUM)
+		ip += 4;
+
+	return op == oend && ip <= iend ? Z_OK : Z_DATA_ERROR;
+}
+
+static
+int zlib_decompress_buffer(char *out, size_t out_size, const char *buf, size_t size) {
+	z_stream strm = {
+		.zalloc = Z_NULL,
+		.zfree = Z_NULL,
+		.opaque = Z_NULL,
+		.next_in = (Bytef *) buf,
+		.avail_in = size,
+		.next_out = (Bytef *) out,
+		.avail_out = out_size,
+	};
+
+	int ret = inflateInit2(&strm, 15+32);
+	if (ret != Z_OK)
+		return ret;
+
+	ret = inflate(&strm, Z_FINISH);
+	if (ret == Z_STREAM_END && (strm.avail_out || strm.avail_in))
+		ret = Z_DATA_ERROR;
+	else if (ret == Z_NEED_DICT || ret == Z_BUF_ERROR || ret == Z_OK)
+		ret = Z_DATA_ERROR;
+
+	(void)inflateEnd(&strm);
+	return ret == Z_STREAM_END ? Z_OK : ret;
+}
+
+int decompress_buffer(char *out, size_t out_size, const char *buf, size_t size) {
+	switch (decompress_codec(buf, size)) {
+	case CODEC_GZIP:
+	case CODEC_ZLIB:
+		return zlib_decompress_buffer(out, out_size, buf, size);
+
+	case CODEC_LZ4:
+		return lz4_decompress_buffer(out, out_size, buf, size);
+
+	default:
+		return Z_DATA_ERROR;
+	}
+}
+
+static
+int decompress_mapped(int fd, const char *buf, size_t size, size_t usize) {
+	if (ftruncate(fd, usize) == -1)
+		return Z_ERRNO;
+
+	char *out = mmap(NULL, usize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (out == MAP_FAILED)
+		return Z_ERRNO;
+
+	int ret = decompress_buffer(out, usize, buf, size);
+	munmap(out, usize);
+	return ret;
+}
+
+/* gzip allows several members back to back (cat a.gz b.gz), restart on the
+   next header; anything else after the stream is ignored as before */
+static
+bool next_member(z_stream *strm) {
+	if (strm->avail_in < 2 || strm->next_in[0] != 0x1f || strm->next_in[1] != 0x8b)
+		return false;
+
+	return inflateReset(strm) == Z_OK;
+}
+
+static
+int decompress_stream(int fd, const char *buf, size_t size, size_t usize) {
 	int ret;
-	unsigned have;
-    z_stream strm;
-    unsigned char in[CHUNK];
-    unsigned char out[CHUNK];
-
-    /* allocate inflate state */
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = 0;
-    strm.next_in = Z_NULL;
-    ret = inflateInit2(&strm, 15+32);
-
-    if (ret != Z_OK)
-        return ret;
-
-    /* decompress until deflate stream ends or end of file */
-    do {
-        strm.avail_in = size < CHUNK? size : CHUNK;
-        if (strm.avail_in == 0)
-            break;
-
-        strm.next_in = buf;
-
-		buf += strm.avail_in;
-		size -= strm.avail_in;
-		
-        do {
-            strm.avail_out = CHUNK;
-            strm.next_out = out;
-            ret = inflate(&strm, Z_NO_FLUSH);
-            switch (ret) {
-            case Z_NEED_DICT:
-                ret = Z_DATA_ERROR;     /* and fall through */
-            case Z_DATA_ERROR:
-            case Z_MEM_ERROR:
-                (void)inflateEnd(&strm);
-                return ret;
-            }
-            have = CHUNK - strm.avail_out;
-			unsigned char *ptr = out;
-			while (have) {
-				int n = write(fd, ptr, have);
-				if (n == -1) {
-					(void)inflateEnd(&strm);
-					return Z_ERRNO;
-				}
-				have -= n;
-				ptr += n;
+	z_stream strm = {
+		.zalloc = Z_NULL,
+		.zfree = Z_NULL,
+		.opaque = Z_NULL,
+		.next_in = (Bytef *) buf,
+		.avail_in = size,
+	};
+
+	size_t chunk = usize < MIN_CHUNK ? MIN_CHUNK : usize > MAX_CHUNK ? MAX_CHUNK : usize;
+	unsigned char *out = malloc(chunk);
+	if (!out)
+		return Z_MEM_ERROR;
+
+	ret = inflateInit2(&strm, 15+32);
+	if (ret != Z_OK) {
+		free(out);
+		return ret;
+	}
+
+	/* the whole input is in memory already, only the output is chunked */
+	do {
+		strm.avail_out = chunk;
+		strm.next_out = out;
+
+		ret = inflate(&strm, Z_NO_FLUSH);
+		switch (ret) {
+		case Z_NEED_DICT:
+		case Z_BUF_ERROR:
+			ret = Z_DATA_ERROR;     /* and fall through */
+		case Z_DATA_ERROR:
+		case Z_MEM_ERROR:
+			goto out;
+		}
+
+		unsigned char *ptr = out;
+		size_t have = chunk - strm.avail_out;
+		while (have) {
+			ssize_t n = write(fd, ptr, have);
+			if (n == -1) {
+				ret = Z_ERRNO;
+				goto out;
 			}
+			have -= n;
+			ptr += n;
+		}
+	} while (ret != Z_STREAM_END || next_member(&strm));
+
+ out:
+	(void)inflateEnd(&strm);
+	free(out);
+	return ret == Z_STREAM_END ? Z_OK : ret;
+}
+
+int decompress(int fd, const char *buf, size_t size) {
+	codec_t codec = decompress_codec(buf, size);
+	size_t usize = decompress_size(buf, size);
+
+	if (usize) {
+		int ret = decompress_mapped(fd, buf, size, usize);
+		if (ret == Z_OK || codec == CODEC_LZ4)
+			return ret;
 
-        } while (strm.avail_out == 0);
+		dprint("Mapped inflate failed (%d), fallback to stream\n", ret);
+		if (ftruncate(fd, 0) == -1 || lseek(fd, 0, SEEK_SET) == -1)
+			return Z_ERRNO;
+	}
 
-        /* done when inflate() says it's done */
-    } while (ret != Z_STREAM_END);
+	if (codec == CODEC_LZ4) {
+		dprint("LZ4 frame without content size\n");
+		return Z_DATA_ERROR;
+	}
 
-    /* clean up and return */
-    (void)inflateEnd(&strm);
-    return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+	return decompress_stream(fd, buf, size, usize);
 }
@@ -1,6 +1,24 @@
 #ifndef DECOMPRESS_H
 #define DECOMPRESS_H
 
+#include <sys/types.h>
+
+typedef enum {
+	CODEC_NONE,
+	CODEC_GZIP,
+	CODEC_ZLIB,
+	CODEC_LZ4,
+} codec_t;
+
+/* Guess codec by magic bytes */
+codec_t decompress_codec(const char *buf, size_t size);
+
+/* Uncompressed size from the gzip trailer or LZ4 frame header, 0 if unknown */
+size_t decompress_size(const char *buf, size_t size);
+
+/* Decode the whole stream into out, which must be exactly the uncompressed size */
+int decompress_buffer(char *out, size_t out_size, const char *buf, size_t size);
+
 int decompress(int fd, const char *buf, size_t size);
 
 #endif /* DECOMPRESS_H */
@@ -0,0 +1,153 @@
+/*!
+ * @file lfstack.c
+ * @brief Definitions for functions that operate on bounded lock-free stacks.
+ * @details Treiber stack over a preallocated array of nodes. Use it instead of a \c LIST
+ *          where the list is only a stack (via push/pop). Heads are 64 bit words of
+ *          (tag << 32 | index): the tag is bumped on every update, so a node which was
+ *          popped and pushed back in between can't fool the compare-and-swap (ABA).
+ *          Free nodes live on a second stack of the same kind, so push and pop never
+ *          allocate nor lock.
+ */
+
+#include <stdlib.h>
+
+#include "lfstack.h"
+
+#define LFSTACK_EMPTY 0xFFFFFFFFu
+
+static inline uint64_t lfstack_tag(uint64_t head, uint32_t index)
+{
+	return (((head >> 32) + 1) << 32) | index;
+}
+
+static uint32_t lfstack_take(PLFSTACK pStack, uint64_t * head)
+{
+	uint64_t old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+	uint64_t new;
+
+	do
+	{
+		uint32_t index = (uint32_t) old;
+		if (index == LFSTACK_EMPTY)
+			return LFSTACK_EMPTY;
+
+		new = lfstack_tag(old, __atomic_load_n(&pStack->nodes[index].next, __ATOMIC_RELAXED));
+	} while (!__atomic_compare_exchange_n(
+				 head, &old, new, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	return (uint32_t) old;
+}
+
+static void lfstack_put(PLFSTACK pStack, uint64_t * head, uint32_t index)
+{
+	uint64_t old = __atomic_load_n(head, __ATOMIC_RELAXED);
+	uint64_t new;
+
+	do
+	{
+		__atomic_store_n(&pStack->nodes[index].next, (uint32_t) old, __ATOMIC_RELAXED);
+		new = lfstack_tag(old, index);
+	} while (!__atomic_compare_exchange_n(
+				 head, &old, new, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*!
+ * @brief Create a lock-free stack.
+ * @param capacity Maximum number of items.
+ * @returns A new instance of a stack.
+ * @retval NULL Indicates a memory allocation failure.
+ */
+PLFSTACK lfstack_create(unsigned int capacity)
+{
+	PLFSTACK pStack;
+	unsigned int i;
+
+	if (capacity == 0 || capacity >= LFSTACK_EMPTY)
+		return NULL;
+
+	pStack = (PLFSTACK)malloc(sizeof(LFSTACK));
+	if (pStack == NULL)
+		return NULL;
+
+	pStack->nodes = (PLFSTACK_NODE)malloc(capacity * sizeof(LFSTACK_NODE));
+	if (pStack->nodes == NULL)
+	{
+		free(pStack);
+		return NULL;
+	}
+
+	for (i = 0; i < capacity; i++)
+	{
+		pStack->nodes[i].data = NULL;
+		pStack->nodes[i].next = i + 1 < capacity ? i + 1 : LFSTACK_EMPTY;
+	}
+
+	pStack->capacity = capacity;
+	pStack->top = LFSTACK_EMPTY;
+	pStack->free = 0;
+
+	return pStack;
+}
+
+/*!
+ * @brief Destroy an existing stack.
+ * @details Nobody should use the stack at this point. The data held in the stack is
+ *          the responsibility of the caller to destroy.
+ * @param pStack The \c LFSTACK instance to destroy.
+ */
+void lfstack_destroy(PLFSTACK pStack)
+{
+	if (pStack == NULL)
+		return;
+
+	free(pStack->nodes);
+	free(pStack);
+}
+
+/*!
+ * @brief Push a data item onto the top of the stack.
+ * @param pStack Pointer to the \c LFSTACK to push the data to.
+ * @param data Pointer to the data to push.
+ * @returns Indication of success or failure.
+ * @retval false Indicates the stack is full.
+ */
+bool lfstack_push(PLFSTACK pStack, void * data)
+{
+	uint32_t index;
+
+	if (pStack == NULL)
+		return false;
+
+	index = lfstack_take(pStack, &pStack->free);
+	if (index == LFSTACK_EMPTY)
+		return false;
+
+	pStack->nodes[index].data = data;
+	lfstack_put(pStack, &pStack->top, index);
+
+	return true;
+}
+
+/*!
+ * @brief Pop a data value off the top of the stack.
+ * @param pStack Pointer to the \c LFSTACK to pop the value from.
+ * @returns The popped value.
+ * @retval NULL Indicates no data in the stack.
+ */
+void * lfstack_pop(PLFSTACK pStack)
+{
+	uint32_t index;
+	void * data;
+
+	if (pStack == NULL)
+		return NULL;
+
+	index = lfstack_take(pStack, &pStack->top);
+	if (index == LFSTACK_EMPTY)
+		return NULL;
+
+	data = pStack->nodes[index].data;
+	lfstack_put(pStack, &pStack->free, index);
+
+	return data;
+}
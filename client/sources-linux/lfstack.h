@@ -0,0 +1,32 @@
+/*!
+ * @file lfstack.h
+ * @brief Declarations for functions that operate on bounded lock-free stacks.
+ */
+#ifndef _PUPY_LIB_LFSTACK_H
+#define _PUPY_LIB_LFSTACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*! @brief Preallocated stack node, linked by index. */
+typedef struct _LFSTACK_NODE
+{
+	void * data;          ///< Reference to the data in the node.
+	uint32_t next;        ///< Index of the next node.
+} LFSTACK_NODE, *PLFSTACK_NODE;
+
+/*! @brief Container structure for a lock-free stack instance. */
+typedef struct _LFSTACK
+{
+	PLFSTACK_NODE nodes;  ///< Array of capacity nodes.
+	uint64_t top;         ///< Tagged index of the top of the stack.
+	uint64_t free;        ///< Tagged index of the top of the free nodes stack.
+	unsigned int capacity;
+} LFSTACK, *PLFSTACK;
+
+PLFSTACK lfstack_create(unsigned int capacity);
+void lfstack_destroy(PLFSTACK pStack);
+bool lfstack_push(PLFSTACK pStack, void * data);
+void * lfstack_pop(PLFSTACK pStack);
+
+#endif
@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "library.h"
+#include "decompress.h"
+#include "debug.h"
+
+/*
+
+  Embedded module library. Layout is produced by gen_library_compressed_string.py:
+  a sorted name table with per-entry offsets, every entry compressed on its own
+  (zlib or LZ4, see decompress.c).
+  Nothing is unpacked until somebody asks for a module.
+
+*/
+
+#define LIBRARY_MAGIC "PLB1"
+#define LIBRARY_HEADER_SIZE 8
+#define LIBRARY_ENTRY_SIZE 20
+
+static const char *library = NULL;
+static size_t library_size = 0;
+static unsigned int library_entries = 0;
+
+/* Dotted module name -> archive entries index, built once in library_init */
+typedef struct module_node {
+	uint32_t hash;
+	const char *fullname;
+	unsigned int index;
+	struct module_node *next;
+} module_node_t;
+
+static module_node_t **modules_buckets = NULL;
+static uint32_t modules_mask = 0;
+
+static inline
+uint32_t read_le32(const char *ptr) {
+	const unsigned char *p = (const unsigned char *) ptr;
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline
+uint32_t fnv1a(const char *str) {
+	uint32_t hash = 2166136261u;
+	while (*str) {
+		hash ^= (unsigned char) *str++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/* a/b/__init__.pyc -> a.b, a/b.so -> a.b */
+static
+void module_name(const library_entry_t *entry, char *fullname) {
+	const char *slash = strrchr(entry->name, '/');
+	const char *dot = strrchr(slash? slash : entry->name, '.');
+	size_t size = dot? dot - entry->name : entry->name_size;
+	size_t i;
+
+	for (i=0; i<size; i++)
+		fullname[i] = entry->name[i] == '/' ? '.' : entry->name[i];
+
+	fullname[size] = '\0';
+
+	if (dot && size >= 9 && !strcmp(fullname + size - 9, ".__init__") && (
+			!strcmp(dot, ".py") || !strcmp(dot, ".pyc") || !strcmp(dot, ".pyo")))
+		fullname[size - 9] = '\0';
+}
+
+static
+bool library_build_index(void) {
+	uint32_t buckets = 16;
+	size_t names_size = 0;
+	unsigned int i;
+	library_entry_t entry;
+
+	while (buckets < library_entries * 2)
+		buckets <<= 1;
+
+	for (i=0; i<library_entries; i++) {
+		if (!library_get(i, &entry))
+			return false;
+		names_size += entry.name_size + 1;
+	}
+
+	modules_buckets = calloc(buckets, sizeof(module_node_t *));
+	module_node_t *nodes = malloc(library_entries * sizeof(module_node_t) + 1);
+	char *names = malloc(names_size + 1);
+
+	if (!modules_buckets || !nodes || !names) {
+		free(modules_buckets);
+		free(nodes);
+		free(names);
+		modules_buckets = NULL;
+		return false;
+	}
+
+	modules_mask = buckets - 1;
+
+	for (i=0; i<library_entries; i++) {
+		library_get(i, &entry);
+		module_name(&entry, names);
+
+		nodes[i].hash = fnv1a(names);
+		nodes[i].fullname = names;
+		nodes[i].index = i;
+		nodes[i].next = modules_buckets[nodes[i].hash & modules_mask];
+		modules_buckets[nodes[i].hash & modules_mask] = &nodes[i];
+
+		names += strlen(names) + 1;
+	}
+
+	return true;
+}
+
+bool library_init(const char *archive, size_t size) {
+	if (size < LIBRARY_HEADER_SIZE || memcmp(archive, LIBRARY_MAGIC, 4)) {
+		dprint("Invalid library archive (%p:%lu)\n", archive, size);
+		return false;
+	}
+
+	unsigned int count = read_le32(archive + 4);
+	if (LIBRARY_HEADER_SIZE + (size_t) count * LIBRARY_ENTRY_SIZE > size) {
+		dprint("Truncated library archive: %u entries\n", count);
+		return false;
+	}
+
+	library = archive;
+	library_size = size;
+	library_entries = count;
+
+	if (!library_build_index()) {
+		dprint("Couldn't build library index\n");
+		library_entries = 0;
+		return false;
+	}
+
+	dprint("Library archive: %u entries\n", count);
+	return true;
+}
+
+unsigned int library_count(void) {
+	return library_entries;
+}
+
+bool library_get(unsigned int index, library_entry_t *entry) {
+	if (index >= library_entries)
+		return false;
+
+	const char *record = library + LIBRARY_HEADER_SIZE + index * LIBRARY_ENTRY_SIZE;
+	uint32_t name_offset = read_le32(record);
+	uint32_t data_offset = read_le32(record + 8);
+
+	entry->name_size = read_le32(record + 4);
+	entry->csize = read_le32(record + 12);
+	entry->usize = read_le32(record + 16);
+
+	if (name_offset + entry->name_size >= library_size ||
+		data_offset + entry->csize > library_size) {
+		dprint("Corrupted library entry %u\n", index);
+		return false;
+	}
+
+	entry->name = library + name_offset;
+	entry->data = library + data_offset;
+	return true;
+}
+
+bool library_find(const char *name, library_entry_t *entry) {
+	unsigned int low = 0;
+	unsigned int high = library_entries;
+
+	while (low < high) {
+		unsigned int middle = low + (high - low) / 2;
+		if (!library_get(middle, entry))
+			return false;
+
+		int cmp = strcmp(name, entry->name);
+		if (!cmp)
+			return true;
+
+		if (cmp < 0)
+			high = middle;
+		else
+			low = middle + 1;
+	}
+
+	return false;
+}
+
+bool library_inflate(const library_entry_t *entry, char *buffer) {
+	if (!entry->usize)
+		return true;
+
+	int r = decompress_buffer(buffer, entry->usize, entry->data, entry->csize);
+	if (r != Z_OK) {
+		dprint("Couldn't inflate %s: %d\n", entry->name, r);
+		return false;
+	}
+
+	return true;
+}
+
+unsigned int library_lookup(const char *fullname, unsigned int *indexes, unsigned int max) {
+	unsigned int found = 0;
+
+	if (!modules_buckets)
+		return 0;
+
+	uint32_t hash = fnv1a(fullname);
+	module_node_t *node = modules_buckets[hash & modules_mask];
+
+	for (; node && found < max; node = node->next) {
+		if (node->hash == hash && !strcmp(node->fullname, fullname))
+			indexes[found++] = node->index;
+	}
+
+	return found;
+}
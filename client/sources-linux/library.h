@@ -0,0 +1,24 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* One module of the embedded library archive (see gen_library_compressed_string.py) */
+typedef struct library_entry {
+	const char *name;
+	uint32_t name_size;
+	const char *data;
+	uint32_t csize;
+	uint32_t usize;
+} library_entry_t;
+
+bool library_init(const char *archive, size_t size);
+unsigned int library_count(void);
+bool library_get(unsigned int index, library_entry_t *entry);
+bool library_find(const char *name, library_entry_t *entry);
+bool library_inflate(const library_entry_t *entry, char *buffer);
+unsigned int library_lookup(const char *fullname, unsigned int *indexes, unsigned int max);
+
+#endif /* LIBRARY_H */
@@ -35,10 +35,23 @@ int, PyObject_IsInstance, (PyObject *, PyObject *)
 
 PyObject, PyInt_Type
 PyObject, _Py_NoneStruct
+PyObject, _Py_TrueStruct
+PyObject, _Py_NotImplementedStruct
+PyObject, _Py_EllipsisObject
+PyObject, PyString_Type
+PyObject, PyUnicode_Type
+PyObject, PyLong_Type
+PyObject, PyFloat_Type
+PyObject, PyComplex_Type
+PyObject, PyBool_Type
+PyObject, PyTuple_Type
+PyObject, PyFrozenSet_Type
+PyObject, PySlice_Type
 PyObject, _Py_ZeroStruct
 
 PyObject *, PyExc_ImportError
 PyObject *, PyExc_Exception
+PyObject *, PyExc_TypeError
 char *, _Py_PackageContext
 
 PyGILState_STATE, PyGILState_Ensure, (void)
@@ -47,6 +60,8 @@ void, PyGILState_Release, (PyGILState_STATE)
 void, PySys_SetObject, (char *, PyObject *)
 PyObject *, PySys_GetObject, (char *)
 PyObject *, PyString_FromString, (char *)
+PyObject *, PyString_FromStringAndSize, (const char *, Py_ssize_t)
+int, PyObject_AsWriteBuffer, (PyObject *, void **, Py_ssize_t *)
 int, Py_FdIsInteractive, (FILE *, char *)
 int, PyRun_InteractiveLoop, (FILE *, char *)
 void, PySys_SetArgv, (int, char **)
@@ -71,6 +86,19 @@ int, PyObject_IsTrue, (PyObject *)
 void, PyErr_SetString, (PyObject *, const char *)
 void, PyEval_InitThreads, (void)
 void, PySys_SetArgvEx, (int, char **, int)
+Py_ssize_t, PyTuple_Size, (PyObject *)
+PyObject *, PyTuple_GetItem, (PyObject *, Py_ssize_t)
+PyObject *, PySequence_Tuple, (PyObject *)
+PyObject *, PyObject_CallMethod, (PyObject *, char *, char *, ...)
+double, PyFloat_AsDouble, (PyObject *)
+PyObject *, PyFloat_FromDouble, (double)
+double, PyComplex_RealAsDouble, (PyObject *)
+double, PyComplex_ImagAsDouble, (PyObject *)
+PyObject *, PyComplex_FromDoubles, (double, double)
+PyObject *, PyLong_FromString, (char *, char **, int)
+PyObject *, PyNumber_Long, (PyObject *)
+PyObject *, PyFrozenSet_New, (PyObject *)
+PyObject *, PySlice_New, (PyObject *, PyObject *, PyObject *)
 '''.strip().splitlines()
 
 import string
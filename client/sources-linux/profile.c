@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "profile.h"
+#include "debug.h"
+
+/*
+
+  Fixed record of startup phases. Nothing is allocated, so it can be
+  used before libpython is there and from memdlopen at any time. Once
+  the record is full new phases are dropped; startup takes a few dozen.
+
+*/
+
+#define PROFILE_PHASES 128
+#define PROFILE_NAME 64
+
+typedef struct phase {
+	char name[PROFILE_NAME];
+	double started;
+	double duration;
+} phase_t;
+
+static phase_t phases[PROFILE_PHASES];
+static int phases_count = 0;
+static double origin = -1;
+static pthread_mutex_t phases_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline
+double profile_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int profile_start(const char *fmt, ...) {
+	double now = profile_now();
+	int phase = -1;
+	va_list args;
+
+	pthread_mutex_lock(&phases_lock);
+
+	if (origin < 0)
+		origin = now;
+
+	if (phases_count < PROFILE_PHASES) {
+		phase = phases_count++;
+
+		va_start(args, fmt);
+		vsnprintf(phases[phase].name, PROFILE_NAME, fmt, args);
+		va_end(args);
+
+		phases[phase].started = now - origin;
+		phases[phase].duration = -1;
+	}
+
+	pthread_mutex_unlock(&phases_lock);
+	return phase;
+}
+
+void profile_stop(int phase) {
+	double now = profile_now();
+
+	if (phase < 0)
+		return;
+
+	pthread_mutex_lock(&phases_lock);
+	phases[phase].duration = now - origin - phases[phase].started;
+	pthread_mutex_unlock(&phases_lock);
+
+	dprint("PROFILE: %s: %.6f\n", phases[phase].name, phases[phase].duration);
+}
+
+void profile_enumerate(profile_callback_t callback, void *data) {
+	int i;
+
+	pthread_mutex_lock(&phases_lock);
+
+	for (i=0; i<phases_count; i++) {
+		if (!callback(phases[i].name, phases[i].started, phases[i].duration, data))
+			break;
+	}
+
+	pthread_mutex_unlock(&phases_lock);
+}
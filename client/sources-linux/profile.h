@@ -0,0 +1,20 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+
+/* Startup phases, in the order they were started. Times are in seconds
+   on the monotonic clock, relative to the first recorded phase */
+
+typedef bool (*profile_callback_t)(
+	const char *name, double started, double duration, void *data);
+
+/* Open a phase, returns its slot or -1 when the record is full */
+int profile_start(const char *fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+
+void profile_stop(int phase);
+
+void profile_enumerate(profile_callback_t callback, void *data);
+
+#endif /* PROFILE_H */
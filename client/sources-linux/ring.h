@@ -0,0 +1,38 @@
+/*!
+ * @file ring.h
+ * @brief Declarations for functions that operate on bounded MPMC ring queues.
+ */
+#ifndef _PUPY_LIB_RING_H
+#define _PUPY_LIB_RING_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define RING_CACHELINE 64
+
+/*! @brief Slot of the ring; sequence tells whose turn it is to use the slot. */
+typedef struct _RING_CELL
+{
+	size_t sequence;      ///< Position this cell expects next.
+	void * data;          ///< Reference to the queued data.
+} RING_CELL, *PRING_CELL;
+
+/*! @brief Container structure for a ring instance. */
+typedef struct _RING
+{
+	PRING_CELL cells;     ///< Array of capacity cells.
+	size_t mask;          ///< Capacity - 1, capacity is a power of two.
+	char pad0[RING_CACHELINE - sizeof(PRING_CELL) - sizeof(size_t)];
+	size_t tail;          ///< Next position to push to.
+	char pad1[RING_CACHELINE - sizeof(size_t)];
+	size_t head;          ///< Next position to shift from.
+	char pad2[RING_CACHELINE - sizeof(size_t)];
+} RING, *PRING;
+
+PRING ring_create(unsigned int capacity);
+void ring_destroy(PRING pRing);
+unsigned int ring_count(PRING pRing);
+bool ring_push(PRING pRing, void * data);
+void * ring_shift(PRING pRing);
+
+#endif
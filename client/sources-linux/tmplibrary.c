@@ -1,6 +1,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <limits.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <alloca.h>
@@ -9,9 +10,11 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <pthread.h>
+#include <time.h>
 
-#include "list.h"
 #include "tmplibrary.h"
+#include "profile.h"
 #include "debug.h"
 
 #include "decompress.h"
@@ -79,23 +82,106 @@ const char *gettemptpl() {
 	return tmpdir;
 }
 
+/*
+
+  Loaded libraries registry. Lookups happen on every memdlopen (and every
+  C extension import), inserts only after a successful dlopen, so use
+  a fixed hash table under a rwlock.
+
+*/
+
+#define LIBRARIES_BUCKETS 256
+
 typedef struct library {
 	const char *name;
+	uint32_t hash;
 	void *base;
+	size_t size;
+	time_t loaded_at;
+	double load_time;
+	struct library *next;
 } library_t;
 
-bool search_library(void *pState, void *pData) {
-	library_t *search = (library_t *) pState;
-	library_t *current = (library_t *) pData;
+static library_t *libraries[LIBRARIES_BUCKETS];
+static pthread_rwlock_t libraries_lock;
+static pthread_once_t libraries_once = PTHREAD_ONCE_INIT;
+
+static
+void libraries_init(void) {
+	pthread_rwlock_init(&libraries_lock, NULL);
+}
+
+static inline
+uint32_t library_hash(const char *name) {
+	uint32_t hash = 2166136261u;
+	while (*name) {
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static
+library_t *search_library(const char *name, uint32_t hash) {
+	library_t *library = libraries[hash % LIBRARIES_BUCKETS];
+	for (; library; library = library->next) {
+		if (library->hash == hash && !strcmp(library->name, name))
+			return library;
+	}
+	return NULL;
+}
+
+static
+void *register_library(const char *name, uint32_t hash, void *base, size_t size, double load_time) {
+	library_t *record = (library_t *) malloc(sizeof(library_t));
+	if (!record)
+		return base;
+
+	record->name = strdup(name);
+	record->hash = hash;
+	record->base = base;
+	record->size = size;
+	record->loaded_at = time(NULL);
+	record->load_time = load_time;
+
+	pthread_rwlock_wrlock(&libraries_lock);
+
+	/* Somebody was faster */
+	library_t *found = search_library(name, hash);
+	if (found) {
+		pthread_rwlock_unlock(&libraries_lock);
+		dprint("SO %s was loaded concurrently: %p\n", name, found->base);
+		free((char *) record->name);
+		free(record);
+		dlclose(base);
+		return found->base;
+	}
+
+	record->next = libraries[hash % LIBRARIES_BUCKETS];
+	libraries[hash % LIBRARIES_BUCKETS] = record;
+
+	pthread_rwlock_unlock(&libraries_lock);
+	return base;
+}
+
+void memdlopen_enumerate(memdlopen_callback_t callback, void *data) {
+	int i;
 
-	if (!strcmp(search->name, current->name)) {
-		search->base = current->base;
-		dprint("FOUND! %s = %p\n", search->name, search->base);
+	pthread_once(&libraries_once, libraries_init);
+	pthread_rwlock_rdlock(&libraries_lock);
 
-		return true;
+	for (i=0; i<LIBRARIES_BUCKETS; i++) {
+		library_t *library;
+		for (library = libraries[i]; library; library = library->next) {
+			if (!callback(
+					library->name, library->base, library->size,
+					library->loaded_at, library->load_time, data))
+				goto out;
+		}
 	}
 
-	return false;
+ out:
+	pthread_rwlock_unlock(&libraries_lock);
 }
 
 bool drop_library(char *path, size_t path_size, const char *buffer, size_t size) {
@@ -113,7 +199,7 @@ bool drop_library(char *path, size_t path_size, const char *buffer, size_t size)
 
 	bool result = true;
 
-	if (size > 2 && buffer[0] == '\x1f' && buffer[1] == '\x8b') {
+	if (decompress_codec(buffer, size) != CODEC_NONE) {
 		dprint("Decompressing library %s\n", path);
 		int r = decompress(fd, buffer, size);
 		result = r == 0;
@@ -142,36 +228,46 @@ bool drop_library(char *path, size_t path_size, const char *buffer, size_t size)
 void *memdlopen(const char *soname, const char *buffer, size_t size) {
 	dprint("memdlopen(\"%s\", %p, %ull)\n", soname, buffer, size);
 
-	static PLIST libraries = NULL;
-	if (!libraries) {
-		libraries = list_create();
-	}
+	pthread_once(&libraries_once, libraries_init);
 
-	library_t search = {
-		.name = soname,
-		.base = NULL,
-	};
+	uint32_t hash = library_hash(soname);
 
-	if (list_enumerate(libraries, search_library, &search)) {
-		dprint("SO %s FOUND: %p\n", search.name, search.base);
-		return search.base;
+	pthread_rwlock_rdlock(&libraries_lock);
+	library_t *found = search_library(soname, hash);
+	void *base = found? found->base : NULL;
+	pthread_rwlock_unlock(&libraries_lock);
+
+	if (base) {
+		dprint("SO %s FOUND: %p\n", soname, base);
+		return base;
 	}
 
-	void *base = dlopen(soname, RTLD_NOLOAD);
+	base = dlopen(soname, RTLD_NOLOAD);
 	if (base) {
 		dprint("Library \"%s\" loaded from OS\n", soname);
 		return base;
 	}
 
+	struct timespec started, finished;
+	clock_gettime(CLOCK_MONOTONIC, &started);
+
 	char buf[PATH_MAX]={};
-	if (!drop_library(buf, PATH_MAX, buffer, size)) {
+	int phase = profile_start("memdlopen %s: %s", soname,
+		decompress_codec(buffer, size) != CODEC_NONE? "inflate" : "write");
+	bool dropped = drop_library(buf, PATH_MAX, buffer, size);
+	profile_stop(phase);
+
+	if (!dropped) {
 		dprint("Couldn't drop library %s: %m\n", soname);
 		return NULL;
 	}
 
 	dprint("Library \"%s\" dropped to \"%s\"\n", soname, buf);
 
+	phase = profile_start("memdlopen %s: dlopen", soname);
 	base = dlopen(buf, RTLD_NOW | RTLD_GLOBAL);
+	profile_stop(phase);
+
 	if (!base) {
 		dprint("Couldn't load library %s (%s): %s\n", soname, buf, dlerror());
 #ifndef DEBUG
@@ -180,12 +276,16 @@ void *memdlopen(const char *soname, const char *buffer, size_t size) {
 		return NULL;
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &finished);
+
 	dprint("Library %s loaded to %p\n", soname, base);
 
-	library_t *record = (library_t *) malloc(sizeof(library_t));
-	record->name = strdup(soname);
-	record->base = base;
-	list_add(libraries, record);
+	size_t usize = decompress_size(buffer, size);
+	base = register_library(
+		soname, hash, base,
+		usize? usize : size,
+		(finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9
+	);
 
 #ifndef DEBUG
 	unlink(buf);
@@ -3,8 +3,14 @@
 
 #include <sys/types.h>
 #include <stdbool.h>
+#include <time.h>
+
+typedef bool (*memdlopen_callback_t)(
+	const char *name, void *base, size_t size,
+	time_t loaded_at, double load_time, void *data);
 
 void *memdlopen(const char *soname, const char *buffer, size_t size);
+void memdlopen_enumerate(memdlopen_callback_t callback, void *data);
 bool drop_library(char *path, size_t path_size, const char *buffer, size_t size);
 
 #endif /* TMPLIBRARY_H */
@@ -0,0 +1,294 @@
+/*!
+ * @file vector.c
+ * @brief Definitions for functions that operate on vectors.
+ * @details A thread safe growable array. Same API style as \c LIST, but items are stored
+ *          contiguously, so indexed access is O(1) and there is no allocation per item.
+ *          Use it where a \c LIST is used as an array or a stack (via get/add/push/pop).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vector.h"
+
+#define VECTOR_MIN_CAPACITY 16
+
+/*!
+ * @brief Create a thread-safe vector.
+ * @param capacity Initial number of preallocated slots (0 for default).
+ * @returns A new instance of a vector.
+ * @retval NULL Indicates a memory allocation failure.
+ */
+PVECTOR vector_create(unsigned int capacity)
+{
+	PVECTOR pVector = (PVECTOR)malloc(sizeof(VECTOR));
+
+	if (pVector == NULL)
+		return NULL;
+
+	if (capacity < VECTOR_MIN_CAPACITY)
+		capacity = VECTOR_MIN_CAPACITY;
+
+	pVector->items = (void **)malloc(capacity * sizeof(void *));
+	if (pVector->items == NULL)
+	{
+		free(pVector);
+		return NULL;
+	}
+
+	pVector->count = 0;
+	pVector->capacity = capacity;
+	pthread_mutex_init(&pVector->lock, NULL);
+
+	return pVector;
+}
+
+/*!
+ * @brief Destroy an existing vector.
+ * @details The data held in the vector is the responsibility of the caller to destroy.
+ * @param pVector The \c VECTOR instance to destroy.
+ */
+void vector_destroy(PVECTOR pVector)
+{
+	if (pVector == NULL)
+		return;
+
+	pthread_mutex_destroy(&pVector->lock);
+	free(pVector->items);
+	free(pVector);
+}
+
+/*!
+ * @brief Get the number of items in the vector.
+ * @param pVector The \c VECTOR to get a count of.
+ * @returns The number of elements in the vector.
+ */
+unsigned int vector_count(PVECTOR pVector)
+{
+	unsigned int count = 0;
+
+	if (pVector != NULL)
+	{
+		pthread_mutex_lock(&pVector->lock);
+		count = pVector->count;
+		pthread_mutex_unlock(&pVector->lock);
+	}
+
+	return count;
+}
+
+/*!
+ * @brief Get the data value held in the vector at a specified index.
+ * @param pVector Pointer to the \c VECTOR to get the element from.
+ * @param index Index of the element to get.
+ * @returns Pointer to the item in the vector.
+ * @retval NULL Indicates the element doesn't exist in the vector.
+ */
+void * vector_get(PVECTOR pVector, unsigned int index)
+{
+	void * data = NULL;
+
+	if (pVector == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&pVector->lock);
+
+	if (index < pVector->count)
+		data = pVector->items[index];
+
+	pthread_mutex_unlock(&pVector->lock);
+
+	return data;
+}
+
+/*!
+ * @brief Replace the data value held in the vector at a specified index.
+ * @param pVector Pointer to the \c VECTOR to update.
+ * @param index Index of the element to replace.
+ * @param data The new data.
+ * @returns Indication of success or failure.
+ */
+bool vector_set(PVECTOR pVector, unsigned int index, void * data)
+{
+	bool result = false;
+
+	if (pVector == NULL)
+		return false;
+
+	pthread_mutex_lock(&pVector->lock);
+
+	if (index < pVector->count)
+	{
+		pVector->items[index] = data;
+		result = true;
+	}
+
+	pthread_mutex_unlock(&pVector->lock);
+
+	return result;
+}
+
+/*!
+ * @brief Add a data item onto the end of the vector.
+ * @sa vector_push
+ */
+bool vector_add(PVECTOR pVector, void * data)
+{
+	return vector_push(pVector, data);
+}
+
+/*!
+ * @brief Internal function to remove an item from a vector.
+ * @remark Assumes caller has aquired the appropriate lock first.
+ */
+static bool vector_remove_index(PVECTOR pVector, unsigned int index)
+{
+	if (index >= pVector->count)
+		return false;
+
+	memmove(
+		pVector->items + index, pVector->items + index + 1,
+		(pVector->count - index - 1) * sizeof(void *)
+	);
+
+	pVector->count -= 1;
+	return true;
+}
+
+/*!
+ * @brief Remove a given data item from the vector.
+ * @param pVector Pointer to the \c VECTOR to remove the item from.
+ * @param data The data that is to be removed from the vector.
+ * @remark Only the first occurrence is removed.
+ * @returns Indication of success or failure.
+ */
+bool vector_remove(PVECTOR pVector, void * data)
+{
+	bool result = false;
+	unsigned int index;
+
+	if (pVector == NULL)
+		return false;
+
+	pthread_mutex_lock(&pVector->lock);
+
+	for (index = 0; index < pVector->count; index++)
+	{
+		if (pVector->items[index] == data)
+		{
+			result = vector_remove_index(pVector, index);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&pVector->lock);
+
+	return result;
+}
+
+/*!
+ * @brief Remove a vector item at the specified index.
+ * @param pVector Pointer to the \c VECTOR to remove the item from.
+ * @param index Index of the item to remove.
+ * @returns Indication of success or failure.
+ */
+bool vector_delete(PVECTOR pVector, unsigned int index)
+{
+	bool result;
+
+	if (pVector == NULL)
+		return false;
+
+	pthread_mutex_lock(&pVector->lock);
+	result = vector_remove_index(pVector, index);
+	pthread_mutex_unlock(&pVector->lock);
+
+	return result;
+}
+
+/*!
+ * @brief Push a data item onto the end of the vector, growing it when full.
+ * @param pVector Pointer to the \c VECTOR to append the data to.
+ * @param data Pointer to the data to append.
+ * @returns Indication of success or failure.
+ */
+bool vector_push(PVECTOR pVector, void * data)
+{
+	bool result = true;
+
+	if (pVector == NULL)
+		return false;
+
+	pthread_mutex_lock(&pVector->lock);
+
+	if (pVector->count == pVector->capacity)
+	{
+		void ** items = (void **)realloc(
+			pVector->items, pVector->capacity * 2 * sizeof(void *)
+		);
+
+		if (items == NULL)
+		{
+			result = false;
+		}
+		else
+		{
+			pVector->items = items;
+			pVector->capacity *= 2;
+		}
+	}
+
+	if (result)
+		pVector->items[pVector->count++] = data;
+
+	pthread_mutex_unlock(&pVector->lock);
+
+	return result;
+}
+
+/*!
+ * @brief Pop a data value off the end of the vector.
+ * @param pVector Pointer to the \c VECTOR to pop the value from.
+ * @returns The popped value.
+ * @retval NULL Indicates no data in the vector.
+ */
+void * vector_pop(PVECTOR pVector)
+{
+	void * data = NULL;
+
+	if (pVector == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&pVector->lock);
+
+	if (pVector->count > 0)
+		data = pVector->items[--pVector->count];
+
+	pthread_mutex_unlock(&pVector->lock);
+
+	return data;
+}
+
+/*!
+ * @brief Iterate over the vector and call a function callback on each element.
+ * @param pVector Pointer to the \c VECTOR to enumerate.
+ * @param pCallback Callback function to invoke for each element in the vector.
+ * @param pState Pointer to the state to pass with each function call.
+ */
+bool vector_enumerate(PVECTOR pVector, PVECTORENUMCALLBACK pCallback, void * pState)
+{
+	bool bResult = false;
+	unsigned int index;
+
+	if (pVector == NULL || pCallback == NULL)
+		return false;
+
+	pthread_mutex_lock(&pVector->lock);
+
+	for (index = 0; index < pVector->count; index++)
+		bResult = pCallback(pState, pVector->items[index]) || bResult;
+
+	pthread_mutex_unlock(&pVector->lock);
+
+	return bResult;
+}
@@ -0,0 +1,34 @@
+/*!
+ * @file vector.h
+ * @brief Declarations for functions that operate on vectors.
+ */
+#ifndef _PUPY_LIB_VECTOR_H
+#define _PUPY_LIB_VECTOR_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/*! @brief Container structure for a vector instance. */
+typedef struct _VECTOR
+{
+	void ** items;           ///< Contiguous array of the data pointers.
+	unsigned int count;      ///< Count of elements in the vector.
+	unsigned int capacity;   ///< Allocated size of the items array.
+	pthread_mutex_t lock;    ///< Reference to the vector's synchronisation lock.
+} VECTOR, *PVECTOR;
+
+typedef bool (*PVECTORENUMCALLBACK)(void * pState, void * pData);
+
+PVECTOR vector_create(unsigned int capacity);
+void vector_destroy(PVECTOR pVector);
+unsigned int vector_count(PVECTOR pVector);
+void * vector_get(PVECTOR pVector, unsigned int index);
+bool vector_set(PVECTOR pVector, unsigned int index, void * data);
+bool vector_add(PVECTOR pVector, void * data);
+bool vector_remove(PVECTOR pVector, void * data);
+bool vector_delete(PVECTOR pVector, unsigned int index);
+bool vector_push(PVECTOR pVector, void * data);
+void * vector_pop(PVECTOR pVector);
+bool vector_enumerate(PVECTOR pVector, PVECTORENUMCALLBACK pCallback, void * pState);
+
+#endif
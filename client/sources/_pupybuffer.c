@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "Python-dynload.h"
+#include "handles.h"
+
+static char module_doc[] =
+"Chunked FIFO storage for network/lib/buffer.py";
+
+/*
+
+  Handle based API (there are no custom types with the dynload ABI, see
+  handles.h):
+  write appends into the tail chunk or a fresh one, read/peek copy
+  straight from the chunks into the resulting string, so nothing is
+  ever concatenated or re-sliced.
+
+*/
+
+#define CHUNK_SIZE (64 << 10)
+
+typedef struct chunk {
+	struct chunk *next;
+	size_t start;
+	size_t end;
+	size_t capacity;
+	char data[1];
+} chunk_t;
+
+typedef struct chunks {
+	chunk_t *head;
+	chunk_t *tail;
+	size_t size;
+} chunks_t;
+
+static handles_t handles;
+
+static chunks_t *lookup_chunks(long handle) {
+	chunks_t *chunks = (chunks_t *) handle_get(&handles, handle);
+	if (!chunks)
+		PyErr_SetString(PyExc_Exception, "invalid buffer handle");
+
+	return chunks;
+}
+
+static chunks_t *get_chunks(PyObject *args, Py_ssize_t *n) {
+	long handle;
+	Py_ssize_t dummy = -1;
+
+	if (!PyArg_ParseTuple(args, "l|n", &handle, n? n : &dummy))
+		return NULL;
+
+	return lookup_chunks(handle);
+}
+
+static void chunks_drain(chunks_t *chunks, size_t n) {
+	while (n && chunks->head) {
+		chunk_t *chunk = chunks->head;
+		size_t available = chunk->end - chunk->start;
+
+		if (n < available) {
+			chunk->start += n;
+			chunks->size -= n;
+			return;
+		}
+
+		n -= available;
+		chunks->size -= available;
+		chunks->head = chunk->next;
+		free(chunk);
+	}
+
+	if (!chunks->head)
+		chunks->tail = NULL;
+}
+
+static void chunks_copy(chunks_t *chunks, char *out, size_t n) {
+	chunk_t *chunk;
+
+	for (chunk = chunks->head; n && chunk; chunk = chunk->next) {
+		size_t available = chunk->end - chunk->start;
+		size_t size = n < available ? n : available;
+
+		memcpy(out, chunk->data + chunk->start, size);
+		out += size;
+		n -= size;
+	}
+}
+
+static PyObject *chunks_string(chunks_t *chunks, Py_ssize_t n, int drain) {
+	PyObject *result;
+	size_t size = (n < 0 || (size_t) n > chunks->size) ? chunks->size : (size_t) n;
+
+	result = PyString_FromStringAndSize(NULL, size);
+	if (!result)
+		return NULL;
+
+	chunks_copy(chunks, PyString_AsString(result), size);
+
+	if (drain)
+		chunks_drain(chunks, size);
+
+	return result;
+}
+
+static PyObject *Py_new(PyObject *self, PyObject *args)
+{
+	long handle;
+	chunks_t *chunks = (chunks_t *) calloc(1, sizeof(chunks_t));
+	if (!chunks) {
+		PyErr_SetString(PyExc_Exception, "out of memory");
+		return NULL;
+	}
+
+	handle = handle_new(&handles, chunks);
+	if (!handle) {
+		free(chunks);
+		PyErr_SetString(PyExc_Exception, "out of buffer handles");
+		return NULL;
+	}
+
+	return PyInt_FromLong(handle);
+}
+
+static PyObject *Py_free(PyObject *self, PyObject *args)
+{
+	long handle;
+	chunks_t *chunks;
+
+	if (!PyArg_ParseTuple(args, "l", &handle))
+		return NULL;
+
+	chunks = (chunks_t *) handle_release(&handles, handle);
+	if (!chunks) {
+		PyErr_SetString(PyExc_Exception, "invalid buffer handle");
+		return NULL;
+	}
+
+	chunks_drain(chunks, chunks->size);
+	free(chunks);
+
+	return Py_BuildValue("");
+}
+
+static PyObject *Py_write(PyObject *self, PyObject *args)
+{
+	long handle;
+	const char *data;
+	int size;
+	chunks_t *chunks;
+	chunk_t *chunk;
+
+	if (!PyArg_ParseTuple(args, "ls#", &handle, &data, &size))
+		return NULL;
+
+	chunks = lookup_chunks(handle);
+	if (!chunks)
+		return NULL;
+
+	chunk = chunks->tail;
+	if (chunk && chunk->capacity - chunk->end >= (size_t) size) {
+		memcpy(chunk->data + chunk->end, data, size);
+		chunk->end += size;
+	} else if (size) {
+		size_t capacity = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+		chunk = (chunk_t *) malloc(sizeof(chunk_t) + capacity);
+		if (!chunk) {
+			PyErr_SetString(PyExc_Exception, "out of memory");
+			return NULL;
+		}
+
+		chunk->next = NULL;
+		chunk->start = 0;
+		chunk->end = size;
+		chunk->capacity = capacity;
+		memcpy(chunk->data, data, size);
+
+		if (chunks->tail)
+			chunks->tail->next = chunk;
+		else
+			chunks->head = chunk;
+
+		chunks->tail = chunk;
+	}
+
+	chunks->size += size;
+	return PyInt_FromLong((long) chunks->size);
+}
+
+static PyObject *Py_read(PyObject *self, PyObject *args)
+{
+	Py_ssize_t n = -1;
+	chunks_t *chunks = get_chunks(args, &n);
+	if (!chunks)
+		return NULL;
+
+	return chunks_string(chunks, n, 1);
+}
+
+static PyObject *Py_peek(PyObject *self, PyObject *args)
+{
+	Py_ssize_t n = -1;
+	chunks_t *chunks = get_chunks(args, &n);
+	if (!chunks)
+		return NULL;
+
+	return chunks_string(chunks, n, 0);
+}
+
+static PyObject *Py_drain(PyObject *self, PyObject *args)
+{
+	Py_ssize_t n = -1;
+	chunks_t *chunks = get_chunks(args, &n);
+	if (!chunks)
+		return NULL;
+
+	chunks_drain(chunks, (n < 0 || (size_t) n > chunks->size) ? chunks->size : (size_t) n);
+	return Py_BuildValue("");
+}
+
+static PyObject *Py_length(PyObject *self, PyObject *args)
+{
+	chunks_t *chunks = get_chunks(args, NULL);
+	if (!chunks)
+		return NULL;
+
+	return PyInt_FromLong((long) chunks->size);
+}
+
+static PyMethodDef methods[] = {
+	{ "new", Py_new, METH_NOARGS, "new() -> handle" },
+	{ "free", Py_free, METH_VARARGS, "free(handle)" },
+	{ "write", Py_write, METH_VARARGS, "write(handle, data) -> length" },
+	{ "read", Py_read, METH_VARARGS, "read(handle, n=-1) -> string" },
+	{ "peek", Py_peek, METH_VARARGS, "peek(handle, n=-1) -> string" },
+	{ "drain", Py_drain, METH_VARARGS, "drain(handle, n=-1)" },
+	{ "length", Py_length, METH_VARARGS, "length(handle) -> int" },
+	{ NULL, NULL },		/* Sentinel */
+};
+
+DL_EXPORT(void)
+init_pupybuffer(void)
+{
+	Py_InitModule3("_pupybuffer", methods, module_doc);
+}
@@ -0,0 +1,758 @@
+#ifdef STANDALONE
+#  include <Python.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#ifndef STANDALONE
+#  include "Python-dynload.h"
+#endif
+
+#include "handles.h"
+
+static char module_doc[] =
+"AES-CBC/CTR, SHA256, HMAC-SHA256 and PBKDF2 for network/lib/transports";
+
+/* Built with STANDALONE as a regular extension for the server, see pupy/setup.py */
+
+/*
+
+  Handle based API like _pupybuffer: CBC carries the last cipher block and
+  CTR the counter and unused keystream from one call to the next, so a
+  handle stands for one direction of a stream.
+
+  AES is the usual four tables implementation, with tables generated at
+  init instead of being embedded. The decryption key schedule already has
+  InvMixColumns applied for the equivalent inverse cipher. There are no
+  AES-NI kernels here, the intrinsics need a newer compiler than ours.
+
+*/
+
+#define AES_BLOCK 16
+#define AES_MAX_ROUNDS 14
+
+#define SHA256_BLOCK 64
+#define SHA256_DIGEST 32
+
+#define GETU32(p) \
+	(((DWORD) (p)[0] << 24) | ((DWORD) (p)[1] << 16) | \
+	 ((DWORD) (p)[2] << 8) | (DWORD) (p)[3])
+
+#define PUTU32(p, v) do { \
+	(p)[0] = (BYTE) ((v) >> 24); (p)[1] = (BYTE) ((v) >> 16); \
+	(p)[2] = (BYTE) ((v) >> 8); (p)[3] = (BYTE) (v); \
+} while (0)
+
+typedef enum {
+	AES_MODE_CBC,
+	AES_MODE_CTR
+} aes_mode_t;
+
+typedef struct aes {
+	BYTE ek[AES_MAX_ROUNDS + 1][AES_BLOCK];
+	BYTE dk[AES_MAX_ROUNDS + 1][AES_BLOCK];
+	int rounds;
+	aes_mode_t mode;
+	BYTE iv[AES_BLOCK];     /* CBC: last cipher block, CTR: next counter */
+	BYTE stream[AES_BLOCK]; /* CTR: keystream of the previous counter */
+	size_t used;
+} aes_t;
+
+static BYTE S[256];
+static BYTE Si[256];
+static DWORD Te[4][256];
+static DWORD Td[4][256];
+
+static BYTE xtime(BYTE x)
+{
+	return (BYTE) ((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+}
+
+static BYTE gmul(BYTE a, BYTE b)
+{
+	BYTE p = 0;
+
+	while (b) {
+		if (b & 1)
+			p ^= a;
+		a = xtime(a);
+		b >>= 1;
+	}
+
+	return p;
+}
+
+#define ROTL8(x, n) ((BYTE) (((x) << (n)) | ((x) >> (8 - (n)))))
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void aes_tables_init(void)
+{
+	BYTE p = 1, q = 1;
+	int i, j;
+
+	/* Walk the multiplicative group with generator 3, q tracks 1/p */
+	do {
+		p = p ^ xtime(p);
+
+		q ^= q << 1;
+		q ^= q << 2;
+		q ^= q << 4;
+		if (q & 0x80)
+			q ^= 0x09;
+
+		S[p] = q ^ ROTL8(q, 1) ^ ROTL8(q, 2) ^ ROTL8(q, 3) ^ ROTL8(q, 4) ^ 0x63;
+	} while (p != 1);
+
+	S[0] = 0x63;
+
+	for (i = 0; i < 256; i++)
+		Si[S[i]] = (BYTE) i;
+
+	for (i = 0; i < 256; i++) {
+		BYTE s = S[i];
+		BYTE si = Si[i];
+
+		Te[0][i] = ((DWORD) xtime(s) << 24) | ((DWORD) s << 16) |
+			((DWORD) s << 8) | (DWORD) (xtime(s) ^ s);
+
+		Td[0][i] = ((DWORD) gmul(si, 14) << 24) | ((DWORD) gmul(si, 9) << 16) |
+			((DWORD) gmul(si, 13) << 8) | (DWORD) gmul(si, 11);
+
+		for (j = 1; j < 4; j++) {
+			Te[j][i] = ROTR32(Te[0][i], 8 * j);
+			Td[j][i] = ROTR32(Td[0][i], 8 * j);
+		}
+	}
+}
+
+static DWORD aes_subword(DWORD w)
+{
+	return ((DWORD) S[w >> 24] << 24) | ((DWORD) S[(w >> 16) & 0xff] << 16) |
+		((DWORD) S[(w >> 8) & 0xff] << 8) | (DWORD) S[w & 0xff];
+}
+
+static int aes_setkey(aes_t *aes, const BYTE *key, size_t keylen)
+{
+	DWORD w[4 * (AES_MAX_ROUNDS + 1)];
+	BYTE rcon = 1;
+	int nk, total, i, r;
+
+	if (keylen != 16 && keylen != 24 && keylen != 32)
+		return -1;
+
+	nk = (int) keylen / 4;
+	aes->rounds = nk + 6;
+	total = 4 * (aes->rounds + 1);
+
+	for (i = 0; i < nk; i++)
+		w[i] = GETU32(key + 4 * i);
+
+	for (; i < total; i++) {
+		DWORD t = w[i - 1];
+
+		if (i % nk == 0) {
+			t = aes_subword((t << 8) | (t >> 24)) ^ ((DWORD) rcon << 24);
+			rcon = xtime(rcon);
+		} else if (nk > 6 && i % nk == 4) {
+			t = aes_subword(t);
+		}
+
+		w[i] = w[i - nk] ^ t;
+	}
+
+	for (r = 0; r <= aes->rounds; r++) {
+		for (i = 0; i < 4; i++) {
+			DWORD t = w[4 * (aes->rounds - r) + i];
+
+			PUTU32(aes->ek[r] + 4 * i, w[4 * r + i]);
+
+			if (r > 0 && r < aes->rounds)
+				t = Td[0][S[t >> 24]] ^ Td[1][S[(t >> 16) & 0xff]] ^
+					Td[2][S[(t >> 8) & 0xff]] ^ Td[3][S[t & 0xff]];
+
+			PUTU32(aes->dk[r] + 4 * i, t);
+		}
+	}
+
+	memset(w, 0, sizeof(w));
+	return 0;
+}
+
+static void aes_encrypt_block(const aes_t *aes, const BYTE *in, BYTE *out)
+{
+	const BYTE *rk = aes->ek[0];
+	DWORD s0, s1, s2, s3, t0, t1, t2, t3;
+	int r;
+
+	s0 = GETU32(in) ^ GETU32(rk);
+	s1 = GETU32(in + 4) ^ GETU32(rk + 4);
+	s2 = GETU32(in + 8) ^ GETU32(rk + 8);
+	s3 = GETU32(in + 12) ^ GETU32(rk + 12);
+
+	for (r = 1; r < aes->rounds; r++) {
+		rk += AES_BLOCK;
+		t0 = Te[0][s0 >> 24] ^ Te[1][(s1 >> 16) & 0xff] ^ Te[2][(s2 >> 8) & 0xff] ^ Te[3][s3 & 0xff] ^ GETU32(rk);
+		t1 = Te[0][s1 >> 24] ^ Te[1][(s2 >> 16) & 0xff] ^ Te[2][(s3 >> 8) & 0xff] ^ Te[3][s0 & 0xff] ^ GETU32(rk + 4);
+		t2 = Te[0][s2 >> 24] ^ Te[1][(s3 >> 16) & 0xff] ^ Te[2][(s0 >> 8) & 0xff] ^ Te[3][s1 & 0xff] ^ GETU32(rk + 8);
+		t3 = Te[0][s3 >> 24] ^ Te[1][(s0 >> 16) & 0xff] ^ Te[2][(s1 >> 8) & 0xff] ^ Te[3][s2 & 0xff] ^ GETU32(rk + 12);
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+	}
+
+	rk += AES_BLOCK;
+	t0 = ((DWORD) S[s0 >> 24] << 24) ^ ((DWORD) S[(s1 >> 16) & 0xff] << 16) ^
+		((DWORD) S[(s2 >> 8) & 0xff] << 8) ^ (DWORD) S[s3 & 0xff] ^ GETU32(rk);
+	t1 = ((DWORD) S[s1 >> 24] << 24) ^ ((DWORD) S[(s2 >> 16) & 0xff] << 16) ^
+		((DWORD) S[(s3 >> 8) & 0xff] << 8) ^ (DWORD) S[s0 & 0xff] ^ GETU32(rk + 4);
+	t2 = ((DWORD) S[s2 >> 24] << 24) ^ ((DWORD) S[(s3 >> 16) & 0xff] << 16) ^
+		((DWORD) S[(s0 >> 8) & 0xff] << 8) ^ (DWORD) S[s1 & 0xff] ^ GETU32(rk + 8);
+	t3 = ((DWORD) S[s3 >> 24] << 24) ^ ((DWORD) S[(s0 >> 16) & 0xff] << 16) ^
+		((DWORD) S[(s1 >> 8) & 0xff] << 8) ^ (DWORD) S[s2 & 0xff] ^ GETU32(rk + 12);
+
+	PUTU32(out, t0);
+	PUTU32(out + 4, t1);
+	PUTU32(out + 8, t2);
+	PUTU32(out + 12, t3);
+}
+
+static void aes_decrypt_block(const aes_t *aes, const BYTE *in, BYTE *out)
+{
+	const BYTE *rk = aes->dk[0];
+	DWORD s0, s1, s2, s3, t0, t1, t2, t3;
+	int r;
+
+	s0 = GETU32(in) ^ GETU32(rk);
+	s1 = GETU32(in + 4) ^ GETU32(rk + 4);
+	s2 = GETU32(in + 8) ^ GETU32(rk + 8);
+	s3 = GETU32(in + 12) ^ GETU32(rk + 12);
+
+	for (r = 1; r < aes->rounds; r++) {
+		rk += AES_BLOCK;
+		t0 = Td[0][s0 >> 24] ^ Td[1][(s3 >> 16) & 0xff] ^ Td[2][(s2 >> 8) & 0xff] ^ Td[3][s1 & 0xff] ^ GETU32(rk);
+		t1 = Td[0][s1 >> 24] ^ Td[1][(s0 >> 16) & 0xff] ^ Td[2][(s3 >> 8) & 0xff] ^ Td[3][s2 & 0xff] ^ GETU32(rk + 4);
+		t2 = Td[0][s2 >> 24] ^ Td[1][(s1 >> 16) & 0xff] ^ Td[2][(s0 >> 8) & 0xff] ^ Td[3][s3 & 0xff] ^ GETU32(rk + 8);
+		t3 = Td[0][s3 >> 24] ^ Td[1][(s2 >> 16) & 0xff] ^ Td[2][(s1 >> 8) & 0xff] ^ Td[3][s0 & 0xff] ^ GETU32(rk + 12);
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+	}
+
+	rk += AES_BLOCK;
+	t0 = ((DWORD) Si[s0 >> 24] << 24) ^ ((DWORD) Si[(s3 >> 16) & 0xff] << 16) ^
+		((DWORD) Si[(s2 >> 8) & 0xff] << 8) ^ (DWORD) Si[s1 & 0xff] ^ GETU32(rk);
+	t1 = ((DWORD) Si[s1 >> 24] << 24) ^ ((DWORD) Si[(s0 >> 16) & 0xff] << 16) ^
+		((DWORD) Si[(s3 >> 8) & 0xff] << 8) ^ (DWORD) Si[s2 & 0xff] ^ GETU32(rk + 4);
+	t2 = ((DWORD) Si[s2 >> 24] << 24) ^ ((DWORD) Si[(s1 >> 16) & 0xff] << 16) ^
+		((DWORD) Si[(s0 >> 8) & 0xff] << 8) ^ (DWORD) Si[s3 & 0xff] ^ GETU32(rk + 8);
+	t3 = ((DWORD) Si[s3 >> 24] << 24) ^ ((DWORD) Si[(s2 >> 16) & 0xff] << 16) ^
+		((DWORD) Si[(s1 >> 8) & 0xff] << 8) ^ (DWORD) Si[s0 & 0xff] ^ GETU32(rk + 12);
+
+	PUTU32(out, t0);
+	PUTU32(out + 4, t1);
+	PUTU32(out + 8, t2);
+	PUTU32(out + 12, t3);
+}
+
+static void ctr_increment(BYTE *counter)
+{
+	int i;
+
+	for (i = AES_BLOCK - 1; i >= 0; i--)
+		if (++counter[i])
+			break;
+}
+
+static void xor_block(BYTE *out, const BYTE *a, const BYTE *b)
+{
+	int i;
+
+	for (i = 0; i < AES_BLOCK; i++)
+		out[i] = a[i] ^ b[i];
+}
+
+static void cbc_encrypt(aes_t *aes, BYTE *out, const BYTE *in, size_t blocks)
+{
+	BYTE block[AES_BLOCK];
+
+	for (; blocks; blocks--, in += AES_BLOCK, out += AES_BLOCK) {
+		xor_block(block, in, aes->iv);
+		aes_encrypt_block(aes, block, aes->iv);
+		memcpy(out, aes->iv, AES_BLOCK);
+	}
+}
+
+static void cbc_decrypt(aes_t *aes, BYTE *out, const BYTE *in, size_t blocks)
+{
+	BYTE block[AES_BLOCK];
+
+	for (; blocks; blocks--, in += AES_BLOCK, out += AES_BLOCK) {
+		aes_decrypt_block(aes, in, block);
+		xor_block(out, block, aes->iv);
+		memcpy(aes->iv, in, AES_BLOCK);
+	}
+}
+
+static void ctr_crypt(aes_t *aes, BYTE *out, const BYTE *in, size_t blocks)
+{
+	BYTE block[AES_BLOCK];
+
+	for (; blocks; blocks--, in += AES_BLOCK, out += AES_BLOCK) {
+		aes_encrypt_block(aes, aes->iv, block);
+		ctr_increment(aes->iv);
+		xor_block(out, in, block);
+	}
+}
+
+
+static void ctr_stream(aes_t *aes, BYTE *out, const BYTE *in, size_t size)
+{
+	size_t blocks;
+
+	/* Finish the keystream block the previous call started */
+	for (; size && aes->used < AES_BLOCK; size--)
+		*out++ = *in++ ^ aes->stream[aes->used++];
+
+	blocks = size / AES_BLOCK;
+	if (blocks) {
+		ctr_crypt(aes, out, in, blocks);
+		in += blocks * AES_BLOCK;
+		out += blocks * AES_BLOCK;
+		size -= blocks * AES_BLOCK;
+	}
+
+	if (size) {
+		aes_encrypt_block(aes, aes->iv, aes->stream);
+		ctr_increment(aes->iv);
+
+		for (aes->used = 0; aes->used < size; aes->used++)
+			out[aes->used] = in[aes->used] ^ aes->stream[aes->used];
+	}
+}
+
+typedef struct sha256 {
+	DWORD state[8];
+	unsigned __int64 length;
+	BYTE block[SHA256_BLOCK];
+	size_t used;
+} sha256_t;
+
+static const DWORD K256[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void sha256_compress(DWORD *state, const BYTE *block)
+{
+	DWORD w[64];
+	DWORD a, b, c, d, e, f, g, h;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = GETU32(block + 4 * i);
+
+	for (; i < 64; i++) {
+		DWORD s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		DWORD s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+	for (i = 0; i < 64; i++) {
+		DWORD t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) +
+			((e & f) ^ (~e & g)) + K256[i] + w[i];
+		DWORD t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) +
+			((a & b) ^ (a & c) ^ (b & c));
+
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void sha256_init(sha256_t *ctx)
+{
+	static const DWORD H0[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	memcpy(ctx->state, H0, sizeof(H0));
+	ctx->length = 0;
+	ctx->used = 0;
+}
+
+static void sha256_update(sha256_t *ctx, const BYTE *data, size_t size)
+{
+	ctx->length += size;
+
+	if (ctx->used) {
+		size_t n = SHA256_BLOCK - ctx->used;
+		if (n > size)
+			n = size;
+
+		memcpy(ctx->block + ctx->used, data, n);
+		ctx->used += n;
+		data += n;
+		size -= n;
+
+		if (ctx->used < SHA256_BLOCK)
+			return;
+
+		sha256_compress(ctx->state, ctx->block);
+		ctx->used = 0;
+	}
+
+	for (; size >= SHA256_BLOCK; size -= SHA256_BLOCK, data += SHA256_BLOCK)
+		sha256_compress(ctx->state, data);
+
+	memcpy(ctx->block, data, size);
+	ctx->used = size;
+}
+
+static void sha256_final(sha256_t *ctx, BYTE *digest)
+{
+	unsigned __int64 bits = ctx->length << 3;
+	int i;
+
+	ctx->block[ctx->used++] = 0x80;
+	if (ctx->used > SHA256_BLOCK - 8) {
+		memset(ctx->block + ctx->used, 0, SHA256_BLOCK - ctx->used);
+		sha256_compress(ctx->state, ctx->block);
+		ctx->used = 0;
+	}
+
+	memset(ctx->block + ctx->used, 0, SHA256_BLOCK - 8 - ctx->used);
+	PUTU32(ctx->block + SHA256_BLOCK - 8, (DWORD) (bits >> 32));
+	PUTU32(ctx->block + SHA256_BLOCK - 4, (DWORD) bits);
+	sha256_compress(ctx->state, ctx->block);
+
+	for (i = 0; i < 8; i++)
+		PUTU32(digest + 4 * i, ctx->state[i]);
+}
+
+typedef struct hmac_sha256 {
+	sha256_t inner;
+	sha256_t outer;
+} hmac_sha256_t;
+
+static void hmac_sha256_init(hmac_sha256_t *ctx, const BYTE *key, size_t keylen)
+{
+	BYTE pad[SHA256_BLOCK];
+	BYTE digest[SHA256_DIGEST];
+	int i;
+
+	if (keylen > SHA256_BLOCK) {
+		sha256_init(&ctx->inner);
+		sha256_update(&ctx->inner, key, keylen);
+		sha256_final(&ctx->inner, digest);
+		key = digest;
+		keylen = SHA256_DIGEST;
+	}
+
+	memset(pad, 0, sizeof(pad));
+	memcpy(pad, key, keylen);
+
+	for (i = 0; i < SHA256_BLOCK; i++)
+		pad[i] ^= 0x36;
+
+	sha256_init(&ctx->inner);
+	sha256_update(&ctx->inner, pad, SHA256_BLOCK);
+
+	for (i = 0; i < SHA256_BLOCK; i++)
+		pad[i] ^= 0x36 ^ 0x5c;
+
+	sha256_init(&ctx->outer);
+	sha256_update(&ctx->outer, pad, SHA256_BLOCK);
+
+	memset(pad, 0, sizeof(pad));
+	memset(digest, 0, sizeof(digest));
+}
+
+static void hmac_sha256_final(hmac_sha256_t *ctx, BYTE *digest)
+{
+	sha256_final(&ctx->inner, digest);
+	sha256_update(&ctx->outer, digest, SHA256_DIGEST);
+	sha256_final(&ctx->outer, digest);
+}
+
+static void pbkdf2_sha256(
+	const BYTE *password, size_t password_size,
+	const BYTE *salt, size_t salt_size,
+	unsigned long iterations, BYTE *out, size_t size)
+{
+	hmac_sha256_t base, ctx;
+	BYTE u[SHA256_DIGEST];
+	BYTE t[SHA256_DIGEST];
+	BYTE index[4];
+	DWORD block;
+	unsigned long i;
+	int j;
+
+	/* Keyed pads are hashed once, every iteration starts from a copy */
+	hmac_sha256_init(&base, password, password_size);
+
+	for (block = 1; size; block++) {
+		size_t n = size < SHA256_DIGEST ? size : SHA256_DIGEST;
+
+		PUTU32(index, block);
+
+		ctx = base;
+		sha256_update(&ctx.inner, salt, salt_size);
+		sha256_update(&ctx.inner, index, sizeof(index));
+		hmac_sha256_final(&ctx, u);
+		memcpy(t, u, SHA256_DIGEST);
+
+		for (i = 1; i < iterations; i++) {
+			ctx = base;
+			sha256_update(&ctx.inner, u, SHA256_DIGEST);
+			hmac_sha256_final(&ctx, u);
+
+			for (j = 0; j < SHA256_DIGEST; j++)
+				t[j] ^= u[j];
+		}
+
+		memcpy(out, t, n);
+		out += n;
+		size -= n;
+	}
+
+	memset(&base, 0, sizeof(base));
+	memset(&ctx, 0, sizeof(ctx));
+	memset(u, 0, sizeof(u));
+	memset(t, 0, sizeof(t));
+}
+
+static handles_t handles;
+
+static aes_t *get_aes(PyObject *args, const char **data, int *size) {
+	long handle;
+	aes_t *aes;
+
+	if (!PyArg_ParseTuple(args, "ls#", &handle, data, size))
+		return NULL;
+
+	aes = (aes_t *) handle_get(&handles, handle);
+	if (!aes)
+		PyErr_SetString(PyExc_Exception, "invalid cipher handle");
+
+	return aes;
+}
+
+static PyObject *aes_new(PyObject *args, aes_mode_t mode)
+{
+	const char *key;
+	int keylen;
+	const char *iv;
+	int ivlen;
+	aes_t *aes;
+	long handle;
+
+	if (!PyArg_ParseTuple(args, "s#s#", &key, &keylen, &iv, &ivlen))
+		return NULL;
+
+	if (ivlen != AES_BLOCK) {
+		PyErr_SetString(PyExc_Exception, "iv must be 16 bytes");
+		return NULL;
+	}
+
+	aes = (aes_t *) malloc(sizeof(aes_t));
+	if (!aes) {
+		PyErr_SetString(PyExc_Exception, "out of memory");
+		return NULL;
+	}
+
+	if (aes_setkey(aes, (const BYTE *) key, keylen) == -1) {
+		free(aes);
+		PyErr_SetString(PyExc_Exception, "key must be 16, 24 or 32 bytes");
+		return NULL;
+	}
+
+	aes->mode = mode;
+	aes->used = AES_BLOCK;
+	memcpy(aes->iv, iv, AES_BLOCK);
+
+	handle = handle_new(&handles, aes);
+	if (!handle) {
+		memset(aes, 0, sizeof(aes_t));
+		free(aes);
+		PyErr_SetString(PyExc_Exception, "out of cipher handles");
+		return NULL;
+	}
+
+	return PyInt_FromLong(handle);
+}
+
+static PyObject *aes_crypt(PyObject *args, int encrypt)
+{
+	const char *data;
+	int size;
+	PyObject *result;
+	BYTE *out;
+	aes_t *aes = get_aes(args, &data, &size);
+	if (!aes)
+		return NULL;
+
+	if (aes->mode == AES_MODE_CBC && size % AES_BLOCK) {
+		PyErr_SetString(PyExc_Exception, "data must be a multiple of 16 bytes");
+		return NULL;
+	}
+
+	result = PyString_FromStringAndSize(NULL, size);
+	if (!result)
+		return NULL;
+
+	out = (BYTE *) PyString_AsString(result);
+
+	if (aes->mode == AES_MODE_CTR)
+		ctr_stream(aes, out, (const BYTE *) data, size);
+	else if (encrypt)
+		cbc_encrypt(aes, out, (const BYTE *) data, size / AES_BLOCK);
+	else
+		cbc_decrypt(aes, out, (const BYTE *) data, size / AES_BLOCK);
+
+	return result;
+}
+
+static PyObject *Py_aes_cbc(PyObject *self, PyObject *args)
+{
+	return aes_new(args, AES_MODE_CBC);
+}
+
+static PyObject *Py_aes_ctr(PyObject *self, PyObject *args)
+{
+	return aes_new(args, AES_MODE_CTR);
+}
+
+static PyObject *Py_aes_encrypt(PyObject *self, PyObject *args)
+{
+	return aes_crypt(args, 1);
+}
+
+static PyObject *Py_aes_decrypt(PyObject *self, PyObject *args)
+{
+	return aes_crypt(args, 0);
+}
+
+static PyObject *Py_aes_free(PyObject *self, PyObject *args)
+{
+	long handle;
+	aes_t *aes;
+
+	if (!PyArg_ParseTuple(args, "l", &handle))
+		return NULL;
+
+	aes = (aes_t *) handle_release(&handles, handle);
+	if (!aes) {
+		PyErr_SetString(PyExc_Exception, "invalid cipher handle");
+		return NULL;
+	}
+
+	memset(aes, 0, sizeof(aes_t));
+	free(aes);
+
+	return Py_BuildValue("");
+}
+
+static PyObject *Py_aesni(PyObject *self, PyObject *args)
+{
+	return PyBool_FromLong(0);
+}
+
+static PyObject *Py_sha256(PyObject *self, PyObject *args)
+{
+	const char *data;
+	int size;
+	sha256_t ctx;
+	BYTE digest[SHA256_DIGEST];
+
+	if (!PyArg_ParseTuple(args, "s#", &data, &size))
+		return NULL;
+
+	sha256_init(&ctx);
+	sha256_update(&ctx, (const BYTE *) data, size);
+	sha256_final(&ctx, digest);
+
+	return PyString_FromStringAndSize((const char *) digest, SHA256_DIGEST);
+}
+
+static PyObject *Py_hmac_sha256(PyObject *self, PyObject *args)
+{
+	const char *key;
+	int keylen;
+	const char *data;
+	int size;
+	hmac_sha256_t ctx;
+	BYTE digest[SHA256_DIGEST];
+
+	if (!PyArg_ParseTuple(args, "s#s#", &key, &keylen, &data, &size))
+		return NULL;
+
+	hmac_sha256_init(&ctx, (const BYTE *) key, keylen);
+	sha256_update(&ctx.inner, (const BYTE *) data, size);
+	hmac_sha256_final(&ctx, digest);
+	memset(&ctx, 0, sizeof(ctx));
+
+	return PyString_FromStringAndSize((const char *) digest, SHA256_DIGEST);
+}
+
+static PyObject *Py_pbkdf2_sha256(PyObject *self, PyObject *args)
+{
+	const char *password;
+	int password_size;
+	const char *salt;
+	int salt_size;
+	int iterations;
+	int keylen;
+	PyObject *result;
+
+	if (!PyArg_ParseTuple(args, "s#s#ii", &password, &password_size,
+			&salt, &salt_size, &iterations, &keylen))
+		return NULL;
+
+	if (iterations < 1 || keylen < 0) {
+		PyErr_SetString(PyExc_Exception, "invalid iterations or key length");
+		return NULL;
+	}
+
+	result = PyString_FromStringAndSize(NULL, keylen);
+	if (!result)
+		return NULL;
+
+	pbkdf2_sha256(
+		(const BYTE *) password, password_size,
+		(const BYTE *) salt, salt_size,
+		iterations, (BYTE *) PyString_AsString(result), keylen);
+
+	return result;
+}
+
+static PyMethodDef methods[] = {
+	{ "aes_cbc", Py_aes_cbc, METH_VARARGS, "aes_cbc(key, iv) -> handle" },
+	{ "aes_ctr", Py_aes_ctr, METH_VARARGS, "aes_ctr(key, counter block) -> handle" },
+	{ "aes_encrypt", Py_aes_encrypt, METH_VARARGS, "aes_encrypt(handle, data) -> string" },
+	{ "aes_decrypt", Py_aes_decrypt, METH_VARARGS, "aes_decrypt(handle, data) -> string" },
+	{ "aes_free", Py_aes_free, METH_VARARGS, "aes_free(handle)" },
+	{ "aesni", Py_aesni, METH_NOARGS, "aesni() -> True if AES-NI is used" },
+	{ "sha256", Py_sha256, METH_VARARGS, "sha256(data) -> digest" },
+	{ "hmac_sha256", Py_hmac_sha256, METH_VARARGS, "hmac_sha256(key, data) -> digest" },
+	{ "pbkdf2_sha256", Py_pbkdf2_sha256, METH_VARARGS,
+	  "pbkdf2_sha256(password, salt, iterations, keylen) -> key" },
+	{ NULL, NULL },		/* Sentinel */
+};
+
+DL_EXPORT(void)
+init_pupycrypto(void)
+{
+	aes_tables_init();
+
+	Py_InitModule3("_pupycrypto", methods, module_doc);
+}
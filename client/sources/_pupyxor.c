@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <emmintrin.h>
+
+#include "Python-dynload.h"
+
+static char module_doc[] =
+"Repeating key XOR for network/lib/transports/xor.py";
+
+/*
+
+  Keystream is the key repeated at an arbitrary offset. Expand it once
+  into a pattern of period + width bytes, so a window of any vector width
+  can be loaded from any key position without wrapping. Period is the
+  smallest multiple of the key length not shorter than the widest vector,
+  so advancing the position never needs a division.
+
+*/
+
+#define XOR_MAX_WIDTH 16
+#define XOR_STACK_PATTERN 4096
+
+typedef size_t (*xor_kernel_t)(
+	char *out, const char *in, size_t size,
+	const char *pattern, size_t period, size_t offset);
+
+static size_t xor_kernel_word(
+	char *out, const char *in, size_t size,
+	const char *pattern, size_t period, size_t offset)
+{
+	size_t i = 0;
+
+	for (; i + sizeof(unsigned __int64) <= size; i += sizeof(unsigned __int64)) {
+		unsigned __int64 a, b;
+		memcpy(&a, in + i, sizeof(a));
+		memcpy(&b, pattern + offset, sizeof(b));
+		a ^= b;
+		memcpy(out + i, &a, sizeof(a));
+		offset += sizeof(unsigned __int64);
+		if (offset >= period)
+			offset -= period;
+	}
+
+	for (; i < size; i++) {
+		out[i] = in[i] ^ pattern[offset];
+		if (++offset == period)
+			offset = 0;
+	}
+
+	return offset;
+}
+
+static size_t xor_kernel_sse2(
+	char *out, const char *in, size_t size,
+	const char *pattern, size_t period, size_t offset)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= size; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (in + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (pattern + offset));
+		_mm_storeu_si128((__m128i *) (out + i), _mm_xor_si128(a, b));
+		offset += 16;
+		if (offset >= period)
+			offset -= period;
+	}
+
+	return xor_kernel_word(out + i, in + i, size - i, pattern, period, offset);
+}
+
+static xor_kernel_t xor_kernel = xor_kernel_word;
+
+static size_t xor_stream(
+	char *out, const char *in, size_t size,
+	const char *key, size_t keylen, size_t offset)
+{
+	char stack_pattern[XOR_STACK_PATTERN];
+	char *pattern = stack_pattern;
+	size_t period = keylen * ((XOR_MAX_WIDTH + keylen - 1) / keylen);
+	size_t pattern_size = period + XOR_MAX_WIDTH;
+	size_t i;
+
+	if (pattern_size > sizeof(stack_pattern)) {
+		pattern = malloc(pattern_size);
+		if (!pattern)
+			return (size_t) -1;
+	}
+
+	for (i = 0; i < pattern_size; i++)
+		pattern[i] = key[i % keylen];
+
+	offset = xor_kernel(out, in, size, pattern, period, offset % keylen);
+
+	if (pattern != stack_pattern)
+		free(pattern);
+
+	return offset % keylen;
+}
+
+static PyObject *Py_xor(PyObject *self, PyObject *args)
+{
+	const char *data;
+	int size;
+	const char *key;
+	int keylen;
+	Py_ssize_t offset = 0;
+	PyObject *result;
+
+	if (!PyArg_ParseTuple(args, "s#s#|n", &data, &size, &key, &keylen, &offset))
+		return NULL;
+
+	if (keylen <= 0 || offset < 0) {
+		PyErr_SetString(PyExc_Exception, "invalid key or offset");
+		return NULL;
+	}
+
+	result = PyString_FromStringAndSize(NULL, size);
+	if (!result)
+		return NULL;
+
+	offset = xor_stream(PyString_AsString(result), data, size, key, keylen, offset);
+	if (offset == -1) {
+		Py_DECREF(result);
+		PyErr_SetString(PyExc_Exception, "out of memory");
+		return NULL;
+	}
+
+	return Py_BuildValue("Nn", result, offset);
+}
+
+static PyObject *Py_xor_inplace(PyObject *self, PyObject *args)
+{
+	PyObject *buffer;
+	void *data;
+	Py_ssize_t size;
+	const char *key;
+	int keylen;
+	Py_ssize_t offset = 0;
+
+	if (!PyArg_ParseTuple(args, "Os#|n", &buffer, &key, &keylen, &offset))
+		return NULL;
+
+	if (keylen <= 0 || offset < 0) {
+		PyErr_SetString(PyExc_Exception, "invalid key or offset");
+		return NULL;
+	}
+
+	if (PyObject_AsWriteBuffer(buffer, &data, &size) == -1)
+		return NULL;
+
+	offset = xor_stream(data, data, size, key, keylen, offset);
+	if (offset == -1) {
+		PyErr_SetString(PyExc_Exception, "out of memory");
+		return NULL;
+	}
+
+	return Py_BuildValue("n", offset);
+}
+
+static PyMethodDef methods[] = {
+	{ "xor", Py_xor, METH_VARARGS,
+	  "xor(data, key, offset=0) -> (xored, new offset)" },
+	{ "xor_inplace", Py_xor_inplace, METH_VARARGS,
+	  "xor_inplace(writable buffer, key, offset=0) -> new offset" },
+	{ NULL, NULL },		/* Sentinel */
+};
+
+DL_EXPORT(void)
+init_pupyxor(void)
+{
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		xor_kernel = xor_kernel_sse2;
+
+	Py_InitModule3("_pupyxor", methods, module_doc);
+}
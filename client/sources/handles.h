@@ -0,0 +1,109 @@
+#ifndef __HANDLES_H
+#define __HANDLES_H
+
+#include <stdlib.h>
+
+/*
+
+  Handles of the native state the modules give out to python in place of
+  pointers (there are no custom types with the dynload ABI). A handle is
+  the slot index + 1 and the generation of the slot, so an unknown, freed
+  or forged handle is rejected instead of being dereferenced. Handles are
+  positive and fit a C long on every platform. Only used with the GIL
+  held, each module has its own table.
+
+*/
+
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_INDEX_MAX ((1UL << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1UL << (31 - HANDLE_INDEX_BITS)) - 1)
+
+typedef struct handle_slot {
+	void *object;
+	unsigned long generation;
+	unsigned long next_free;     /* index + 1 of the next free slot */
+} handle_slot_t;
+
+typedef struct handles {
+	handle_slot_t *slots;
+	unsigned long used;          /* slots ever handed out */
+	unsigned long capacity;
+	unsigned long free;          /* index + 1 of the first free slot */
+} handles_t;
+
+/* 0 when the table is full or out of memory */
+static long handle_new(handles_t *handles, void *object) {
+	unsigned long index;
+	handle_slot_t *slot;
+
+	if (handles->free) {
+		index = handles->free - 1;
+		handles->free = handles->slots[index].next_free;
+	} else {
+		if (handles->used == HANDLE_INDEX_MAX)
+			return 0;
+
+		if (handles->used == handles->capacity) {
+			unsigned long capacity = handles->capacity ? handles->capacity * 2 : 64;
+			handle_slot_t *slots;
+
+			if (capacity > HANDLE_INDEX_MAX)
+				capacity = HANDLE_INDEX_MAX;
+
+			slots = (handle_slot_t *) realloc(handles->slots, capacity * sizeof(handle_slot_t));
+			if (!slots)
+				return 0;
+
+			handles->slots = slots;
+			handles->capacity = capacity;
+		}
+
+		index = handles->used ++;
+		handles->slots[index].generation = 0;
+	}
+
+	slot = &handles->slots[index];
+	slot->object = object;
+	slot->next_free = 0;
+
+	return (long) ((slot->generation << HANDLE_INDEX_BITS) | (index + 1));
+}
+
+static handle_slot_t *handle_slot(handles_t *handles, long handle) {
+	unsigned long index = ((unsigned long) handle & HANDLE_INDEX_MAX);
+	handle_slot_t *slot;
+
+	if (handle <= 0 || !index || index > handles->used)
+		return NULL;
+
+	slot = &handles->slots[index - 1];
+	if (!slot->object || slot->generation != ((unsigned long) handle >> HANDLE_INDEX_BITS))
+		return NULL;
+
+	return slot;
+}
+
+/* NULL for an unknown or freed handle */
+static void *handle_get(handles_t *handles, long handle) {
+	handle_slot_t *slot = handle_slot(handles, handle);
+	return slot ? slot->object : NULL;
+}
+
+/* the object, the handle is invalid afterwards */
+static void *handle_release(handles_t *handles, long handle) {
+	handle_slot_t *slot = handle_slot(handles, handle);
+	void *object;
+
+	if (!slot)
+		return NULL;
+
+	object = slot->object;
+	slot->object = NULL;
+	slot->generation = (slot->generation + 1) & HANDLE_GENERATION_MASK;
+	slot->next_free = handles->free;
+	handles->free = (slot - handles->slots) + 1;
+
+	return object;
+}
+
+#endif
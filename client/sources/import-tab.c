@@ -37,14 +37,29 @@
 	{ "PyObject_IsInstance", NULL },
 	{ "PyInt_Type", NULL },
 	{ "_Py_NoneStruct", NULL },
+	{ "_Py_TrueStruct", NULL },
+	{ "_Py_NotImplementedStruct", NULL },
+	{ "_Py_EllipsisObject", NULL },
+	{ "PyString_Type", NULL },
+	{ "PyUnicode_Type", NULL },
+	{ "PyLong_Type", NULL },
+	{ "PyFloat_Type", NULL },
+	{ "PyComplex_Type", NULL },
+	{ "PyBool_Type", NULL },
+	{ "PyTuple_Type", NULL },
+	{ "PyFrozenSet_Type", NULL },
+	{ "PySlice_Type", NULL },
 	{ "PyExc_ImportError", NULL },
 	{ "PyExc_Exception", NULL },
+	{ "PyExc_TypeError", NULL },
 	{ "_Py_PackageContext", NULL },
 	{ "PyGILState_Ensure", NULL },
 	{ "PyGILState_Release", NULL },
 	{ "PySys_SetObject", NULL },
 	{ "PySys_GetObject", NULL },
 	{ "PyString_FromString", NULL },
+	{ "PyString_FromStringAndSize", NULL },
+	{ "PyObject_AsWriteBuffer", NULL },
 	{ "Py_FdIsInteractive", NULL },
 	{ "PyRun_InteractiveLoop", NULL },
 	{ "PySys_SetArgv", NULL },
@@ -67,3 +82,16 @@
 	{ "PyObject_IsTrue", NULL },
 	{ "PyErr_SetString", NULL },
 	{ "PyEval_InitThreads", NULL },
+	{ "PyTuple_Size", NULL },
+	{ "PyTuple_GetItem", NULL },
+	{ "PySequence_Tuple", NULL },
+	{ "PyObject_CallMethod", NULL },
+	{ "PyFloat_AsDouble", NULL },
+	{ "PyFloat_FromDouble", NULL },
+	{ "PyComplex_RealAsDouble", NULL },
+	{ "PyComplex_ImagAsDouble", NULL },
+	{ "PyComplex_FromDoubles", NULL },
+	{ "PyLong_FromString", NULL },
+	{ "PyNumber_Long", NULL },
+	{ "PyFrozenSet_New", NULL },
+	{ "PySlice_New", NULL },
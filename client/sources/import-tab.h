@@ -29,33 +29,61 @@
 #define PyObject_IsInstance ((int(*)(PyObject *, PyObject *))imports[28].proc)
 #define PyInt_Type (*(PyObject(*))imports[29].proc)
 #define _Py_NoneStruct (*(PyObject(*))imports[30].proc)
-#define PyExc_ImportError (*(PyObject *(*))imports[31].proc)
-#define PyExc_Exception (*(PyObject *(*))imports[32].proc)
-#define _Py_PackageContext (*(char *(*))imports[33].proc)
-#define PyGILState_Ensure ((PyGILState_STATE(*)(void))imports[34].proc)
-#define PyGILState_Release ((void(*)(PyGILState_STATE))imports[35].proc)
-#define PySys_SetObject ((void(*)(char *, PyObject *))imports[36].proc)
-#define PySys_GetObject ((PyObject *(*)(char *))imports[37].proc)
-#define PyString_FromString ((PyObject *(*)(char *))imports[38].proc)
-#define Py_FdIsInteractive ((int(*)(FILE *, char *))imports[39].proc)
-#define PyRun_InteractiveLoop ((int(*)(FILE *, char *))imports[40].proc)
-#define PySys_SetArgv ((void(*)(int, char **))imports[41].proc)
-#define PyImport_AddModule ((PyObject *(*)(char *))imports[42].proc)
-#define PyModule_GetDict ((PyObject *(*)(PyObject *))imports[43].proc)
-#define PySequence_Length ((Py_ssize_t(*)(PyObject *))imports[44].proc)
-#define PySequence_GetItem ((PyObject *(*)(PyObject *, Py_ssize_t))imports[45].proc)
-#define PyEval_EvalCode ((PyObject *(*)(PyCodeObject *, PyObject *, PyObject *))imports[46].proc)
-#define PyErr_Print ((void(*)(void))imports[47].proc)
-#define PyBool_FromLong ((PyObject *(*)(long))imports[48].proc)
-#define Py_VerboseFlag (*(int(*))imports[49].proc)
-#define Py_NoSiteFlag (*(int(*))imports[50].proc)
-#define Py_OptimizeFlag (*(int(*))imports[51].proc)
-#define Py_IgnoreEnvironmentFlag (*(int(*))imports[52].proc)
-#define PyObject_Str ((PyObject *(*)(PyObject *))imports[53].proc)
-#define PyList_New ((PyObject *(*)(Py_ssize_t))imports[54].proc)
-#define PyList_SetItem ((int(*)(PyObject *, Py_ssize_t, PyObject *))imports[55].proc)
-#define PyList_Append ((int(*)(PyObject *, PyObject *))imports[56].proc)
-#define PyThreadState_GetDict ((PyObject *(*)(void))imports[57].proc)
-#define PyObject_IsTrue ((int(*)(PyObject *))imports[58].proc)
-#define PyErr_SetString ((void(*)(PyObject *, const char *))imports[59].proc)
-#define PyEval_InitThreads ((void(*)(void))imports[60].proc)
+#define _Py_TrueStruct (*(PyObject(*))imports[31].proc)
+#define _Py_NotImplementedStruct (*(PyObject(*))imports[32].proc)
+#define _Py_EllipsisObject (*(PyObject(*))imports[33].proc)
+#define PyString_Type (*(PyObject(*))imports[34].proc)
+#define PyUnicode_Type (*(PyObject(*))imports[35].proc)
+#define PyLong_Type (*(PyObject(*))imports[36].proc)
+#define PyFloat_Type (*(PyObject(*))imports[37].proc)
+#define PyComplex_Type (*(PyObject(*))imports[38].proc)
+#define PyBool_Type (*(PyObject(*))imports[39].proc)
+#define PyTuple_Type (*(PyObject(*))imports[40].proc)
+#define PyFrozenSet_Type (*(PyObject(*))imports[41].proc)
+#define PySlice_Type (*(PyObject(*))imports[42].proc)
+#define PyExc_ImportError (*(PyObject *(*))imports[43].proc)
+#define PyExc_Exception (*(PyObject *(*))imports[44].proc)
+#define PyExc_TypeError (*(PyObject *(*))imports[45].proc)
+#define _Py_PackageContext (*(char *(*))imports[46].proc)
+#define PyGILState_Ensure ((PyGILState_STATE(*)(void))imports[47].proc)
+#define PyGILState_Release ((void(*)(PyGILState_STATE))imports[48].proc)
+#define PySys_SetObject ((void(*)(char *, PyObject *))imports[49].proc)
+#define PySys_GetObject ((PyObject *(*)(char *))imports[50].proc)
+#define PyString_FromString ((PyObject *(*)(char *))imports[51].proc)
+#define PyString_FromStringAndSize ((PyObject *(*)(const char *, Py_ssize_t))imports[52].proc)
+#define PyObject_AsWriteBuffer ((int(*)(PyObject *, void **, Py_ssize_t *))imports[53].proc)
+#define Py_FdIsInteractive ((int(*)(FILE *, char *))imports[54].proc)
+#define PyRun_InteractiveLoop ((int(*)(FILE *, char *))imports[55].proc)
+#define PySys_SetArgv ((void(*)(int, char **))imports[56].proc)
+#define PyImport_AddModule ((PyObject *(*)(char *))imports[57].proc)
+#define PyModule_GetDict ((PyObject *(*)(PyObject *))imports[58].proc)
+#define PySequence_Length ((Py_ssize_t(*)(PyObject *))imports[59].proc)
+#define PySequence_GetItem ((PyObject *(*)(PyObject *, Py_ssize_t))imports[60].proc)
+#define PyEval_EvalCode ((PyObject *(*)(PyCodeObject *, PyObject *, PyObject *))imports[61].proc)
+#define PyErr_Print ((void(*)(void))imports[62].proc)
+#define PyBool_FromLong ((PyObject *(*)(long))imports[63].proc)
+#define Py_VerboseFlag (*(int(*))imports[64].proc)
+#define Py_NoSiteFlag (*(int(*))imports[65].proc)
+#define Py_OptimizeFlag (*(int(*))imports[66].proc)
+#define Py_IgnoreEnvironmentFlag (*(int(*))imports[67].proc)
+#define PyObject_Str ((PyObject *(*)(PyObject *))imports[68].proc)
+#define PyList_New ((PyObject *(*)(Py_ssize_t))imports[69].proc)
+#define PyList_SetItem ((int(*)(PyObject *, Py_ssize_t, PyObject *))imports[70].proc)
+#define PyList_Append ((int(*)(PyObject *, PyObject *))imports[71].proc)
+#define PyThreadState_GetDict ((PyObject *(*)(void))imports[72].proc)
+#define PyObject_IsTrue ((int(*)(PyObject *))imports[73].proc)
+#define PyErr_SetString ((void(*)(PyObject *, const char *))imports[74].proc)
+#define PyEval_InitThreads ((void(*)(void))imports[75].proc)
+#define PyTuple_Size ((Py_ssize_t(*)(PyObject *))imports[76].proc)
+#define PyTuple_GetItem ((PyObject *(*)(PyObject *, Py_ssize_t))imports[77].proc)
+#define PySequence_Tuple ((PyObject *(*)(PyObject *))imports[78].proc)
+#define PyObject_CallMethod ((PyObject *(*)(PyObject *, char *, char *, ...))imports[79].proc)
+#define PyFloat_AsDouble ((double(*)(PyObject *))imports[80].proc)
+#define PyFloat_FromDouble ((PyObject *(*)(double))imports[81].proc)
+#define PyComplex_RealAsDouble ((double(*)(PyObject *))imports[82].proc)
+#define PyComplex_ImagAsDouble ((double(*)(PyObject *))imports[83].proc)
+#define PyComplex_FromDoubles ((PyObject *(*)(double, double))imports[84].proc)
+#define PyLong_FromString ((PyObject *(*)(char *, char **, int))imports[85].proc)
+#define PyNumber_Long ((PyObject *(*)(PyObject *))imports[86].proc)
+#define PyFrozenSet_New ((PyObject *(*)(PyObject *))imports[87].proc)
+#define PySlice_New ((PyObject *(*)(PyObject *, PyObject *, PyObject *))imports[88].proc)
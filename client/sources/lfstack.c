@@ -0,0 +1,119 @@
+/*!
+ * @file lfstack.c
+ * @brief Definitions for functions that operate on bounded lock-free stacks.
+ * @details Treiber stack over a preallocated array of nodes. Use it instead of a \c LIST
+ *          where the list is only a stack (via push/pop). Linkage is done with the
+ *          Interlocked SList API, which takes care of ABA. Free nodes live on a second
+ *          SList, so push and pop never allocate nor lock.
+ */
+
+#include <stdlib.h>
+#include <malloc.h>
+#include <windows.h>
+
+#include "lfstack.h"
+
+/*!
+ * @brief Create a lock-free stack.
+ * @param capacity Maximum number of items.
+ * @returns A new instance of a stack.
+ * @retval NULL Indicates a memory allocation failure.
+ */
+PLFSTACK lfstack_create(DWORD capacity)
+{
+	PLFSTACK pStack;
+	DWORD i;
+
+	if (capacity == 0)
+		return NULL;
+
+	pStack = (PLFSTACK)_aligned_malloc(sizeof(LFSTACK), MEMORY_ALLOCATION_ALIGNMENT);
+	if (pStack == NULL)
+		return NULL;
+
+	pStack->nodes = (PLFSTACK_NODE)_aligned_malloc(
+		capacity * sizeof(LFSTACK_NODE), MEMORY_ALLOCATION_ALIGNMENT
+	);
+
+	if (pStack->nodes == NULL)
+	{
+		_aligned_free(pStack);
+		return NULL;
+	}
+
+	InitializeSListHead(&pStack->top);
+	InitializeSListHead(&pStack->free);
+
+	for (i = 0; i < capacity; i++)
+	{
+		pStack->nodes[i].data = NULL;
+		InterlockedPushEntrySList(&pStack->free, &pStack->nodes[i].entry);
+	}
+
+	pStack->capacity = capacity;
+
+	return pStack;
+}
+
+/*!
+ * @brief Destroy an existing stack.
+ * @details Nobody should use the stack at this point. The data held in the stack is
+ *          the responsibility of the caller to destroy.
+ * @param pStack The \c LFSTACK instance to destroy.
+ */
+VOID lfstack_destroy(PLFSTACK pStack)
+{
+	if (pStack == NULL)
+		return;
+
+	_aligned_free(pStack->nodes);
+	_aligned_free(pStack);
+}
+
+/*!
+ * @brief Push a data item onto the top of the stack.
+ * @param pStack Pointer to the \c LFSTACK to push the data to.
+ * @param data Pointer to the data to push.
+ * @returns Indication of success or failure.
+ * @retval FALSE Indicates the stack is full.
+ */
+BOOL lfstack_push(PLFSTACK pStack, LPVOID data)
+{
+	PLFSTACK_NODE node;
+
+	if (pStack == NULL)
+		return FALSE;
+
+	node = (PLFSTACK_NODE)InterlockedPopEntrySList(&pStack->free);
+	if (node == NULL)
+		return FALSE;
+
+	node->data = data;
+	InterlockedPushEntrySList(&pStack->top, &node->entry);
+
+	return TRUE;
+}
+
+/*!
+ * @brief Pop a data value off the top of the stack.
+ * @param pStack Pointer to the \c LFSTACK to pop the value from.
+ * @returns The popped value.
+ * @retval NULL Indicates no data in the stack.
+ */
+LPVOID lfstack_pop(PLFSTACK pStack)
+{
+	PLFSTACK_NODE node;
+	LPVOID data;
+
+	if (pStack == NULL)
+		return NULL;
+
+	node = (PLFSTACK_NODE)InterlockedPopEntrySList(&pStack->top);
+	if (node == NULL)
+		return NULL;
+
+	data = node->data;
+	InterlockedPushEntrySList(&pStack->free, &node->entry);
+
+	return data;
+}
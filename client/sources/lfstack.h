@@ -0,0 +1,29 @@
+/*!
+ * @file lfstack.h
+ * @brief Declarations for functions that operate on bounded lock-free stacks.
+ */
+#ifndef _PUPY_LIB_LFSTACK_H
+#define _PUPY_LIB_LFSTACK_H
+
+/*! @brief Preallocated stack node, linked through the interlocked SLIST entry. */
+typedef struct _LFSTACK_NODE
+{
+	SLIST_ENTRY entry;    ///< Interlocked list linkage, must be first.
+	LPVOID data;          ///< Reference to the data in the node.
+} LFSTACK_NODE, *PLFSTACK_NODE;
+
+/*! @brief Container structure for a lock-free stack instance. */
+typedef struct _LFSTACK
+{
+	SLIST_HEADER top;     ///< Stack of the pushed nodes.
+	SLIST_HEADER free;    ///< Stack of the free nodes.
+	PLFSTACK_NODE nodes;  ///< Array of capacity nodes.
+	DWORD capacity;
+} LFSTACK, *PLFSTACK;
+
+PLFSTACK lfstack_create(DWORD capacity);
+VOID lfstack_destroy(PLFSTACK pStack);
+BOOL lfstack_push(PLFSTACK pStack, LPVOID data);
+LPVOID lfstack_pop(PLFSTACK pStack);
+
+#endif
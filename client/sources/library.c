@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "library.h"
+
+/*
+
+  Embedded module library. Layout is produced by gen_library_compressed_string.py:
+  a sorted name table with per-entry offsets, every entry compressed on its own.
+  Nothing is unpacked until somebody asks for a module.
+
+*/
+
+#define LIBRARY_MAGIC "PLB1"
+#define LIBRARY_HEADER_SIZE 8
+#define LIBRARY_ENTRY_SIZE 20
+
+static const char *library = NULL;
+static DWORD library_size = 0;
+static DWORD library_entries = 0;
+
+/* Dotted module name -> archive entries index, built once in library_init */
+typedef struct _MODULE_NODE {
+	DWORD hash;
+	const char *fullname;
+	DWORD index;
+	struct _MODULE_NODE *next;
+} MODULE_NODE, *PMODULE_NODE;
+
+static PMODULE_NODE *modules_buckets = NULL;
+static DWORD modules_mask = 0;
+
+static DWORD read_le32(const char *ptr)
+{
+	const unsigned char *p = (const unsigned char *) ptr;
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((DWORD) p[3] << 24);
+}
+
+static DWORD fnv1a(const char *str)
+{
+	DWORD hash = 2166136261u;
+	while (*str) {
+		hash ^= (unsigned char) *str++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/* a/b/__init__.pyc -> a.b, a/b.pyd -> a.b */
+static VOID module_name(const PLIBRARY_ENTRY entry, char *fullname)
+{
+	const char *slash = strrchr(entry->name, '/');
+	const char *dot = strrchr(slash? slash : entry->name, '.');
+	DWORD size = dot? (DWORD) (dot - entry->name) : entry->name_size;
+	DWORD i;
+
+	for (i=0; i<size; i++)
+		fullname[i] = entry->name[i] == '/' ? '.' : entry->name[i];
+
+	fullname[size] = '\0';
+
+	if (dot && size >= 9 && !strcmp(fullname + size - 9, ".__init__") && (
+			!strcmp(dot, ".py") || !strcmp(dot, ".pyc") || !strcmp(dot, ".pyo")))
+		fullname[size - 9] = '\0';
+}
+
+static BOOL library_build_index(VOID)
+{
+	DWORD buckets = 16;
+	DWORD names_size = 0;
+	DWORD i;
+	LIBRARY_ENTRY entry;
+	PMODULE_NODE nodes;
+	char *names;
+
+	while (buckets < library_entries * 2)
+		buckets <<= 1;
+
+	for (i=0; i<library_entries; i++) {
+		if (!library_get(i, &entry))
+			return FALSE;
+		names_size += entry.name_size + 1;
+	}
+
+	modules_buckets = (PMODULE_NODE *) calloc(buckets, sizeof(PMODULE_NODE));
+	nodes = (PMODULE_NODE) malloc(library_entries * sizeof(MODULE_NODE) + 1);
+	names = (char *) malloc(names_size + 1);
+
+	if (!modules_buckets || !nodes || !names) {
+		free(modules_buckets);
+		free(nodes);
+		free(names);
+		modules_buckets = NULL;
+		return FALSE;
+	}
+
+	modules_mask = buckets - 1;
+
+	for (i=0; i<library_entries; i++) {
+		library_get(i, &entry);
+		module_name(&entry, names);
+
+		nodes[i].hash = fnv1a(names);
+		nodes[i].fullname = names;
+		nodes[i].index = i;
+		nodes[i].next = modules_buckets[nodes[i].hash & modules_mask];
+		modules_buckets[nodes[i].hash & modules_mask] = &nodes[i];
+
+		names += strlen(names) + 1;
+	}
+
+	return TRUE;
+}
+
+BOOL library_init(const char *archive, DWORD size)
+{
+	DWORD count;
+
+	if (size < LIBRARY_HEADER_SIZE || memcmp(archive, LIBRARY_MAGIC, 4))
+		return FALSE;
+
+	count = read_le32(archive + 4);
+	if (count > (size - LIBRARY_HEADER_SIZE) / LIBRARY_ENTRY_SIZE)
+		return FALSE;
+
+	library = archive;
+	library_size = size;
+	library_entries = count;
+
+	if (!library_build_index()) {
+		library_entries = 0;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+DWORD library_count(VOID)
+{
+	return library_entries;
+}
+
+BOOL library_get(DWORD index, PLIBRARY_ENTRY entry)
+{
+	const char *record;
+	DWORD name_offset;
+	DWORD data_offset;
+
+	if (index >= library_entries)
+		return FALSE;
+
+	record = library + LIBRARY_HEADER_SIZE + index * LIBRARY_ENTRY_SIZE;
+	name_offset = read_le32(record);
+	data_offset = read_le32(record + 8);
+
+	entry->name_size = read_le32(record + 4);
+	entry->csize = read_le32(record + 12);
+	entry->usize = read_le32(record + 16);
+
+	if (name_offset + entry->name_size >= library_size ||
+		data_offset + entry->csize > library_size)
+		return FALSE;
+
+	entry->name = library + name_offset;
+	entry->data = library + data_offset;
+	return TRUE;
+}
+
+BOOL library_find(const char *name, PLIBRARY_ENTRY entry)
+{
+	DWORD low = 0;
+	DWORD high = library_entries;
+
+	while (low < high) {
+		DWORD middle = low + (high - low) / 2;
+		int cmp;
+
+		if (!library_get(middle, entry))
+			return FALSE;
+
+		cmp = strcmp(name, entry->name);
+		if (!cmp)
+			return TRUE;
+
+		if (cmp < 0)
+			high = middle;
+		else
+			low = middle + 1;
+	}
+
+	return FALSE;
+}
+
+DWORD library_lookup(const char *fullname, DWORD *indexes, DWORD max)
+{
+	DWORD found = 0;
+	DWORD hash;
+	PMODULE_NODE node;
+
+	if (!modules_buckets)
+		return 0;
+
+	hash = fnv1a(fullname);
+	for (node = modules_buckets[hash & modules_mask]; node && found < max; node = node->next) {
+		if (node->hash == hash && !strcmp(node->fullname, fullname))
+			indexes[found++] = node->index;
+	}
+
+	return found;
+}
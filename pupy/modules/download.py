@@ -1,7 +1,7 @@
 # -*- coding: utf-8 -*-
 from pupylib.PupyModule import *
 from pupylib.PupyCompleter import *
-from rpyc.utils.classic import download
+from pupylib.utils.transfer import TransferSink, local_offsets
 import os
 import os.path
 import time
@@ -11,8 +11,14 @@ __class_name__="DownloaderScript"
 @config(category="manage")
 class DownloaderScript(PupyModule):
     """ download a file/directory from a remote system """
+    dependencies=["pupyutils.transfer"]
+
     def init_argparse(self):
         self.arg_parser = PupyArgumentParser(prog='download', description=self.__doc__)
+        self.arg_parser.add_argument('-r', '--resume', action='store_true', help='complete files a previous download left partial')
+        self.arg_parser.add_argument('-c', '--compress', action='store_true', help='compress the chunks that compress')
+        self.arg_parser.add_argument('-w', '--window', type=int, default=8, help='chunks in flight (default: 8)')
+        self.arg_parser.add_argument('--chunk-size', type=int, default=1024*1024, help='chunk size in bytes (default: 1MB)')
         self.arg_parser.add_argument('remote_file', metavar='<remote_path>')
         self.arg_parser.add_argument('local_file', nargs='?', metavar='<local_path>', completer=path_completer)
 
@@ -42,14 +48,30 @@ class DownloaderScript(PupyModule):
         elif os.path.isdir(local_file):
             local_file = os.path.join(local_file, ros.path.basename(remote_file))
 
+        offsets = ()
+        if args.resume and os.path.exists(local_file):
+            offsets = local_offsets(local_file)
+
         self.info("downloading %s ..."%remote_file)
         start_time=time.time()
-        download(self.client.conn, remote_file, local_file)
-        self.success("file downloaded from remote:%s to local:%s"%(remote_file, local_file))
-        size=os.path.getsize(local_file)
-        total_time=round(time.time()-start_time, 2)
+        sink = TransferSink(local_file)
+        try:
+            files, size, sent = self.client.conn.modules['pupyutils.transfer'].download(
+                remote_file, sink, offsets,
+                chunk_size=args.chunk_size, window=args.window, compress=args.compress
+            )
+        finally:
+            sink.close()
+
+        for path, error in sink.errors:
+            self.warning("%s: %s"%(path, error))
+        for path in sink.failed:
+            self.error("%s: sha1 mismatch, the file is corrupted"%path)
+
+        self.success("%d file(s) downloaded from remote:%s to local:%s"%(files, remote_file, local_file))
+        total_time=max(round(time.time()-start_time, 2), 0.01)
         self.info(
-            "%s bytes downloaded in: %ss. average %sKB/s"%(
-                size, total_time, round((size/total_time)/10**3, 2)
+            "%s bytes downloaded (%s on the wire) in: %ss. average %sKB/s"%(
+                size, sent, total_time, round((size/total_time)/10**3, 2)
             )
         )
@@ -1,7 +1,12 @@
 # -*- coding: utf-8 -*-
 from pupylib.PupyModule import *
 from pupylib.utils.term import colorize
+from pupylib.utils.rpyc_utils import batch_fetch
 from modules.lib.utils.shell_exec import shell_exec
+from collections import namedtuple, OrderedDict
+
+MOUNT_FIELDS=( 'fstype', 'src', 'dst', 'fsname', 'hfree', 'total', 'pused', 'options' )
+MountInfo=namedtuple('MountInfo', MOUNT_FIELDS)
 
 __class_name__="Drives"
 
@@ -26,17 +31,21 @@ class Drives(PupyModule):
     def run(self, args):
         if self.client.is_windows():
             self.stdout.write(
-                self.client.conn.modules['pupwinutils.drives'].list_drives()
+                batch_fetch(self.client.conn, 'pupwinutils.drives:list_drives', args=())
             )
 
         elif self.client.is_linux():
             tier1 = ( 'network', 'fuse', 'dm', 'block' )
-            rmount = self.client.conn.modules['mount']
-            ros = self.client.conn.modules['os']
 
-            mountinfo = rmount.mounts()
-            uid = ros.getuid()
-            gid = ros.getgid()
+            # every mount in one request, not a round trip per attribute
+            mountinfo = OrderedDict()
+            for group in batch_fetch(
+                    self.client.conn, 'mount:mounts', MOUNT_FIELDS, project='itervalues()', args=()):
+                for values in group:
+                    info = MountInfo(*values)
+                    mountinfo.setdefault(info.fstype, []).append(info)
+
+            uid, gid = batch_fetch(self.client.conn, 'os', ( 'getuid()', 'getgid()' ))
 
             option_colors = {
                 'rw': 'yellow',
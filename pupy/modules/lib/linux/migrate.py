@@ -41,7 +41,7 @@ def wait_connect(module, pid):
         c=has_proc_migrated(module.client, pid)
         if c:
             module.success("got a connection from migrated DLL !")
-            c.desc["id"]=module.client.desc["id"]
+            module.client.pupsrv.renumber_client(c, module.client.desc["id"])
             break
         time.sleep(0.1)
     try:
@@ -37,7 +37,7 @@ def migrate(module, pid, keep=False, timeout=30):
 	c=has_proc_migrated(module.client, pid)
         if c:
 		module.success("got a connection from migrated DLL !")
-		c.desc["id"]=module.client.desc["id"]
+		module.client.pupsrv.renumber_client(c, module.client.desc["id"])
 		time.sleep(0.1)
 		try:
 			module.client.conn.exit()
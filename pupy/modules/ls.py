@@ -1,5 +1,6 @@
 # -*- coding: UTF8 -*-
 from pupylib.PupyModule import *
+from pupylib.utils.rpyc_utils import batch_fetch
 
 __class_name__="ls"
 
@@ -15,7 +16,7 @@ class ls(PupyModule):
     def run(self, args):
         self.client.load_package("pupyutils.basic_cmds")
         self.client.load_package("scandir")
-        info, r = self.client.conn.modules["pupyutils.basic_cmds"].ls(args.path)
+        info, r = batch_fetch(self.client.conn, "pupyutils.basic_cmds:ls", args=(args.path,))
         if r:
             self.success(info)
             self.log(r)
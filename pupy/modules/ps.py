@@ -1,6 +1,6 @@
 # -*- coding: UTF8 -*-
 from pupylib.PupyModule import *
-from pupylib.utils.rpyc_utils import obtain
+from pupylib.utils.rpyc_utils import fetch_records
 from modules.lib.utils.shell_exec import shell_exec
 
 __class_name__="PsModule"
@@ -17,8 +17,8 @@ class PsModule(PupyModule):
         if self.client.is_windows():
             self.client.load_package("psutil")
             self.client.load_package("pupwinutils.processes")
-            outputlist=self.client.conn.modules["pupwinutils.processes"].enum_processes()
-            outputlist=obtain(outputlist) #pickle the list of proxy objects with obtain is really faster
+            outputlist=fetch_records(self.client.conn, "pupwinutils.processes:enum_processes",
+                ('username', 'pid', 'arch', 'name', 'exe', 'cmdline', 'status'), args=())
             columns=['username', 'pid', 'arch', 'exe']
             if args.all:
                 columns=['username', 'pid', 'arch', 'name', 'exe', 'cmdline', 'status']
@@ -30,7 +30,7 @@ class PsModule(PupyModule):
             else:
                 for dic in outputlist:
                     if 'exe' in dic and not dic['exe'] and 'name' in dic and dic['name']:
-                        dic['exe']=dic['name'].encode('utf-8', errors='replace')
+                        dic['exe']=dic['name'].encode('utf-8', errors='replace') if isinstance(dic['name'], unicode) else dic['name']
                     if 'username' in dic and dic['username'] is None:
                         dic['username']=""
             self.rawlog(self.formatter.table_format(outputlist, wl=columns))
@@ -1,17 +1,24 @@
 # -*- coding: utf-8 -*-
 from pupylib.PupyModule import *
 from pupylib.PupyCompleter import *
-from rpyc.utils.classic import upload
+from pupylib.utils.transfer import TransferSource
 import os
 import os.path
+import time
 
 __class_name__="UploaderScript"
 
 @config(cat="manage")
 class UploaderScript(PupyModule):
     """ upload a file/directory to a remote system """
+    dependencies=["pupyutils.transfer"]
+
     def init_argparse(self):
         self.arg_parser = PupyArgumentParser(prog='upload', description=self.__doc__)
+        self.arg_parser.add_argument('-r', '--resume', action='store_true', help='complete files a previous upload left partial')
+        self.arg_parser.add_argument('-c', '--compress', action='store_true', help='compress the chunks that compress')
+        self.arg_parser.add_argument('-w', '--window', type=int, default=8, help='chunks in flight (default: 8)')
+        self.arg_parser.add_argument('--chunk-size', type=int, default=1024*1024, help='chunk size in bytes (default: 1MB)')
         self.arg_parser.add_argument('local_file', metavar='<local_path>', completer=path_completer)
         self.arg_parser.add_argument('remote_file', nargs='?', metavar='<remote_path>')
 
@@ -41,15 +48,20 @@ class UploaderScript(PupyModule):
             )
         )
 
-        upload(
-            self.client.conn,
-            localfile,
-            remotefile
-        )
+        start_time=time.time()
+        source = TransferSource(localfile)
+        try:
+            files, received, failed = self.client.conn.modules['pupyutils.transfer'].upload(
+                source, remotefile, resume=args.resume,
+                chunk_size=args.chunk_size, window=args.window, compress=args.compress
+            )
+        finally:
+            source.close()
 
-        self.success("file local:%s uploaded to remote:%s"%(localfile, remotefile))
+        for path in failed:
+            self.error("remote:%s: sha1 mismatch, the file is corrupted"%path)
 
-        self.client.conn.modules['os'].chmod(
-            remotefile,
-            os.stat(localfile).st_mode
-        )
+        self.success("%d file(s) local:%s uploaded to remote:%s"%(files, localfile, remotefile))
+        total_time=max(round(time.time()-start_time, 2), 0.01)
+        self.info("%s bytes on the wire in: %ss. average %sKB/s"%(
+            received, total_time, round((received/total_time)/10**3, 2)))
@@ -1,3 +1,4 @@
+from . import brine
 from .streams import *
 from .base import chain_transports
 from .servers import PupyTCPServer, PupyUDPServer
@@ -6,5 +7,7 @@ from .transports.dummy import DummyPupyTransport
 from .transports.b64 import B64Client, B64Server, B64Transport
 from .transports.http import PupyHTTPClient, PupyHTTPServer
 from .transports.xor import XOR
+from .transports.compression import CompressionTransport, CompressionClient, CompressionServer
+from .transports.reliable import ReliableTransport, ReliableClient, ReliableServer
 from .transports.aes import AES256, AES128
 from .transports.rsa_aes import RSA_AESClient, RSA_AESServer
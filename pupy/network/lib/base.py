@@ -19,6 +19,10 @@ class Circuit(object):
         self.stream.close()
 
 class BasePupyTransport(object):
+    # in a chain (see TransportWrapper.on_connect): what the upper layers wrote when the
+    # connection was established is sent at once instead of with the first write
+    flush_on_connect=False
+
     def __init__(self, stream, **kwargs):
         if stream is None:
             self.downstream=Buffer(transport_func=addGetPeer(("127.0.0.1", 443)))
@@ -116,7 +120,11 @@ class TransportWrapper(BasePupyTransport):
         super(TransportWrapper, self).__init__(stream, **kwargs)
         self.insts=[]
         for c in self.cls_chain:
-            self.insts.append(c(None, **kwargs))
+            ins=c(None, **kwargs)
+            # the layers chain their buffers, but closing one of them (a peer given
+            # up by the reliable layer) closes the connection
+            ins.stream=ins.circuit.stream=self.stream
+            self.insts.append(ins)
 
         #upstream chaining :
         self.insts[-1].upstream=self.upstream
@@ -130,6 +138,15 @@ class TransportWrapper(BasePupyTransport):
         for ins in self.insts:
             ins.on_connect()
 
+        if not any(ins.flush_on_connect for ins in self.insts):
+            return
+
+        # handshakes written by the upper layers go through the lower ones now,
+        # the peer may wait for them before it sends anything
+        for i in xrange(len(self.insts)-2, -1, -1):
+            if len(self.insts[i+1].downstream):
+                self.insts[i].upstream_recv(self.insts[i+1].downstream)
+
     def on_close(self):
         for ins in self.insts:
             ins.on_close()
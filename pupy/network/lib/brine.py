@@ -0,0 +1,48 @@
+# -*- coding: utf-8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" Every rpyc message goes through brine.dump/load. When the _pupybrine codec is there
+rpyc's brine module is patched to use it, otherwise rpyc's pure python brine stays in
+place. Clients have it built in, the server has it once built as an extension with
+pupy/setup.py (python setup.py build_ext --inplace). tests/test_brine.py compares
+both codecs """
+
+from rpyc.core import brine
+
+try:
+    import _pupybrine
+except ImportError:
+    _pupybrine = None
+
+NATIVE = False
+
+# one object of every type brine knows, to check both codecs agree on this rpyc
+PROBE = (
+    None, True, False, NotImplemented, Ellipsis,
+    0, -0x30, 0x9f, -0x31, 0xa0, 2**31-1, -2**31, 5L, 2**70, -2**70,
+    '', 'a', 'abcd', 'abcde', 'x'*256, u'', u'\xe9\u20ac',
+    1.5, -0.0, 1e308, 1+2j, slice(1, None, -1), frozenset([1]),
+    (), (1,), tuple(range(5)), tuple(range(256)),
+)
+
+def install():
+    """ rpyc's protocol and vinegar call brine.dump/load/dumpable through the module """
+    global NATIVE
+
+    if _pupybrine is None or NATIVE:
+        return NATIVE
+
+    try:
+        data = brine.dump(PROBE)
+        if _pupybrine.dump(PROBE) != data or _pupybrine.load(data) != brine.load(data):
+            return False
+    except Exception:
+        return False
+
+    brine.dump = _pupybrine.dump
+    brine.load = _pupybrine.load
+    brine.dumpable = _pupybrine.dumpable
+    NATIVE = True
+    return True
+
+install()
@@ -1,6 +1,134 @@
 # Using the same buffer object as in obfsproxy to enhance compatibility
 #some modifications brings to have waiting capabilities
 import threading
+from collections import deque
+
+try:
+    import _pupybuffer
+except ImportError:
+    _pupybuffer = None
+
+class NativeChunks(object):
+    """ chunks stored by the builtin _pupybuffer module. Holds nothing but
+    the handle, so it never ends up in a reference cycle and __del__ is safe """
+
+    __slots__ = ( 'handle', )
+
+    def __init__(self):
+        self.handle = _pupybuffer.new()
+
+    def __del__(self):
+        if self.handle:
+            _pupybuffer.free(self.handle)
+            self.handle = None
+
+    def write(self, data):
+        _pupybuffer.write(self.handle, data)
+
+    def read(self, n=-1):
+        return _pupybuffer.read(self.handle, n)
+
+    def peek(self, n=-1):
+        return _pupybuffer.peek(self.handle, n)
+
+    def drain(self, n=-1):
+        _pupybuffer.drain(self.handle, n)
+
+    def __len__(self):
+        return _pupybuffer.length(self.handle)
+
+class Chunks(object):
+    """ list of written strings, consumed from the head. Strings are only
+    joined on read, so appends don't copy what is already buffered. A stream
+    writes from one thread and reads from another, the deque is walked under
+    the lock (the native chunks run under the GIL) """
+
+    __slots__ = ( 'chunks', 'offset', 'size', 'lock' )
+
+    def __init__(self):
+        self.chunks = deque()
+        self.offset = 0
+        self.size = 0
+        self.lock = threading.Lock()
+
+    def write(self, data):
+        if data:
+            with self.lock:
+                self.chunks.append(data)
+                self.size += len(data)
+
+    def _collect(self, n, drain):
+        with self.lock:
+            return self._collect_locked(n, drain)
+
+    def _collect_locked(self, n, drain):
+        if n < 0 or n > self.size:
+            n = self.size
+
+        if not n:
+            return ''
+
+        head = self.chunks[0]
+        if self.offset == 0 and len(head) == n:
+            if drain:
+                self.chunks.popleft()
+                self.size -= n
+            return head
+
+        parts = []
+        left = n
+        offset = self.offset
+
+        for chunk in self.chunks:
+            available = len(chunk) - offset
+            if available > left:
+                parts.append(chunk[offset:offset+left])
+                offset += left
+                left = 0
+                break
+
+            parts.append(chunk[offset:] if offset else chunk)
+            left -= available
+            offset = 0
+            if not left:
+                break
+
+        if drain:
+            self._drain(n)
+
+        return ''.join(parts)
+
+    def read(self, n=-1):
+        return self._collect(n, True)
+
+    def peek(self, n=-1):
+        return self._collect(n, False)
+
+    def drain(self, n=-1):
+        with self.lock:
+            self._drain(n)
+
+    def _drain(self, n):
+        if n < 0 or n >= self.size:
+            self.chunks.clear()
+            self.offset = 0
+            self.size = 0
+            return
+
+        self.size -= n
+        while n:
+            available = len(self.chunks[0]) - self.offset
+            if available > n:
+                self.offset += n
+                return
+
+            self.chunks.popleft()
+            self.offset = 0
+            n -= available
+
+    def __len__(self):
+        return self.size
+
 class Buffer(object):
     """
     A Buffer is a simple FIFO buffer. You write() stuff to it, and you
@@ -11,7 +139,8 @@ class Buffer(object):
         """
         Initialize a buffer with 'data'.
         """
-        self.buffer = bytes(data)
+        self.buffer = NativeChunks() if _pupybuffer else Chunks()
+        self.buffer.write(bytes(data))
         self.on_write_f=on_write
         self.waiting_lock=threading.Lock()
         self.waiting=threading.Event()
@@ -30,7 +159,7 @@ class Buffer(object):
         else:
             self.waiting.clear()
         return self.waiting.wait(timeout)
-            
+
     def read(self, n=-1):
         """
         Read and return 'n' bytes from the buffer.
@@ -39,21 +168,13 @@ class Buffer(object):
         If 'n' is larger than the size of the buffer, read and return
         the whole buffer.
         """
-
-        if (n < 0) or (n > len(self.buffer)):
-            the_whole_buffer = self.buffer
-            self.buffer = bytes('')
-            return the_whole_buffer
-
-        data = self.buffer[:n]
-        self.buffer = self.buffer[n:]
-        return data
+        return self.buffer.read(n)
 
     def write(self, data):
         """
         Append 'data' to the buffer.
         """
-        self.buffer = self.buffer + data
+        self.buffer.write(data)
         self.on_write()
         self.waiting.set()
 
@@ -65,11 +186,7 @@ class Buffer(object):
         If 'n' is larger than the size of the buffer, return the whole
         buffer.
         """
-
-        if (n < 0) or (n > len(self.buffer)):
-            return self.buffer
-
-        return self.buffer[:n]
+        return self.buffer.peek(n)
 
     def drain(self, n=-1):
         """
@@ -79,12 +196,7 @@ class Buffer(object):
         If 'n' is larger than the size of the buffer, drain the whole
         buffer.
         """
-        if (n < 0) or (n > len(self.buffer)):
-            self.buffer = bytes('')
-            return
-
-        self.buffer = self.buffer[n:]
-        return
+        self.buffer.drain(n)
 
     def __len__(self):
         """Returns length of buffer. Used in len()."""
@@ -96,4 +208,3 @@ class Buffer(object):
         Used in truth-value testing.
         """
         return True if len(self.buffer) else False
-
@@ -0,0 +1,335 @@
+# -*- coding: utf-8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" Event driven mode of PupyTCPServer. A few epoll threads read every session socket
+and run the transports, a small pool of workers serves the rpyc frames they complete.
+A worker only holds a session while it has whole frames to dispatch, so idle sessions
+cost a socket and a few buffers instead of two threads """
+
+__all__ = [ 'PupyReactor', 'ReactorStream', 'WorkerPool', 'reactor_stream', 'available' ]
+
+import select
+import socket
+import errno
+import ssl
+import time
+import threading
+import logging
+
+from Queue import Queue, Full
+from rpyc.core import Channel
+
+available = hasattr(select, 'epoll')
+
+class WorkerPool(object):
+    """ fixed number of threads for everything that may block: handlers and the sync
+    requests they make, authentication (a pool of its own). backlog bounds the jobs
+    waiting for a thread, 0 for no bound """
+
+    def __init__(self, workers=16, name='PupyWorker', backlog=0):
+        self.queue = Queue(backlog)
+        self.threads = []
+        for i in xrange(workers):
+            t = threading.Thread(target=self._work, name='{}-{}'.format(name, i))
+            t.daemon = True
+            t.start()
+            self.threads.append(t)
+
+    def submit(self, func, *args):
+        """ False when the backlog is full, the job is dropped """
+        try:
+            self.queue.put_nowait((func, args))
+        except Full:
+            return False
+        return True
+
+    def _work(self):
+        while True:
+            func, args = self.queue.get()
+            if func is None:
+                return
+
+            try:
+                func(*args)
+            except Exception:
+                logging.exception('Worker job {} failed'.format(func))
+
+    def close(self):
+        for _ in self.threads:
+            self.queue.put((None, None))
+
+# nothing to do until the socket is ready again, not an error on a non blocking socket
+RETRY_ERRNOS = ( errno.EAGAIN, errno.EWOULDBLOCK, errno.EINTR )
+RETRY_SSL = ( ssl.SSL_ERROR_WANT_READ, ssl.SSL_ERROR_WANT_WRITE )
+
+def _retry(e):
+    if isinstance(e, ssl.SSLError):
+        return e.args[0] in RETRY_SSL
+    return e.errno in RETRY_ERRNOS
+
+class ReactorStream(object):
+    """ mixed into the stream class of the server (see reactor_stream). The socket is
+    only read by the reactor, rpyc's poll/read wait for what it buffered upstream.
+    It is non blocking once registered: a readable fd may hold part of a TLS record,
+    a recv that waits for the rest would stop every session of the reactor thread """
+
+    send_timeout = 60 # a peer that takes nothing for that long is closed
+
+    def __init__(self, *args, **kwargs):
+        self.eof = False
+        self.scheduled = False
+        self.connection = None
+        self.on_close = None
+        self.loop = None
+        self.fd = None
+        super(ReactorStream, self).__init__(*args, **kwargs)
+        # upstream is written by the reactor and read by workers, both under this lock.
+        # Reentrant, _read closes the stream when it hits EOF
+        self.downstream_lock = threading.RLock()
+        self.frames = threading.Condition(self.downstream_lock)
+
+    def feed(self):
+        """ reactor side: receive what the socket has and run the transport on it.
+        The stream is closed once the peer is gone """
+        with self.frames:
+            try:
+                self._read()
+                # SSL may have decrypted more than recv returned, epoll won't tell
+                pending = getattr(self.sock, 'pending', None)
+                while pending and pending():
+                    self._read()
+            except EOFError:
+                return
+
+            self.transport.downstream_recv(self.buf_in)
+            self.frames.notify_all()
+
+    def _read(self):
+        try:
+            buf = self.sock.recv(self.MAX_IO_CHUNK)
+        except socket.error as e:
+            if _retry(e):
+                return
+            self.close()
+            raise EOFError(e)
+
+        if not buf:
+            self.close()
+            raise EOFError('connection closed by peer')
+
+        self.buf_in.write(buf)
+
+    def _upstream_recv(self):
+        """ worker side: what the transport wrote, sent whole """
+        if len(self.downstream) > 0:
+            self._send(self.downstream.read())
+
+    def _send(self, data):
+        deadline = None
+        while data:
+            try:
+                # after WANT_WRITE ssl wants the same bytes again, they are
+                sent = self.sock.send(data[:self.MAX_IO_CHUNK])
+            except socket.error as e:
+                if not _retry(e):
+                    self.close()
+                    raise EOFError(e)
+                sent = 0
+
+            if sent:
+                data = data[sent:]
+                deadline = None
+                continue
+
+            if deadline is None:
+                deadline = time.time() + self.send_timeout
+            elif time.time() > deadline:
+                self.close()
+                raise EOFError('send timed out')
+
+            # poll(), select() can't wait on descriptors above FD_SETSIZE. A TLS write
+            # that wants to read (renegotiation) gets the data from the reactor, retry
+            poller = select.poll()
+            poller.register(self.sock.fileno(), select.POLLOUT)
+            poller.poll(100)
+
+    def has_frame(self):
+        header = self.upstream.peek(Channel.FRAME_HEADER.size)
+        if len(header) < Channel.FRAME_HEADER.size:
+            return False
+
+        length, _ = Channel.FRAME_HEADER.unpack(header)
+        return len(self.upstream) >= Channel.FRAME_HEADER.size + length + len(Channel.FLUSHER)
+
+    def poll(self, timeout):
+        with self.frames:
+            if not ( self.eof or self.has_frame() ) and ( timeout is None or timeout > 0 ):
+                self.frames.wait(timeout)
+
+            if self.has_frame():
+                return True
+            elif self.eof:
+                raise EOFError('connection closed')
+
+            return False
+
+    def read(self, count):
+        with self.frames:
+            while len(self.upstream) < count:
+                if self.eof:
+                    raise EOFError('connection closed')
+                self.frames.wait()
+
+            return self.upstream.read(count)
+
+    def close(self):
+        with self.frames:
+            self.eof = True
+            self.frames.notify_all()
+
+        # before the fd can be reused by another session
+        if self.loop:
+            self.loop.unregister(self)
+
+        super(ReactorStream, self).close()
+
+def reactor_stream(stream_class):
+    """ reactor variant of a PupySocketStream class """
+    return type('Reactor'+stream_class.__name__, (ReactorStream, stream_class), {})
+
+class ReactorLoop(threading.Thread):
+    def __init__(self, reactor, index):
+        super(ReactorLoop, self).__init__(name='PupyReactor-{}'.format(index))
+        self.daemon = True
+        self.reactor = reactor
+        self.epoll = select.epoll()
+        self.streams = {}
+        self.lock = threading.Lock()
+        self.active = True
+
+    def register(self, stream):
+        with self.lock:
+            stream.fd = stream.sock.fileno()
+            self.streams[stream.fd] = stream
+            self.epoll.register(stream.fd, select.EPOLLIN | select.EPOLLERR | select.EPOLLHUP)
+
+    def unregister(self, stream):
+        with self.lock:
+            if self.streams.get(stream.fd) is not stream:
+                return
+
+            del self.streams[stream.fd]
+            try:
+                self.epoll.unregister(stream.fd)
+            except (IOError, ValueError):
+                pass
+
+    def run(self):
+        while self.active:
+            try:
+                events = self.epoll.poll(1)
+            except IOError:
+                # EINTR
+                continue
+
+            for fd, _ in events:
+                stream = self.streams.get(fd)
+                if stream is None:
+                    continue
+
+                try:
+                    stream.feed()
+                except Exception:
+                    logging.exception('Reactor: transport failed on fd {}'.format(fd))
+                    stream.close()
+
+                self.reactor.schedule(stream)
+
+        self.epoll.close()
+
+class PupyReactor(object):
+    """ reactor threads and the worker pool of a PupyTCPServer """
+
+    def __init__(self, threads=1, workers=16):
+        self.pool = WorkerPool(workers)
+        self.loops = [ ReactorLoop(self, i) for i in xrange(max(threads, 1)) ]
+        self.next_loop = 0
+        self.lock = threading.Lock()
+        for loop in self.loops:
+            loop.start()
+
+    def register(self, stream, connection, on_close=None):
+        """ hand a connection over to the reactor, before its service is initialized """
+        stream.connection = connection
+        stream.on_close = on_close
+        connection._serve_released = lambda: self.schedule(stream)
+
+        with self.lock:
+            loop = self.loops[self.next_loop % len(self.loops)]
+            self.next_loop += 1
+
+        stream.loop = loop
+        loop.register(stream)
+
+    def schedule(self, stream):
+        """ queue a worker for the session if it has something to serve and none is
+        queued already. Whoever holds the connection lock calls this again when it
+        releases it, so a frame left by a worker that couldn't take the lock is not lost """
+        if stream.connection is None:
+            return
+
+        with stream.frames:
+            if stream.scheduled or not ( stream.eof or stream.has_frame() ):
+                return
+            stream.scheduled = True
+
+        self.pool.submit(self._serve, stream)
+
+    def _serve(self, stream):
+        with stream.frames:
+            stream.scheduled = False
+
+        connection = stream.connection
+        if connection is None:
+            return
+
+        lock = connection._connection_serve_lock
+
+        if not lock.acquire(False):
+            return
+
+        try:
+            while not connection.closed and stream.has_frame():
+                connection.serve(0)
+        except EOFError:
+            pass
+        except Exception:
+            logging.exception('Reactor: serving {} failed'.format(connection))
+            stream.close()
+        finally:
+            lock.release()
+
+        if stream.eof:
+            self._close(stream)
+        else:
+            self.schedule(stream)
+
+    def _close(self, stream):
+        with stream.frames:
+            connection, stream.connection = stream.connection, None
+
+        if connection is None:
+            return
+
+        try:
+            connection.close()
+        except Exception:
+            pass
+
+        if stream.on_close:
+            stream.on_close()
+
+    def close(self):
+        for loop in self.loops:
+            loop.active = False
+        self.pool.close()
@@ -16,49 +16,102 @@ import errno
 import random
 
 from Queue import Queue, Empty
-from threading import Thread, Event, RLock
+from collections import deque
+from threading import Thread, Lock, RLock, ThreadError
+from thread import get_ident
 
-from streams.PupySocketStream import addGetPeer
+from streams.PupySocketStream import addGetPeer, PupySocketStream
+import reactor
+import udpingress
+
+class RequestCancelled(Exception):
+    """ raised in the thread of a sync request cancelled by cancel_requests """
+    pass
+
+class SyncRequest(object):
+    """ completion of a sync request. The waiter blocks on a plain lock, which python 2
+    waits for without the sleep loop of Event.wait(timeout). wakeup() is also used to
+    hand the read side over when its owner leaves """
+
+    __slots__ = ( 'done', 'cancelled', 'thread', '_wakeup' )
+
+    def __init__(self):
+        self.done = False
+        self.cancelled = False
+        self.thread = get_ident()
+        self._wakeup = Lock()
+        self._wakeup.acquire()
+
+    def set(self):
+        self.done = True
+        self.wakeup()
+
+    def wakeup(self):
+        try:
+            self._wakeup.release()
+        except ThreadError:
+            # already woken, and not waited on yet
+            pass
+
+    def wait(self):
+        self._wakeup.acquire()
 
 class PupyConnection(Connection):
     def __init__(self, lock, *args, **kwargs):
-        self._sync_events = {}
+        self._sync_requests = {}
         self._connection_serve_lock = lock
+        self._serve_released = None # set by the reactor, see PupyReactor.schedule
         self._last_recv = time.time()
         Connection.__init__(self, *args, **kwargs)
 
     def sync_request(self, handler, *args):
         seq = self._send_request(handler, args)
-        logging.debug('Sync request: {}'.format(seq))
-        while not ( self._sync_events[seq].is_set() or self.closed ):
-            logging.debug('Sync poll until: {}'.format(seq))
+        request = self._sync_requests[seq]
+
+        # exactly one thread reads the connection: the serve lock holder. The others
+        # sleep until their reply is dispatched, or until the reader leaves
+        while not ( request.done or request.cancelled or self.closed ):
             if self._connection_serve_lock.acquire(False):
                 try:
-                    logging.debug('Sync poll serve: {}'.format(seq))
-                    if not self.serve(10):
-                        logging.debug('Sync poll serve interrupted: {}/inactive={}'.format(
-                            seq, self.inactive))
+                    while not ( request.done or request.cancelled or self.closed ):
+                        self.serve(10)
                 finally:
-                    logging.debug('Sync poll serve complete. release: {}'.format(seq))
                     self._connection_serve_lock.release()
+                    self._reader_released()
             else:
-                logging.debug('Sync poll wait: {}'.format(seq))
-                self._sync_events[seq].wait(timeout=10)
-
-            logging.debug('Sync poll complete: {}/inactive={}'.format(seq, self.inactive))
+                request.wait()
 
         logging.debug('Sync request handled: {}'.format(seq))
-        del self._sync_events[seq]
+        del self._sync_requests[seq]
 
         if self.closed:
             raise EOFError()
 
+        if request.cancelled and not request.done:
+            raise RequestCancelled('request {} cancelled'.format(seq))
+
         isexc, obj = self._sync_replies.pop(seq)
         if isexc:
             raise obj
         else:
             return obj
 
+    def cancel_requests(self, thread):
+        ''' give up the sync requests a thread waits for, their replies are dropped. A thread
+        reading the connection notices it once its current serve() returns '''
+        for request in self._sync_requests.values():
+            if request.thread == thread and not request.done:
+                request.cancelled = True
+                request.wakeup()
+
+    def _reader_released(self):
+        for request in self._sync_requests.values():
+            if not request.done:
+                request.wakeup()
+
+        if self._serve_released:
+            self._serve_released()
+
     def _send_request(self, handler, args, async=None):
         seq = next(self._seqcounter)
         if async:
@@ -66,7 +119,7 @@ class PupyConnection(Connection):
             self._async_callbacks[seq] = async
         else:
             logging.debug('Sync request: {}'.format(seq))
-            self._sync_events[seq] = Event()
+            self._sync_requests[seq] = SyncRequest()
 
         self._send(consts.MSG_REQUEST, seq, (handler, self._box(args)))
         return seq
@@ -79,21 +132,29 @@ class PupyConnection(Connection):
         sync = seq not in self._async_callbacks
         Connection._dispatch_reply(self, seq, raw)
         if sync:
-            self._sync_events[seq].set()
+            self._reply_received(seq)
 
     def _dispatch_exception(self, seq, raw):
         self._last_recv = time.time()
         sync = seq not in self._async_callbacks
         Connection._dispatch_exception(self, seq, raw)
         if sync:
-            self._sync_events[seq].set()
+            self._reply_received(seq)
+
+    def _reply_received(self, seq):
+        request = self._sync_requests.get(seq)
+        if request:
+            request.set()
+        else:
+            # cancelled
+            self._sync_replies.pop(seq, None)
 
     def close(self, *args):
         try:
             Connection.close(self, *args)
         finally:
-            for lock in self._sync_events.itervalues():
-                lock.set()
+            for request in self._sync_requests.values():
+                request.wakeup()
 
     @property
     def inactive(self):
@@ -116,8 +177,44 @@ class PupyTCPServer(ThreadedServer):
         del kwargs["transport"]
         del kwargs["transport_kwargs"]
 
+        # event driven mode, see network/lib/reactor.py
+        use_reactor = kwargs.pop("reactor", False)
+        reactor_threads = kwargs.pop("reactor_threads", 1)
+        reactor_workers = kwargs.pop("reactor_workers", 16)
+        handshake_workers = kwargs.pop("handshake_workers", 8)
+        self.handshake_timeout = kwargs.pop("handshake_timeout", 15)
+
         ThreadedServer.__init__(self, *args, **kwargs)
 
+        self.reactor = None
+        if use_reactor:
+            if not reactor.available:
+                self.logger.warning('epoll is not available, falling back to a thread per client')
+            elif not issubclass(self.stream_class, PupySocketStream):
+                self.logger.warning('{} does not support the reactor, falling back to a thread per client'.format(
+                    self.stream_class.__name__))
+            else:
+                self.stream_class = reactor.reactor_stream(self.stream_class)
+                self.reactor = reactor.PupyReactor(reactor_threads, reactor_workers)
+                # handshakes block, they get their own threads: clients that connect and
+                # say nothing (a port scan is enough) must not hold the session workers
+                self.handshakes = reactor.WorkerPool(
+                    handshake_workers, 'PupyHandshake', backlog=handshake_workers*32)
+
+    def _accept_method(self, sock):
+        if not self.reactor:
+            ThreadedServer._accept_method(self, sock)
+        elif not self.handshakes.submit(self._authenticate_and_register_client, sock):
+            self.logger.warning('Too many pending handshakes, dropping a connection')
+            sock.close()
+            self.clients.discard(sock)
+
+    def close(self):
+        ThreadedServer.close(self)
+        if self.reactor:
+            self.handshakes.close()
+            self.reactor.close()
+
     def _setup_connection(self, lock, sock, queue):
         '''Authenticate a client and if it succeeds, wraps the socket in a connection object.
         Note that this code is cut and paste from the rpyc internals and may have to be
@@ -203,6 +300,80 @@ class PupyTCPServer(ThreadedServer):
 
             self.clients.discard(sock)
 
+    def _authenticate_and_register_client(self, sock):
+        ''' reactor mode: runs in a handshake worker, the session is served by the reactor
+        afterwards '''
+        queue = Queue(maxsize=1)
+        lock = RLock()
+
+        try:
+            tup = sock.getpeername()
+        except socket.error:
+            # gave up while waiting for a worker
+            sock.close()
+            self.clients.discard(sock)
+            return
+
+        h, p = tup[0], tup[1]
+
+        # no thread waits for us here, don't let a silent client hold the worker
+        sock.settimeout(self.handshake_timeout)
+        try:
+            self._setup_connection(lock, sock, queue)
+        except Exception as e:
+            self.logger.debug('{}:{} Setup failed: {}'.format(h, p, e))
+            if queue.empty():
+                queue.put_nowait((None, None, None))
+
+        connection, wrapper, credentials = queue.get_nowait()
+
+        def cleanup():
+            self.logger.debug('{}:{} Shutting down'.format(h, p))
+
+            try:
+                sock.shutdown(socket.SHUT_RDWR)
+            except Exception:
+                pass
+
+            if wrapper:
+                wrapper.close()
+
+            self.clients.discard(sock)
+
+        if not connection:
+            cleanup()
+            return
+
+        # the reactor reads what epoll says is there and no more, see ReactorStream
+        sock.setblocking(0)
+        if wrapper is not sock:
+            wrapper.setblocking(0)
+
+        self.reactor.register(connection._channel.stream, connection, on_close=cleanup)
+
+        try:
+            self.logger.debug('{}:{} Initializing service...'.format(h, p))
+            connection._init_service()
+        except (EOFError, TypeError):
+            connection._channel.stream.close()
+            self.reactor.schedule(connection._channel.stream)
+
+class UDPSession(object):
+    """ datagrams of a peer waiting for a worker, processed in order by one worker at a time.
+    A dead session (failed authentication) is out of the server's table, what still reaches
+    it is dropped and the next datagram of the peer starts over """
+
+    __slots__ = ( 'addr', 'sock', 'stream', 'datagrams', 'scheduled', 'dead', 'lock' )
+
+    def __init__(self, addr, sock):
+        self.addr=addr
+        self.sock=sock
+        self.stream=None
+        self.datagrams=deque()
+        self.scheduled=False
+        self.dead=False
+        self.lock=Lock()
+
 class PupyUDPServer(object):
     def __init__(self, service, **kwargs):
         if not "stream" in kwargs:
@@ -220,68 +391,115 @@ class PupyUDPServer(object):
         self.protocol_config=kwargs.get("protocol_config", {})
         self.service=service
 
+        # sockets sharing the port, one receive thread each (see network/lib/udpingress.py)
+        self.shards=kwargs.get("shards", 1)
+        self.batch=kwargs.get("batch", 64)
+        # the transports of the sessions run there, not on the receive threads
+        self.workers=reactor.WorkerPool(kwargs.get("workers", 8), name='PupyUDPWorker')
+
         self.active=False
         self.clients={}
+        self.clients_lock=Lock()
         self.sock=None
+        self.sockets=[]
         self.hostname=kwargs['hostname']
         self.port=kwargs['port']
 
     def listen(self):
-        s=None
         if not self.hostname:
             self.hostname=None
-        last_exc=None
-        for res in socket.getaddrinfo(self.hostname, self.port, socket.AF_UNSPEC, socket.SOCK_DGRAM, 0, socket.AI_PASSIVE):
-            af, socktype, proto, canonname, sa = res
-            try:
-                s = socket.socket(af, socktype, proto)
-                s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-            except socket.error as msg:
-                s = None
-                last_exc=msg
-                continue
-            try:
-                s.bind(sa)
-            except socket.error as msg:
-                s.close()
-                s = None
-                last_exc=msg
-                continue
-            break
-        self.sock=s
-        if self.sock is None:
-            raise last_exc
-
-    def accept(self):
+        self.sockets=udpingress.bind_shards(self.hostname, self.port, self.shards)
+        self.sock=self.sockets[0]
+        self.receivers=dict((s, udpingress.BatchReceiver(s, self.batch)) for s in self.sockets)
+
+    def accept(self, sock=None):
+        """ receive a batch of datagrams and queue them to their sessions """
+        sock=sock or self.sock
         try:
-            data, addr = self.sock.recvfrom(40960)
-            if data:
-                self.dispatch_data(data, addr)
-            else:
-                self.clients[addr].close()
+            for data, addr in self.receivers[sock].receive():
+                self.dispatch_data(data, addr, sock)
         except Exception as e:
-            logging.error(e)
+            if self.active:
+                logging.error(e)
+
+    def dispatch_data(self, data_received, addr, sock=None):
+        with self.clients_lock:
+            session=self.clients.get(addr)
+            if session is None:
+                session=UDPSession(addr, sock or self.sock)
+                self.clients[addr]=session
+
+        with session.lock:
+            if session.dead:
+                return
+            session.datagrams.append(data_received)
+            if session.scheduled:
+                return
+            session.scheduled=True
 
-    def dispatch_data(self, data_received, addr):
-        host, port=addr[0], addr[1]
-        if addr not in self.clients:
-            logging.info("new client connected : %s:%s"%(host, port))
-            config = dict(self.protocol_config, credentials=None, connid="%s:%d"%(host, port))
-            if self.authenticator:
-                try:
-                    sock, credentials = self.authenticator(data_received)
-                    config["credentials"]=credentials
-                except AuthenticationError:
-                    logging.info("failed to authenticate, rejecting data")
-                    raise
-            self.clients[addr]=self.stream_class((self.sock, addr), self.transport_class, self.transport_kwargs, client_side=False)
-            conn=Connection(self.service, Channel(self.clients[addr]), config=config, _lazy=True)
-            t = Thread(target = self.handle_new_conn, args=(conn,))
-            t.daemon=True
-            t.start()
-        with self.clients[addr].downstream_lock:
-            self.clients[addr].buf_in.write(data_received)
-            self.clients[addr].transport.downstream_recv(self.clients[addr].buf_in)
+        self.workers.submit(self._process, session)
+
+    def _drop_session(self, session):
+        with session.lock:
+            session.dead=True
+            session.datagrams.clear()
+
+        with self.clients_lock:
+            if self.clients.get(session.addr) is session:
+                del self.clients[session.addr]
+
+    def _process(self, session):
+        while True:
+            with session.lock:
+                if session.dead or not session.datagrams:
+                    session.datagrams.clear()
+                    session.scheduled=False
+                    return
+                datagrams=list(session.datagrams)
+                session.datagrams.clear()
+
+            try:
+                self._process_datagrams(session, datagrams)
+            except Exception as e:
+                logging.error(e)
+
+    def _process_datagrams(self, session, datagrams):
+        if session.stream is None and not self._setup_session(session, datagrams[0]):
+            return
+
+        stream=session.stream
+        with stream.downstream_lock:
+            for data in datagrams:
+                if not data:
+                    stream.close()
+                    continue
+                stream.buf_in.write(data)
+            if not stream.closed:
+                stream.transport.downstream_recv(stream.buf_in)
+
+        if stream.closed:
+            # given up by its transport, or closed by rpyc
+            self._drop_session(session)
+
+    def _setup_session(self, session, data_received):
+        host, port=session.addr[0], session.addr[1]
+        logging.info("new client connected : %s:%s"%(host, port))
+        config = dict(self.protocol_config, credentials=None, connid="%s:%d"%(host, port))
+        if self.authenticator:
+            try:
+                sock, credentials = self.authenticator(data_received)
+                config["credentials"]=credentials
+            except AuthenticationError:
+                logging.info("failed to authenticate, rejecting data")
+                self._drop_session(session)
+                return False
+
+        session.stream=self.stream_class((session.sock, session.addr), self.transport_class, self.transport_kwargs, client_side=False)
+        conn=Connection(self.service, Channel(session.stream), config=config, _lazy=True)
+        t = Thread(target = self.handle_new_conn, args=(conn,))
+        t.daemon=True
+        t.start()
+        return True
 
     def handle_new_conn(self, conn):
         try:
@@ -290,12 +508,19 @@ class PupyUDPServer(object):
         except Exception as e:
             logging.error(e)
 
+    def _receive_loop(self, sock):
+        while self.active:
+            self.accept(sock)
+
     def start(self):
         self.listen()
         self.active=True
+        for sock in self.sockets[1:]:
+            t=Thread(target=self._receive_loop, args=(sock,))
+            t.daemon=True
+            t.start()
         try:
-            while self.active:
-                self.accept()
+            self._receive_loop(self.sock)
         except EOFError:
             pass # server closed by another thread
         except KeyboardInterrupt:
@@ -307,4 +532,6 @@ class PupyUDPServer(object):
 
     def close(self):
         self.active=False
-        self.sock.close()
+        for sock in self.sockets:
+            sock.close()
+        self.workers.close()
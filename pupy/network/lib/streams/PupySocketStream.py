@@ -136,6 +136,7 @@ class PupyUDPSocketStream(object):
         self.upstream_lock=threading.Lock()
         self.downstream_lock=threading.Lock()
 
+        self._closed=False
         self.transport=transport_class(self, **transport_kwargs)
         self.on_connect()
         self.total_timeout=0
@@ -145,14 +146,26 @@ class PupyUDPSocketStream(object):
        self.transport.on_connect()
 
     def poll(self, timeout):
-        return len(self.upstream)>0 or self._poll_read(timeout=timeout)
+        if len(self.upstream)>0:
+            return True
+        if self._closed:
+            raise EOFError("stream closed")
+        return self._poll_read(timeout=timeout)
 
     def close(self):
-        pass
+        """ the server's socket is shared by every session, only the client closes it """
+        if self._closed:
+            return
+        self._closed=True
+        if self.client_side:
+            try:
+                self.sock.close()
+            except Exception:
+                pass
 
     @property
     def closed(self):
-        return self.close()
+        return self._closed
 
     def _upstream_recv(self):
         """ called as a callback on the downstream.write """
@@ -192,6 +205,8 @@ class PupyUDPSocketStream(object):
             if len(self.upstream)>=count:
                 return self.upstream.read(count)
             while len(self.upstream)<count:
+                if self._closed:
+                    raise EOFError("stream closed")
                 if self.client_side:
                     with self.downstream_lock:
                         if self._poll_read(0):
@@ -200,10 +215,14 @@ class PupyUDPSocketStream(object):
                     time.sleep(0.0001)
 
             return self.upstream.read(count)
+        except EOFError:
+            raise
         except Exception as e:
             logging.debug(traceback.format_exc())
 
     def write(self, data):
+        if self._closed:
+            raise EOFError("stream closed")
         try:
             with self.upstream_lock:
                 self.buf_out.write(data)
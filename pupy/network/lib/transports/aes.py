@@ -17,12 +17,13 @@ try:
     from Crypto.Protocol.KDF import PBKDF2
     from Crypto.Hash import SHA256, HMAC
 except ImportError as e:
-    logging.warning("pycrypto not available, using pure python libraries (slower)")
     PBKDF2=None
     AES=None
     Random=None
-    from cryptoutils.pbkdf2 import pbkdf2_bin
-    import cryptoutils.pyaes as pyaes
+    import cryptoutils
+    from cryptoutils import pbkdf2_bin, AESModeOfOperationCBC
+    if not cryptoutils.NATIVE:
+        logging.warning("pycrypto not available, using pure python libraries (slower)")
 
 BLOCK_SIZE=16
 
@@ -54,7 +55,7 @@ class AESTransport(BasePupyTransport):
         if AES is not None:
             self.enc_cipher = AES.new(self._derived_key, AES.MODE_CBC, self._iv_enc)
         else:
-            self.enc_cipher = pyaes.AESModeOfOperationCBC(self._derived_key, iv = self._iv_enc)
+            self.enc_cipher = AESModeOfOperationCBC(self._derived_key, iv = self._iv_enc)
         self.dec_cipher = None
         self._iv_dec = None
         self.size_to_read=None
@@ -86,7 +87,7 @@ class AESTransport(BasePupyTransport):
                 if AES is not None:
                     self.dec_cipher = AES.new(self._derived_key, AES.MODE_CBC, self._iv_dec)
                 else:
-                    self.dec_cipher = pyaes.AESModeOfOperationCBC(self._derived_key, iv = self._iv_dec)
+                    self.dec_cipher = AESModeOfOperationCBC(self._derived_key, iv = self._iv_dec)
                 data.drain(BLOCK_SIZE)
                 enc=enc[BLOCK_SIZE:]
                 if not enc:
@@ -0,0 +1,151 @@
+# -*- coding: utf-8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" Per frame compression for the transport chain. Every write from the upper layer
+becomes one frame: a type byte and the little endian length of the payload. Frames
+that don't shrink are sent raw. Put it last in chain_transports, so it compresses
+cleartext before the encrypting layers """
+
+from ..base import BasePupyTransport, TransportError
+import logging
+import traceback
+import struct
+import zlib
+
+try:
+    from lz4.block import compress as lz4_compress, decompress as lz4_decompress
+except ImportError:
+    try:
+        from lz4 import compress as lz4_compress, decompress as lz4_decompress
+    except ImportError:
+        lz4_compress = None
+        lz4_decompress = None
+
+FRAME_RAW=0
+FRAME_ZLIB=1
+FRAME_ZLIB_STREAM=2 # zlib stream shared by all the frames of the session
+FRAME_LZ4=3
+FRAME_HELLO=0xff # codecs the sender can decode, sent once by each side
+
+CODEC_ZLIB=1
+CODEC_LZ4=2
+
+HEADER=struct.Struct("<BI")
+
+class CompressionTransport(BasePupyTransport):
+    """
+    Compresses every frame with zlib or LZ4, whichever the conf asks for and both
+    sides support. In dictionary mode zlib keeps its window across frames, so
+    repeated names and pushed modules compress against what was already sent
+    """
+    codec="zlib" # zlib or lz4, lz4 falls back to zlib if the peer doesn't have it
+    level=6
+    dictionary=False
+    min_size=64 # smaller frames are never worth it
+
+    def __init__(self, *args, **kwargs):
+        super(CompressionTransport, self).__init__(*args, **kwargs)
+        for name in ("codec", "level", "dictionary", "min_size"):
+            if name in kwargs:
+                setattr(self, name, kwargs[name])
+
+        if self.codec not in ("zlib", "lz4"):
+            raise TransportError("Unknown compression codec %s"%self.codec)
+
+        self.level=int(self.level)
+        self.min_size=int(self.min_size)
+        if isinstance(self.dictionary, basestring): # from the command line
+            self.dictionary=self.dictionary.lower() in ("1", "true", "yes", "on")
+        self.peer_codecs=CODEC_ZLIB
+        self.compressor=None
+        if self.dictionary:
+            self.compressor=zlib.compressobj(self.level)
+        self.decompressor=zlib.decompressobj()
+        self.frame=None
+        self.stats={"cleartext": 0, "sent": 0, "raw_frames": 0}
+
+    def on_connect(self):
+        codecs=CODEC_ZLIB
+        if lz4_decompress is not None:
+            codecs|=CODEC_LZ4
+        self.downstream.write(HEADER.pack(FRAME_HELLO, 1)+chr(codecs))
+
+    def _compress(self, data):
+        """ (frame type, payload) for this chunk of cleartext """
+        if len(data) < self.min_size:
+            return FRAME_RAW, data
+
+        if self.codec == "lz4" and lz4_compress is not None and self.peer_codecs & CODEC_LZ4:
+            return FRAME_LZ4, lz4_compress(data)
+
+        if self.compressor is None:
+            return FRAME_ZLIB, zlib.compress(data, self.level)
+
+        # the peer only feeds stream frames to its decompressor, so a bypassed
+        # frame must leave ours as it was
+        saved=self.compressor.copy()
+        compressed=self.compressor.compress(data)+self.compressor.flush(zlib.Z_SYNC_FLUSH)
+        if len(compressed) >= len(data):
+            self.compressor=saved
+        return FRAME_ZLIB_STREAM, compressed
+
+    def _decompress(self, frame_type, payload):
+        if frame_type == FRAME_RAW:
+            return payload
+        elif frame_type == FRAME_ZLIB:
+            return zlib.decompress(payload)
+        elif frame_type == FRAME_ZLIB_STREAM:
+            return self.decompressor.decompress(payload)
+        elif frame_type == FRAME_LZ4:
+            if lz4_decompress is None:
+                raise TransportError("LZ4 frame received but lz4 is not available")
+            return lz4_decompress(payload)
+        elif frame_type == FRAME_HELLO:
+            self.peer_codecs=ord(payload[0])
+            return b""
+        raise TransportError("Unknown compression frame type %d"%frame_type)
+
+    def upstream_recv(self, data):
+        try:
+            cleartext=data.read()
+            if not cleartext:
+                return
+
+            frame_type, payload=self._compress(cleartext)
+            if len(payload) >= len(cleartext):
+                frame_type, payload=FRAME_RAW, cleartext
+            if frame_type == FRAME_RAW:
+                self.stats["raw_frames"]+=1
+
+            self.stats["cleartext"]+=len(cleartext)
+            self.stats["sent"]+=len(payload)+HEADER.size
+            self.downstream.write(HEADER.pack(frame_type, len(payload))+payload)
+        except Exception as e:
+            logging.debug(traceback.format_exc())
+
+    def downstream_recv(self, data):
+        try:
+            cleartext=[]
+            while True:
+                if self.frame is None:
+                    if len(data) < HEADER.size:
+                        break
+                    self.frame=HEADER.unpack(data.read(HEADER.size))
+
+                frame_type, size=self.frame
+                if len(data) < size:
+                    break
+
+                cleartext.append(self._decompress(frame_type, data.read(size)))
+                self.frame=None
+
+            if cleartext:
+                self.upstream.write(b"".join(cleartext))
+        except Exception as e:
+            logging.debug(traceback.format_exc())
+
+class CompressionClient(CompressionTransport):
+    pass
+
+class CompressionServer(CompressionTransport):
+    pass
@@ -0,0 +1,79 @@
+# -*- coding: utf-8 -*-
+""" AES and PBKDF2 for the transports when pycrypto is not available. Uses the
+builtin _pupycrypto module when the client has it, pyaes and pbkdf2 otherwise """
+
+import hashlib
+
+try:
+    import _pupycrypto
+except ImportError:
+    _pupycrypto = None
+
+NATIVE = _pupycrypto is not None
+
+if NATIVE:
+    class NativeCipher(object):
+        """ AES state held by _pupycrypto. Like with pyaes, one object per
+        direction: the chaining block/counter carries over between calls """
+
+        __slots__ = ( 'handle', )
+
+        def __del__(self):
+            if self.handle:
+                _pupycrypto.aes_free(self.handle)
+                self.handle = None
+
+        def encrypt(self, plaintext):
+            return _pupycrypto.aes_encrypt(self.handle, plaintext)
+
+        def decrypt(self, ciphertext):
+            return _pupycrypto.aes_decrypt(self.handle, ciphertext)
+
+    class AESModeOfOperationCBC(NativeCipher):
+        __slots__ = ()
+
+        def __init__(self, key, iv=None):
+            self.handle = None
+            self.handle = _pupycrypto.aes_cbc(key, iv or b'\x00'*16)
+
+    class AESModeOfOperationCTR(NativeCipher):
+        __slots__ = ()
+
+        def __init__(self, key, counter=None):
+            """ counter is the initial value, as an int or a pyaes.Counter """
+            if counter is None:
+                counter = 1
+            if isinstance(counter, (int, long)):
+                block = ('%032x' % (counter % (1 << 128))).decode('hex')
+            else:
+                block = b''.join(chr(x) for x in counter.value)
+
+            self.handle = None
+            self.handle = _pupycrypto.aes_ctr(key, block)
+
+    def pbkdf2_bin(data, salt, iterations=1000, keylen=24, hashfunc=None):
+        if hashfunc is hashlib.sha256:
+            return _pupycrypto.pbkdf2_sha256(data, salt, iterations, keylen)
+
+        from .pbkdf2 import pbkdf2_bin as pbkdf2_bin_python
+        return pbkdf2_bin_python(data, salt, iterations, keylen, hashfunc)
+
+else:
+    from .pyaes import AESModeOfOperationCTR
+    from .pyaes import AESModeOfOperationCBC as AESModeOfOperationCBCBlock
+    from .pbkdf2 import pbkdf2_bin
+
+    class AESModeOfOperationCBC(AESModeOfOperationCBCBlock):
+        """ pyaes CBC only takes a single block per call """
+
+        def encrypt(self, plaintext):
+            return b''.join(
+                AESModeOfOperationCBCBlock.encrypt(self, plaintext[i:i+16]) \
+                for i in xrange(0, len(plaintext), 16)
+            )
+
+        def decrypt(self, ciphertext):
+            return b''.join(
+                AESModeOfOperationCBCBlock.decrypt(self, ciphertext[i:i+16]) \
+                for i in xrange(0, len(ciphertext), 16)
+            )
@@ -0,0 +1,451 @@
+# -*- coding: utf-8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" Reliable, ordered delivery for the UDP transports. Writes from the upper layer are cut
+in segments of at most <mss> bytes, numbered, and kept until the peer acknowledges them.
+Acks are cumulative and carry selective ack blocks for what arrived out of order. Up to
+<window> segments are in flight, a lost one is sent again once later segments are acked,
+or after a timeout derived from the measured RTT. With fec, every group of up to <fec>
+small segments is followed by their XOR, a single loss in the group is repaired without
+waiting for a retransmit. Put it first in chain_transports, under the encrypting layers.
+Packets are self delimited, the server may feed several datagrams at once """
+
+from ..base import BasePupyTransport
+from collections import deque
+import threading
+import logging
+import traceback
+import binascii
+import struct
+import time
+
+PACKET_DATA=1
+PACKET_ACK=2 # the flags byte is the number of sack blocks in the payload
+PACKET_PARITY=3 # seq is the first segment of the group, the flags byte their number
+
+FLAG_PROTECTED=1 # the segment is part of a parity group
+
+# type, flags, payload length, seq, cumulative ack (next seq expected)
+HEADER=struct.Struct("!BBHII")
+BLOCK=struct.Struct("!II") # [start, end) received out of order
+LENGTH=struct.Struct("!H")
+
+TICK=0.01 # granularity of the retransmit and delayed ack timers
+MIN_RTO=0.1
+MAX_RTO=10.0
+INITIAL_RTO=1.0
+MAX_SACK_BLOCKS=16
+RECEIVE_LIMIT=65536 # segments buffered ahead of the first missing one
+MAX_GROUP=255
+
+def _xor(blocks, size):
+    """ XOR of blocks, each one zero padded to size """
+    value=0
+    for block in blocks:
+        value^=int(binascii.hexlify(block.ljust(size, b"\0")), 16)
+    return binascii.unhexlify("%0*x"%(size*2, value))
+
+class _Segment(object):
+    __slots__=("payload", "flags", "sent", "retransmits", "sacked")
+
+    def __init__(self, payload, flags):
+        self.payload=payload
+        self.flags=flags
+        self.sent=0
+        self.retransmits=0
+        self.sacked=False
+
+class _Ticker(object):
+    """ one thread runs the timers of every reliable transport with something in flight,
+    transports leave it when they are idle """
+    def __init__(self):
+        self.lock=threading.Lock()
+        self.transports=set()
+        self.active=threading.Event()
+        self.thread=None
+
+    def add(self, transport):
+        with self.lock:
+            self.transports.add(transport)
+            self.active.set()
+            if self.thread is None:
+                self.thread=threading.Thread(target=self._run, name="PupyReliableTicker")
+                self.thread.daemon=True
+                self.thread.start()
+
+    def discard(self, transport):
+        with self.lock:
+            self.transports.discard(transport)
+
+    def _run(self):
+        while True:
+            self.active.wait()
+            time.sleep(TICK)
+            with self.lock:
+                transports=list(self.transports)
+                if not transports:
+                    self.active.clear()
+
+            for transport in transports:
+                try:
+                    transport.tick()
+                except Exception:
+                    logging.debug(traceback.format_exc())
+
+TICKER=_Ticker()
+
+class ReliableTransport(BasePupyTransport):
+    """
+    Sequence numbers, selective acks and retransmits over datagrams. The window is a
+    fixed number of segments, there is no congestion control: size it for the link
+    """
+    mss=1400 # largest payload of a datagram
+    window=128 # segments sent and not acknowledged yet
+    fec=0 # segments per parity packet, 0 disables it
+    fec_size=256 # only segments up to this size are protected
+    ack_delay=0.02 # a lone in order segment is acked after this, or with the next data
+    max_retransmits=12 # consecutive timeouts before the peer is given up
+    # a udp server learns about a client from its first datagram, and the client's rpyc
+    # waits for the server: the handshakes of the layers above (RSA/AES) go out at once
+    flush_on_connect=True
+
+    def __init__(self, *args, **kwargs):
+        super(ReliableTransport, self).__init__(*args, **kwargs)
+        for name in ("mss", "window", "fec", "fec_size", "ack_delay", "max_retransmits"):
+            if name in kwargs:
+                setattr(self, name, kwargs[name])
+
+        # may come from the command line as strings
+        self.mss=int(self.mss)
+        self.window=max(int(self.window), 1)
+        self.fec=min(int(self.fec), MAX_GROUP)
+        self.fec_size=int(self.fec_size)
+        self.ack_delay=float(self.ack_delay)
+        self.max_retransmits=int(self.max_retransmits)
+
+        self.lock=threading.Lock()
+        self.ticking=False
+
+        # sender
+        self.snd_una=0 # oldest segment not acknowledged
+        self.snd_next=0
+        self.inflight={} # seq -> _Segment
+        self.queue=deque() # segments waiting for room in the window
+        self.group=[] # (seq, payload) of the open parity group
+        self.highest_sacked=-1
+        self.srtt=None
+        self.rttvar=0
+        self.rto=INITIAL_RTO
+        self.timeouts=0
+
+        # receiver
+        self.rcv_next=0
+        self.out_of_order={} # seq -> payload
+        self.protected={} # seq -> payload of the protected segments, for repairs
+        self.parities={} # first seq -> (count, parity)
+        self.ack_pending=0 # in order segments not acknowledged yet
+        self.ack_deadline=None
+
+        self.stats={"sent": 0, "retransmitted": 0, "received": 0, "duplicates": 0, "repaired": 0}
+
+    def on_close(self):
+        with self.lock:
+            self.closed=True
+            self.inflight.clear()
+            self.queue.clear()
+            TICKER.discard(self)
+
+    def _arm(self):
+        if not self.ticking and not self.closed:
+            self.ticking=True
+            TICKER.add(self)
+
+    def _write(self, kind, flags, seq, payload):
+        self.downstream.write(HEADER.pack(kind, flags, len(payload), seq, self.rcv_next)+payload)
+
+    # sender
+
+    def upstream_recv(self, data):
+        try:
+            payload=data.read()
+            if not payload:
+                return
+
+            with self.lock:
+                if self.closed:
+                    return
+                for i in xrange(0, len(payload), self.mss):
+                    self.queue.append(payload[i:i+self.mss])
+                self._send_queued()
+        except Exception as e:
+            logging.debug(traceback.format_exc())
+
+    def _send_queued(self):
+        while self.queue and self.snd_next - self.snd_una < self.window and not self.closed:
+            payload=self.queue.popleft()
+            flags=0
+            if self.fec and len(payload) <= self.fec_size:
+                flags=FLAG_PROTECTED
+            else:
+                # a group covers consecutive segments
+                self._close_group()
+
+            seq=self.snd_next
+            self.snd_next+=1
+            segment=self.inflight[seq]=_Segment(payload, flags)
+            self._transmit(seq, segment)
+
+            if flags & FLAG_PROTECTED:
+                self.group.append((seq, payload))
+                if len(self.group) >= self.fec:
+                    self._close_group()
+
+        # a group never waits for the next write
+        self._close_group()
+
+    def _close_group(self):
+        if not self.group:
+            return
+
+        blocks=[LENGTH.pack(len(payload))+payload for _, payload in self.group]
+        parity=_xor(blocks, max(len(block) for block in blocks))
+        self._write(PACKET_PARITY, len(self.group), self.group[0][0], parity)
+        self.group=[]
+
+    def _transmit(self, seq, segment):
+        segment.sent=time.time()
+        self._write(PACKET_DATA, segment.flags, seq, segment.payload)
+        self.stats["sent"]+=1
+        # the cumulative ack went with it
+        if not self.out_of_order:
+            self.ack_pending=0
+            self.ack_deadline=None
+        self._arm()
+
+    def _retransmit(self, seq, segment):
+        segment.retransmits+=1
+        self.stats["retransmitted"]+=1
+        self._transmit(seq, segment)
+
+    def _update_rtt(self, sample):
+        # RFC 6298
+        if self.srtt is None:
+            self.srtt=sample
+            self.rttvar=sample/2
+        else:
+            self.rttvar=0.75*self.rttvar+0.25*abs(self.srtt-sample)
+            self.srtt=0.875*self.srtt+0.125*sample
+        self.rto=min(max(self.srtt+max(TICK, 4*self.rttvar), MIN_RTO), MAX_RTO)
+
+    def _on_ack(self, ack, count=0, blocks=b""):
+        if ack > self.snd_next:
+            return
+
+        now=time.time()
+        sample=None
+        if ack > self.snd_una:
+            self.timeouts=0
+        while self.snd_una < ack:
+            segment=self.inflight.pop(self.snd_una, None)
+            # Karn: a retransmitted segment doesn't tell which copy was acked
+            if segment is not None and not segment.retransmits and not segment.sacked:
+                sample=now-segment.sent
+            self.snd_una+=1
+
+        for i in xrange(min(count, len(blocks)//BLOCK.size)):
+            start, end=BLOCK.unpack_from(blocks, i*BLOCK.size)
+            for seq in xrange(max(start, self.snd_una), min(end, self.snd_next)):
+                segment=self.inflight.get(seq)
+                if segment is None or segment.sacked:
+                    continue
+                if not segment.retransmits:
+                    sample=now-segment.sent
+                segment.sacked=True
+                segment.payload=None
+                self.highest_sacked=max(self.highest_sacked, seq)
+
+        if sample is not None:
+            self._update_rtt(sample)
+
+        # what was sent before a segment that made it and is still missing is lost,
+        # unless it was sent again less than a RTT ago
+        if self.highest_sacked > self.snd_una:
+            threshold=now-1.25*(self.srtt or self.rto)
+            for seq in xrange(self.snd_una, self.highest_sacked):
+                segment=self.inflight.get(seq)
+                if segment is not None and not segment.sacked and segment.sent <= threshold:
+                    self._retransmit(seq, segment)
+
+    def tick(self):
+        """ retransmit timer and delayed acks, run by the ticker thread """
+        give_up=False
+        with self.lock:
+            if self.closed:
+                self.ticking=False
+                TICKER.discard(self)
+                return
+
+            now=time.time()
+            if self.ack_pending and self.ack_deadline is not None and now >= self.ack_deadline:
+                self._send_ack()
+
+            for seq in xrange(self.snd_una, self.snd_next):
+                segment=self.inflight.get(seq)
+                if segment is None or segment.sacked:
+                    continue
+
+                if now-segment.sent >= self.rto:
+                    self.timeouts+=1
+                    if self.timeouts > self.max_retransmits:
+                        give_up=True
+                        break
+
+                    for seq in xrange(seq, self.snd_next):
+                        segment=self.inflight.get(seq)
+                        if segment is not None and not segment.sacked and now-segment.sent >= self.rto:
+                            self._retransmit(seq, segment)
+                    self.rto=min(self.rto*2, MAX_RTO)
+                break
+
+            if not give_up and not self.inflight and not self.ack_pending:
+                self.ticking=False
+                TICKER.discard(self)
+
+        if give_up:
+            logging.warning("reliable transport: no ack after %d retransmits, closing"%self.max_retransmits)
+            self.close()
+
+    # receiver
+
+    def _send_ack(self):
+        blocks=[]
+        if self.out_of_order:
+            start=end=None
+            for seq in sorted(self.out_of_order):
+                if seq == end:
+                    end+=1
+                    continue
+                if start is not None:
+                    blocks.append(BLOCK.pack(start, end))
+                    if len(blocks) == MAX_SACK_BLOCKS:
+                        start=None
+                        break
+                start, end=seq, seq+1
+            if start is not None:
+                blocks.append(BLOCK.pack(start, end))
+
+        self._write(PACKET_ACK, len(blocks), 0, b"".join(blocks))
+        self.ack_pending=0
+        self.ack_deadline=None
+
+    def _accept(self, seq, flags, payload, delivered):
+        """ True if the peer should be acked at once """
+        if seq < self.rcv_next or seq in self.out_of_order:
+            self.stats["duplicates"]+=1
+            return True
+
+        if seq >= self.rcv_next+RECEIVE_LIMIT:
+            return False
+
+        self.stats["received"]+=1
+        if flags & FLAG_PROTECTED:
+            self.protected[seq]=payload
+
+        if seq != self.rcv_next:
+            self.out_of_order[seq]=payload
+            return True
+
+        delivered.append(payload)
+        self.rcv_next+=1
+        while self.rcv_next in self.out_of_order:
+            delivered.append(self.out_of_order.pop(self.rcv_next))
+            self.rcv_next+=1
+
+        self.ack_pending+=1
+        # a hole was filled, or there are others: tell the sender right away
+        return len(delivered) > 1 or bool(self.out_of_order)
+
+    def _repair(self, delivered):
+        """ rebuild the segment missing from a parity group, if it is the only one """
+        immediate=False
+        for first, (count, parity) in self.parities.items():
+            if first+count <= self.rcv_next:
+                del self.parities[first]
+                continue
+
+            missing=[seq for seq in xrange(first, first+count) if seq not in self.protected]
+            if len(missing) > 1:
+                continue
+
+            del self.parities[first]
+            if not missing:
+                continue
+
+            blocks=[LENGTH.pack(len(self.protected[seq]))+self.protected[seq]
+                for seq in xrange(first, first+count) if seq != missing[0]]
+            raw=_xor(blocks+[parity], len(parity))
+            size,=LENGTH.unpack(raw[:LENGTH.size])
+            self.stats["repaired"]+=1
+            immediate|=self._accept(missing[0], FLAG_PROTECTED, raw[LENGTH.size:LENGTH.size+size], delivered)
+
+        if len(self.protected) > 2*MAX_GROUP:
+            # a group can't reach further back than MAX_GROUP segments
+            self.protected=dict((seq, payload) for seq, payload in self.protected.iteritems()
+                if seq >= self.rcv_next-MAX_GROUP)
+
+        return immediate
+
+    def downstream_recv(self, data):
+        try:
+            with self.lock:
+                if self.closed:
+                    data.read()
+                    return
+
+                delivered=[]
+                immediate=False
+                while len(data) >= HEADER.size:
+                    kind, flags, size, seq, ack=HEADER.unpack(data.read(HEADER.size))
+                    if len(data) < size:
+                        break
+
+                    payload=data.read(size)
+                    if kind == PACKET_DATA:
+                        self._on_ack(ack)
+                        immediate|=self._accept(seq, flags, payload, delivered)
+                        if flags & FLAG_PROTECTED and self.parities:
+                            immediate|=self._repair(delivered)
+                    elif kind == PACKET_ACK:
+                        self._on_ack(ack, flags, payload)
+                    elif kind == PACKET_PARITY:
+                        self._on_ack(ack)
+                        if seq+flags > self.rcv_next and flags:
+                            self.parities[seq]=(flags, payload)
+                            immediate|=self._repair(delivered)
+                    else:
+                        logging.debug("reliable transport: unknown packet type %d"%kind)
+                        break
+
+                # a truncated or unknown packet, the rest of the datagram is lost
+                if len(data):
+                    data.read()
+
+                if delivered:
+                    self.upstream.write(b"".join(delivered))
+
+                # acks may have opened the window, data carries the ack
+                self._send_queued()
+
+                if immediate or self.ack_pending >= 2:
+                    self._send_ack()
+                elif self.ack_pending and self.ack_deadline is None:
+                    self.ack_deadline=time.time()+self.ack_delay
+                    self._arm()
+        except Exception as e:
+            logging.debug(traceback.format_exc())
+
+class ReliableClient(ReliableTransport):
+    pass
+
+class ReliableServer(ReliableTransport):
+    pass
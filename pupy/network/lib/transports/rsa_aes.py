@@ -12,10 +12,12 @@ try:
     from Crypto import Random
     from Crypto.Hash import SHA256, HMAC
 except ImportError as e:
-    logging.warning("pycrypto not available, using pure python libraries (slower)")
     AES=None
     Random=None
-    import cryptoutils.pyaes as pyaes
+    import cryptoutils
+    from cryptoutils import AESModeOfOperationCBC
+    if not cryptoutils.NATIVE:
+        logging.warning("pycrypto not available, using pure python libraries (slower)")
 
 BLOCK_SIZE=16
 
@@ -74,7 +76,7 @@ class RSA_AESTransport(BasePupyTransport):
                 if AES is not None:
                     self.dec_cipher = AES.new(self.aes_key, AES.MODE_CBC, self._iv_dec)
                 else:
-                    self.dec_cipher = pyaes.AESModeOfOperationCBC(self.aes_key, iv = self._iv_dec)
+                    self.dec_cipher = AESModeOfOperationCBC(self.aes_key, iv = self._iv_dec)
                 data.drain(BLOCK_SIZE)
                 enc=enc[BLOCK_SIZE:]
                 if not enc:
@@ -135,7 +137,7 @@ class RSA_AESClient(RSA_AESTransport):
         if AES is not None:
             self.enc_cipher = AES.new(self.aes_key, AES.MODE_CBC, self._iv_enc)
         else:
-            self.enc_cipher = pyaes.AESModeOfOperationCBC(self.aes_key, iv = self._iv_enc)
+            self.enc_cipher = AESModeOfOperationCBC(self.aes_key, iv = self._iv_enc)
         self.downstream.write(rsa.encrypt(self.aes_key, pk))
         self.downstream.write(self._iv_enc)
 
@@ -173,7 +175,7 @@ class RSA_AESServer(RSA_AESTransport):
                 if AES is not None:
                     self.enc_cipher = AES.new(self.aes_key, AES.MODE_CBC, self._iv_enc)
                 else:
-                    self.enc_cipher = pyaes.AESModeOfOperationCBC(self.aes_key, iv = self._iv_enc)
+                    self.enc_cipher = AESModeOfOperationCBC(self.aes_key, iv = self._iv_enc)
             super(RSA_AESServer, self).downstream_recv(data)
         except Exception as e:
             logging.debug(e)
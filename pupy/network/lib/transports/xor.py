@@ -7,6 +7,23 @@
 from ..base import BasePupyTransport, TransportError
 import logging
 import traceback
+import binascii
+
+try:
+    from _pupyxor import xor
+except ImportError:
+    def xor(data, key, offset=0):
+        """ apply the repeating key to data starting at key[offset], return
+        the result and the key offset for the next call. XOR big integers
+        instead of characters, the builtin does the same natively """
+        size = len(data)
+        if not size:
+            return data, offset
+
+        keylen = len(key)
+        keystream = (key[offset:] + key * (size // keylen + 1))[:size]
+        xored = int(binascii.hexlify(data), 16) ^ int(binascii.hexlify(keystream), 16)
+        return binascii.unhexlify('%0*x' % (size * 2, xored)), (offset + size) % keylen
 
 STREAM=1
 BLOCK=2
@@ -31,14 +48,9 @@ class XORTransport(BasePupyTransport):
     def upstream_recv(self, data):
         try:
             if self.channel_type == BLOCK:
-                self.downstream.write(''.join((chr(ord(x)^ord(y)) for x,y in zip(self.xorkey,data.read()))))
+                self.downstream.write(xor(data.read()[:len(self.xorkey)], self.xorkey)[0])
             elif self.channel_type == STREAM:
-                xored_buf=b""
-                for x in data.read():
-                    xored_buf+=chr(ord(x)^ord(self.xorkey[self.xor_index_up]))
-                    self.xor_index_up+=1
-                    if self.xor_index_up >= len(self.xorkey):
-                        self.xor_index_up=0
+                xored_buf, self.xor_index_up = xor(data.read(), self.xorkey, self.xor_index_up)
                 self.downstream.write(xored_buf)
             else:
                 raise TransportError("No such channel type %s"%self.channel_type)
@@ -48,14 +60,9 @@ class XORTransport(BasePupyTransport):
     def downstream_recv(self, data):
         try:
             if self.channel_type == BLOCK:
-                self.upstream.write(''.join((chr(ord(x)^ord(y)) for x,y in zip(self.xorkey,data.read()))))
+                self.upstream.write(xor(data.read()[:len(self.xorkey)], self.xorkey)[0])
             elif self.channel_type == STREAM:
-                xored_buf=b""
-                for x in data.read():
-                    xored_buf+=chr(ord(x)^ord(self.xorkey[self.xor_index_down]))
-                    self.xor_index_down+=1
-                    if self.xor_index_down >= len(self.xorkey):
-                        self.xor_index_down=0
+                xored_buf, self.xor_index_down = xor(data.read(), self.xorkey, self.xor_index_down)
                 self.upstream.write(xored_buf)
             else:
                 raise TransportError("No such channel type %s"%self.channel_type)
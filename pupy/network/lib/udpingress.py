@@ -0,0 +1,212 @@
+# -*- coding: utf-8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" batched datagram reception for PupyUDPServer. On linux recvmmsg is called through
+ctypes and drains up to <batch> datagrams per syscall, elsewhere recvfrom is called
+until the socket would block. Several sockets can share the port with SO_REUSEPORT,
+the kernel then always hands the datagrams of a peer to the same socket """
+
+__all__ = [ 'BatchReceiver', 'bind_shards', 'NATIVE' ]
+
+import sys
+import socket
+import struct
+import errno
+import ctypes
+import ctypes.util
+
+# windows has no MSG_DONTWAIT, the fallback then returns a datagram per call
+MSG_DONTWAIT = getattr(socket, 'MSG_DONTWAIT', None if sys.platform == 'win32' else 0x40)
+MSG_WAITFORONE = 0x10000
+SO_REUSEPORT = getattr(socket, 'SO_REUSEPORT', 15 if sys.platform.startswith('linux') else None)
+SOCKADDR_SIZE = 128 # sockaddr_storage
+
+# asked for each socket, bursts of many peers overflow the default one
+RECEIVE_BUFFER = 4 * 1024 * 1024
+
+# how long a receive thread blocks before it checks the server is still active
+RECEIVE_TIMEOUT = 1
+
+# nothing received before the timeout: EAGAIN, or WSAETIMEDOUT on windows
+RETRY_ERRORS = (errno.EAGAIN, errno.EWOULDBLOCK, errno.EINTR, errno.ETIMEDOUT,
+    getattr(errno, 'WSAETIMEDOUT', 10060))
+
+class iovec(ctypes.Structure):
+    _fields_ = [
+        ('iov_base', ctypes.c_void_p),
+        ('iov_len', ctypes.c_size_t),
+    ]
+
+class msghdr(ctypes.Structure):
+    _fields_ = [
+        ('msg_name', ctypes.c_void_p),
+        ('msg_namelen', ctypes.c_uint32),
+        ('msg_iov', ctypes.POINTER(iovec)),
+        ('msg_iovlen', ctypes.c_size_t),
+        ('msg_control', ctypes.c_void_p),
+        ('msg_controllen', ctypes.c_size_t),
+        ('msg_flags', ctypes.c_int),
+    ]
+
+class mmsghdr(ctypes.Structure):
+    _fields_ = [
+        ('msg_hdr', msghdr),
+        ('msg_len', ctypes.c_uint),
+    ]
+
+_recvmmsg = None
+if sys.platform.startswith('linux'):
+    try:
+        _libc = ctypes.CDLL(ctypes.util.find_library('c') or 'libc.so.6', use_errno=True)
+        _recvmmsg = _libc.recvmmsg
+        _recvmmsg.argtypes = [ ctypes.c_int, ctypes.POINTER(mmsghdr), ctypes.c_uint, ctypes.c_int, ctypes.c_void_p ]
+        _recvmmsg.restype = ctypes.c_int
+    except (OSError, AttributeError):
+        _recvmmsg = None
+
+NATIVE = _recvmmsg is not None
+
+MMSGHDR_SIZE = ctypes.sizeof(mmsghdr)
+NAMELEN_OFFSET = mmsghdr.msg_hdr.offset + msghdr.msg_namelen.offset
+LEN_OFFSET = mmsghdr.msg_len.offset
+_headers_structs = {}
+
+def _headers_struct(count):
+    """ (msg_namelen, msg_len) of count mmsghdr in one unpack """
+    headers = _headers_structs.get(count)
+    if headers is None:
+        one = '{}xI{}xI{}x'.format(NAMELEN_OFFSET, LEN_OFFSET - NAMELEN_OFFSET - 4, MMSGHDR_SIZE - LEN_OFFSET - 4)
+        headers = _headers_structs[count] = struct.Struct('=' + one * count)
+    return headers
+
+def _sockaddr(raw):
+    """ the address tuple recvfrom would have returned """
+    family, = struct.unpack('=H', raw[:2])
+    port, = struct.unpack('!H', raw[2:4])
+    if family == socket.AF_INET:
+        return socket.inet_ntop(socket.AF_INET, raw[4:8]), port
+    elif family == socket.AF_INET6:
+        flowinfo, = struct.unpack('!I', raw[4:8])
+        scope_id, = struct.unpack('=I', raw[24:28])
+        return socket.inet_ntop(socket.AF_INET6, raw[8:24]), port, flowinfo, scope_id
+    raise ValueError('unsupported address family {}'.format(family))
+
+def _set_receive_timeout(sock, timeout):
+    # at the OS level: sock.settimeout would make the socket non blocking for recvmmsg
+    if sys.platform == 'win32':
+        # a DWORD of milliseconds instead of a timeval
+        value = struct.pack('<I', int(timeout * 1000))
+    else:
+        seconds = int(timeout)
+        value = struct.pack('@ll', seconds, int((timeout - seconds) * 1000000))
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVTIMEO, value)
+
+class BatchReceiver(object):
+    """ receive() blocks until datagrams are there and returns up to batch (data, address) """
+
+    def __init__(self, sock, batch=64, size=40960):
+        self.sock = sock
+        self.batch = batch
+        self.size = size
+        _set_receive_timeout(sock, RECEIVE_TIMEOUT)
+
+        if NATIVE:
+            self.buffers = ctypes.create_string_buffer(batch * size)
+            self.data = buffer(self.buffers)
+            self.names = ctypes.create_string_buffer(batch * SOCKADDR_SIZE)
+            self.iovecs = (iovec * batch)()
+            self.messages = (mmsghdr * batch)()
+            base = ctypes.addressof(self.buffers)
+            names = ctypes.addressof(self.names)
+            for i in xrange(batch):
+                self.iovecs[i].iov_base = base + i * size
+                self.iovecs[i].iov_len = size
+                hdr = self.messages[i].msg_hdr
+                hdr.msg_name = names + i * SOCKADDR_SIZE
+                hdr.msg_namelen = SOCKADDR_SIZE
+                hdr.msg_iov = ctypes.pointer(self.iovecs[i])
+                hdr.msg_iovlen = 1
+            # the kernel overwrites msg_namelen, the headers are restored from this copy
+            self.template = ctypes.string_at(ctypes.addressof(self.messages), ctypes.sizeof(self.messages))
+            # raw sockaddr -> address tuple, peers send many datagrams
+            self.addresses = {}
+            self.receive = self._receive_native
+        else:
+            self.receive = self._receive_fallback
+
+    def _receive_native(self):
+        messages = ctypes.addressof(self.messages)
+        # releases the GIL while blocked
+        count = _recvmmsg(self.sock.fileno(), self.messages, self.batch, MSG_WAITFORONE, None)
+        if count < 0:
+            code = ctypes.get_errno()
+            if code in RETRY_ERRORS:
+                return []
+            raise socket.error(code, errno.errorcode.get(code, 'recvmmsg failed'))
+
+        # a few bulk copies instead of ctypes attribute accesses per datagram
+        headers = ctypes.string_at(messages, count * MMSGHDR_SIZE)
+        names = ctypes.string_at(ctypes.addressof(self.names), count * SOCKADDR_SIZE)
+        ctypes.memmove(messages, self.template, count * MMSGHDR_SIZE)
+
+        fields = _headers_struct(count).unpack(headers)
+        addresses = self.addresses
+        data = self.data
+        size = self.size
+        datagrams = []
+        for i in xrange(count):
+            name = names[i * SOCKADDR_SIZE:i * SOCKADDR_SIZE + fields[2 * i]]
+            address = addresses.get(name)
+            if address is None:
+                if len(addresses) > 65536:
+                    addresses.clear()
+                address = addresses[name] = _sockaddr(name)
+            datagrams.append((data[i * size:i * size + fields[2 * i + 1]], address))
+        return datagrams
+
+    def _receive_fallback(self):
+        datagrams = []
+        flags = 0
+        while len(datagrams) < self.batch:
+            try:
+                datagrams.append(self.sock.recvfrom(self.size, flags))
+            except socket.error as e:
+                if e.args[0] in RETRY_ERRORS:
+                    break
+                raise
+            if MSG_DONTWAIT is None:
+                break
+            # then drain what is already queued without blocking
+            flags = MSG_DONTWAIT
+        return datagrams
+
+def bind_shards(hostname, port, shards=1):
+    """ sockets bound to the same address, more than one only with SO_REUSEPORT """
+    if shards > 1 and SO_REUSEPORT is None:
+        shards = 1
+
+    last_exc = None
+    for af, socktype, proto, canonname, sa in socket.getaddrinfo(
+            hostname, port, socket.AF_UNSPEC, socket.SOCK_DGRAM, 0, socket.AI_PASSIVE):
+        sockets = []
+        try:
+            for i in xrange(shards):
+                s = socket.socket(af, socktype, proto)
+                sockets.append(s)
+                s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+                try:
+                    s.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, RECEIVE_BUFFER)
+                except socket.error:
+                    pass
+                if shards > 1:
+                    s.setsockopt(socket.SOL_SOCKET, SO_REUSEPORT, 1)
+                s.bind(sa)
+                # an ephemeral port is shared by the next shards
+                sa = s.getsockname()
+            return sockets
+        except socket.error as e:
+            last_exc = e
+            for s in sockets:
+                s.close()
+
+    raise last_exc
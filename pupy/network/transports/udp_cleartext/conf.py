@@ -10,6 +10,7 @@ class TransportConf(Transport):
     server=PupyUDPServer
     client=PupyUDPClient
     stream=PupyUDPSocketStream
-    client_transport=DummyPupyTransport
-    server_transport=DummyPupyTransport
+    # datagrams may be lost or reordered, rpyc needs a stream
+    client_transport=ReliableTransport
+    server_transport=ReliableTransport
 
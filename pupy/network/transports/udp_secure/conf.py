@@ -24,11 +24,22 @@ class TransportConf(Transport):
 
         #reversing the RSA client/server for BIND payloads so the private key doesn't go on the target
         if self.launcher_type == LAUNCHER_TYPE_BIND: 
-            self.client_transport = RSA_AESServer.custom(privkey_path="crypto/rsa_private_key.pem", rsa_key_size=4096, aes_size=256)
-                
-            self.server_transport = RSA_AESClient.custom(pubkey=rsa_pub_key, rsa_key_size=4096, aes_size=256)
+            self.client_transport = chain_transports(
+                    ReliableTransport,
+                    RSA_AESServer.custom(privkey_path="crypto/rsa_private_key.pem", rsa_key_size=4096, aes_size=256),
+                )
+            self.server_transport = chain_transports(
+                    ReliableTransport,
+                    RSA_AESClient.custom(pubkey=rsa_pub_key, rsa_key_size=4096, aes_size=256),
+                )
 
         else:
-            self.client_transport = RSA_AESClient.custom(pubkey=rsa_pub_key, rsa_key_size=4096, aes_size=256)
-            self.server_transport = RSA_AESServer.custom(privkey_path="crypto/rsa_private_key.pem", rsa_key_size=4096, aes_size=256)
-
+            # the RSA/AES stream needs every byte in order, the reliable layer is under it
+            self.client_transport = chain_transports(
+                    ReliableTransport,
+                    RSA_AESClient.custom(pubkey=rsa_pub_key, rsa_key_size=4096, aes_size=256),
+                )
+            self.server_transport = chain_transports(
+                    ReliableTransport,
+                    RSA_AESServer.custom(privkey_path="crypto/rsa_private_key.pem", rsa_key_size=4096, aes_size=256),
+                )
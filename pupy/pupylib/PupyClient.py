@@ -17,23 +17,31 @@ import sys, os, os.path
 import textwrap
 import logging
 import cPickle
+import marshal
+import itertools
+import rpyc
 from .PupyErrors import PupyModuleError
 import traceback
 import textwrap
 from .PupyPackagesDependencies import packages_dependencies, LOAD_PACKAGE, LOAD_DLL, EXEC, ALL_OS, WINDOWS, LINUX, ANDROID
 from .PupyJob import PupyJob
+from .PupyPackagesCache import packages_cache
+from .utils.rpyc_utils import obtain
 
 ROOT=os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
 
 class PupyClient(object):
-    def __init__(self, desc, pupsrv):
+    def __init__(self, desc, pupsrv, has_pupyimporter=None):
         self.desc=desc
         self.powershell={'x64': {'object': None, 'scripts_loaded': []}, 'x86': {'object': None, 'scripts_loaded': []}}
         #alias
         self.conn=self.desc["conn"]
         self.pupsrv=pupsrv
-        self.load_pupyimporter()
+        self.load_pupyimporter(has_pupyimporter)
         self.imported_dlls={}
+        self.startup_profile=None
+        self.content_addressed=None
+        self.pushes=itertools.count()
 
         #to reuse impersonated handle in other modules
         self.impersonated_dupHandle=None
@@ -152,9 +160,22 @@ class PupyClient(object):
 
         return set(path)
 
-    def load_pupyimporter(self):
-        """ load pupyimporter in case it is not """
-        if "pupyimporter" not in self.conn.modules.sys.modules:
+    def get_startup_profile(self):
+        """ startup phases recorded by the native loader, as dicts with name, started and duration
+        (seconds, -1 while still running). Fetched once per session, empty for clients without it """
+        if self.startup_profile is None:
+            try:
+                self.startup_profile=obtain(self.conn.modules.pupy.get_startup_profile())
+            except (AttributeError, ImportError):
+                self.startup_profile=[]
+        return self.startup_profile
+
+    def load_pupyimporter(self, loaded=None):
+        """ load pupyimporter in case it is not. loaded: whether the client has it, when
+        that is known already (None asks the client) """
+        if loaded is None:
+            loaded="pupyimporter" in self.conn.modules.sys.modules
+        if not loaded:
             pupyimporter_code=""
             with open(os.path.join(ROOT, "packages","all","pupyimporter.py"),'rb') as f:
                 pupyimporter_code=f.read()
@@ -215,21 +236,18 @@ class PupyClient(object):
                         raise PupyModuleError("Unknown package loading method %s"%t)
         return self._load_package(module_name, force)
 
-    def _get_module_dic(self, search_path, start_path, pure_python_only=False):
-        modules_dic={}
+    def _get_module_files(self, search_path, start_path, pure_python_only=False):
+        """ {path in the package dictionary: file to read, None for an empty __init__.py} """
+        modules_files={}
         if os.path.isdir(os.path.join(search_path,start_path)): # loading a real package with multiple files
             for root, dirs, files in os.walk(os.path.join(search_path,start_path), followlinks=True):
                 for f in files:
                     if pure_python_only:
                         if f.endswith((".so",".pyd",".dll")): #avoid loosing shells when looking for packages in sys.path and unfortunatelly pushing a .so ELF on a remote windows
                             continue
-                    module_code=""
-                    with open(os.path.join(root,f),'rb') as fd:
-                        module_code=fd.read()
                     modprefix = root[len(search_path.rstrip(os.sep))+1:]
                     modpath = os.path.join(modprefix,f).replace("\\","/")
-                    modules_dic[modpath]=module_code
-                package_found=True
+                    modules_files[modpath]=os.path.join(root,f)
         else: # loading a simple file
             extlist=[ ".py", ".pyc", ".pyo" ]
             if not pure_python_only:
@@ -237,19 +255,46 @@ class PupyClient(object):
             for ext in extlist:
                 filepath=os.path.join(search_path,start_path+ext)
                 if os.path.isfile(filepath):
-                    module_code=""
-                    with open(filepath,'rb') as f:
-                        module_code=f.read()
                     cur=""
                     for rep in start_path.split("/")[:-1]:
-                        if not cur+rep+"/__init__.py" in modules_dic:
-                            modules_dic[rep+"/__init__.py"]=""
+                        if not cur+rep+"/__init__.py" in modules_files:
+                            modules_files[rep+"/__init__.py"]=None
                         cur+=rep+"/"
 
-                    modules_dic[start_path+ext]=module_code
-                    package_found=True
+                    modules_files[start_path+ext]=filepath
                     break
-        return modules_dic
+        return modules_files
+
+    def _get_package(self, search_path, start_path, pure_python_only=False):
+        """ cached version of the package, None if it isn't there """
+        files=self._get_module_files(search_path, start_path, pure_python_only)
+        if not files:
+            return None
+        return packages_cache.get((search_path, start_path, pure_python_only), files)
+
+    def _push_package(self, package):
+        """ send the blobs the client doesn't hold yet, then install the package.
+        Clients with an older pupyimporter get the whole pickled dictionary """
+        importer=self.conn.modules.pupyimporter
+        if self.content_addressed is None:
+            self.content_addressed=hasattr(importer, "pupy_missing_blobs")
+
+        if not self.content_addressed:
+            importer.pupy_add_package(cPickle.dumps(package.get_dic())) # we have to pickle the dic for two reasons : because the remote side is not aut0horized to iterate/access to the dictionary declared on this side and because it is more efficient
+            return package.size
+
+        manifest=marshal.dumps(package.manifest)
+        missing=marshal.loads(importer.pupy_missing_blobs(manifest))
+        push=next(self.pushes)
+        sent=0
+        if missing:
+            add_blobs=rpyc.async(importer.pupy_add_blobs)
+            for chunk in package.chunks(missing):
+                add_blobs(chunk, push)
+                sent+=len(chunk)
+        # requests are served in order, the blobs are there once this returns
+        importer.pupy_commit_package(manifest, push)
+        return sent
 
     def _load_package(self, module_name, force=False):
         """
@@ -259,21 +304,21 @@ class PupyClient(object):
         """
         # start path should only use "/" as separator
         start_path=module_name.replace(".", "/")
-        package_found=False
+        package=None
         package_path=None
         for search_path in self.get_packages_path():
             try:
-                modules_dic=self._get_module_dic(search_path, start_path)
-                if modules_dic:
+                package=self._get_package(search_path, start_path)
+                if package:
                     package_path=search_path
                     break
             except Exception as e:
                 raise PupyModuleError("Error while loading package %s : %s"%(module_name, traceback.format_exc()))
-        if not modules_dic: # in last resort, attempt to load the package from the server's sys.path if it exists
+        if not package: # in last resort, attempt to load the package from the server's sys.path if it exists
             for search_path in sys.path:
                 try:
-                    modules_dic=self._get_module_dic(search_path, start_path, pure_python_only=True)
-                    if modules_dic:
+                    package=self._get_package(search_path, start_path, pure_python_only=True)
+                    if package:
                         logging.info("package %s not found in packages/, but found in local sys.path, attempting to push it remotely..."%module_name)
                         package_path=search_path
                         break
@@ -281,11 +326,11 @@ class PupyClient(object):
                     raise PupyModuleError("Error while loading package from sys.path %s : %s"%(module_name, traceback.format_exc()))
         if "pupyimporter" not in self.conn.modules.sys.modules:
             raise PupyModuleError("pupyimporter module does not exists on the remote side !")
-        if not modules_dic:
+        if not package:
             raise PupyModuleError("Couldn't load package %s : no such file or directory neither in \(path=%s) or sys.path"%(module_name,repr(self.get_packages_path())))
         if force or ( module_name not in self.conn.modules.sys.modules ):
-            self.conn.modules.pupyimporter.pupy_add_package(cPickle.dumps(modules_dic)) # we have to pickle the dic for two reasons : because the remote side is not aut0horized to iterate/access to the dictionary declared on this side and because it is more efficient
-            logging.debug("package %s loaded on %s from path=%s"%(module_name, self.short_name(), package_path))
+            sent=self._push_package(package)
+            logging.debug("package %s loaded on %s from path=%s (%d/%d bytes sent)"%(module_name, self.short_name(), package_path, sent, package.size))
             if force and  module_name in self.conn.modules.sys.modules:
                 self.conn.modules.sys.modules.pop(module_name)
                 logging.debug("package removed from sys.modules to force reloading")
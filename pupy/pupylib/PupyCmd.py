@@ -519,6 +519,7 @@ class PupyCmd(cmd.Cmd):
             elif modargs.print_output:
                 j=self.pupsrv.get_job(modargs.print_output)
                 self.display(j.result_summary())
+                self.display(j.latency_summary())
             elif modargs.list:
                 if len(self.pupsrv.jobs)>0:
                     dictable=[]
@@ -576,6 +577,7 @@ class PupyCmd(cmd.Cmd):
         arg_parser.add_argument('module', metavar='<module>', help="module")
         arg_parser.add_argument('-f', '--filter', metavar='<client filter>', default=self.default_filter ,help="filter to a subset of all clients. All fields available in the \"info\" module can be used. example: run get_info -f 'platform:win release:7 os_arch:64'")
         arg_parser.add_argument('--bg', action='store_true', help="run in background")
+        arg_parser.add_argument('-t', '--timeout', type=float, metavar='<seconds>', help="give up on the clients that take longer than this")
         arg_parser.add_argument('arguments', nargs=argparse.REMAINDER, metavar='<arguments>', help="module arguments")
         pj=None
         try:
@@ -620,12 +622,13 @@ class PupyCmd(cmd.Cmd):
 
         modjobs=[x for x in self.pupsrv.jobs.itervalues() if x.pupymodules[0].get_name() == mod.get_name() and x.pupymodules[0].client in l]
         pj=None
+        streamed=False
         try:
             interactive=False
             if mod.daemon and mod.unique_instance and modjobs:
                 pj=modjobs[0]
             else:
-                pj=PupyJob(self.pupsrv,"%s %s"%(modargs.module, args))
+                pj=PupyJob(self.pupsrv,"%s %s"%(modargs.module, args), timeout=modargs.timeout)
                 if len(l)==1 and not modargs.bg and not mod.daemon:
                     ps=mod(l[0], pj, stdout=self.stdout)
                     pj.add_module(ps)
@@ -646,6 +649,15 @@ class PupyCmd(cmd.Cmd):
                 elif mod.daemon:
                     self.pupsrv.add_job(pj)
                     self.display_info("job %s started in background !"%pj)
+                elif not interactive:
+                    # results are shown as clients finish
+                    for task in pj.iter_results():
+                        self.display(pj.module_result(task.module))
+                        if task.status=="timeout":
+                            self.display_warning("%s: timed out"%task.module.client)
+                    streamed=True
+                    if len(l)>1:
+                        self.display(pj.latency_summary())
                 else:
                     error=pj.interactive_wait()
                     if error and not modjobs:
@@ -661,7 +673,7 @@ class PupyCmd(cmd.Cmd):
             self.display_warning("interrupting job ... (please wait)")
             pj.interrupt()
             self.display_warning("job interrupted")
-        if not interactive:
+        if not interactive and not streamed:
             self.display(pj.result_summary())
         if pj:
             del pj
@@ -16,96 +16,145 @@
 
 import time
 import threading
-import inspect
-import ctypes
 import logging
+from Queue import Queue, Empty
+from thread import get_ident
 from .PupyErrors import PupyModuleError, PupyModuleExit
 import rpyc
 
-#original code for interruptable threads from http://tomerfiliba.com/recipes/Thread2/
-def _async_raise(tid, exctype):
-    """raises the exception, performs cleanup if needed"""
-    if not inspect.isclass(exctype):
-        raise TypeError("Only types can be raised (not instances)")
-    res = ctypes.pythonapi.PyThreadState_SetAsyncExc(ctypes.c_long(tid), ctypes.py_object(exctype))
-    if res == 0:
-        raise ValueError("invalid thread id")
-    elif res != 1:
-        # """if it returns a number greater than one, you're in trouble,
-        # and you should call it again with exc=NULL to revert the effect"""
-        ctypes.pythonapi.PyThreadState_SetAsyncExc(ctypes.c_long(tid), None)
-        raise SystemError("PyThreadState_SetAsyncExc failed")
-
-class Thread(threading.Thread):
-    def _get_my_tid(self):
-        """determines this (self's) thread id"""
-        if not self.isAlive():
-            raise threading.ThreadError("the thread is not active")
-
-        # do we have it cached?
-        if hasattr(self, "_thread_id"):
-            return self._thread_id
-
-        # no, look for it in the _active dict
-        for tid, tobj in threading._active.items():
-            if tobj is self:
-                self._thread_id = tid
-                return tid
-
-        raise AssertionError("could not determine the thread's id")
-
-    def raise_exc(self, exctype):
-        """raises the given exception type in the context of this thread"""
-        _async_raise(self._get_my_tid(), exctype)
+# upper bounds of the latency histogram buckets, in seconds
+LATENCY_BUCKETS=(0.1, 0.5, 1, 5, 10, 30, 60, 300)
 
-    def stop(self):
-        """raises SystemExit in the context of the given thread, which should
-        cause the thread to exit silently (unless caught)"""
-        self.raise_exc(KeyboardInterrupt)
+class JobTask(object):
+    """ one module of a job, run on its client by a JobPool worker """
+    def __init__(self, job, module, args, timeout=None):
+        self.job=job
+        self.module=module
+        self.args=args
+        self.timeout=timeout
+        self.status="queued" # running, then finished, error, cancelled or timeout
+        self.thread=None
+        self.started=None
+        self.finished=None
+        self.lock=threading.Lock()
+
+    @property
+    def latency(self):
+        if self.started is None or self.finished is None:
+            return None
+        return self.finished-self.started
+
+    @property
+    def deadline(self):
+        if self.timeout and self.started:
+            return self.started+self.timeout
+
+    def run(self):
+        with self.lock:
+            if self.status!="queued":
+                return
+            self.status="running"
+            self.thread=get_ident()
+            self.started=time.time()
+
+        status=self.job.module_worker(self.module, self.args)
+
+        with self.lock:
+            self.thread=None
+            if self.status!="running":
+                # cancelled, the job already moved on
+                return
+            self.status=status
+            self.finished=time.time()
+        self.job.task_done(self)
+
+    def cancel(self, status="cancelled"):
+        """ no exception is raised in the worker: the module is asked to interrupt
+        itself and the sync requests of the worker are given up. The job doesn't wait
+        for the module to return """
+        with self.lock:
+            if self.status=="queued":
+                self.started=time.time()
+            elif self.status!="running":
+                return
+            self.status=status
+            self.finished=time.time()
+            thread=self.thread
+
+        self.job.task_done(self)
+        if thread is None:
+            return
+
+        if hasattr(self.module, "interrupt"):
+            try:
+                self.module.interrupt()
+            except Exception as e:
+                logging.debug("%s: interrupt failed: %s"%(self.module, e))
+
+        conn=getattr(getattr(self.module.client, "conn", None), "_conn", None)
+        if conn is not None and hasattr(conn, "cancel_requests"):
+            conn.cancel_requests(thread)
 
-class ThreadPool(object):
-    def __init__(self):
-        self.thread_pool=[]
+class JobPool(object):
+    """ bounded set of threads running the modules of every job. Modules which hold the
+    terminal (max_clients=1) get a thread of their own, a fan-out can't starve them """
+    def __init__(self, workers=32):
+        self.queue=Queue()
+        self.running=set()
+        self.lock=threading.Lock()
+        for i in xrange(workers):
+            self._spawn(self._work, "PupyJobWorker-%d"%i)
+        self._spawn(self._watchdog, "PupyJobWatchdog")
 
-    def apply_async(self, func, args):
-        t=Thread(target=func, args=args)
+    def _spawn(self, target, name, args=()):
+        t=threading.Thread(target=target, name=name, args=args)
         t.daemon=True
-        self.thread_pool.append(t)
         t.start()
 
-    def interrupt_all(self):
-        for t in self.thread_pool:
-            if t.isAlive():
-                t.stop()
+    def submit(self, task):
+        if task.module.max_clients==1:
+            self._spawn(self._execute, "PupyJob-%s"%task.job, (task,))
+        else:
+            self.queue.put(task)
 
-    def join(self):
+    def _work(self):
         while True:
-            try:
-                allok=True
-                for t in self.thread_pool:
-                    if t.isAlive():
-                        t.join(0.5)
-                        allok=False
-                if allok:
-                    break
-            except KeyboardInterrupt:
-                print "Press [ENTER] to interrupt the job"
-                pass
+            self._execute(self.queue.get())
+
+    def _execute(self, task):
+        with self.lock:
+            self.running.add(task)
+        try:
+            task.run()
+        except Exception as e:
+            logging.exception(e)
+        finally:
+            with self.lock:
+                self.running.discard(task)
 
-    def all_finished(self):
-        for t in self.thread_pool:
-            if t.isAlive():
-                return False
-        return True
+    def _watchdog(self):
+        while True:
+            time.sleep(0.5)
+            now=time.time()
+            with self.lock:
+                expired=[x for x in self.running if x.deadline and x.deadline < now]
+            for task in expired:
+                task.cancel("timeout")
 
 class PupyJob(object):
     """ a job handle a group of modules """
 
-    def __init__(self, pupsrv, name):
+    def __init__(self, pupsrv, name, timeout=None):
         self.name=name
         self.pupsrv=pupsrv
         self.pupymodules=[]
-        self.worker_pool=ThreadPool()
+        self.timeout=timeout # per client, in seconds
+        self.tasks=[]
+        self.results=Queue() # tasks, as they finish
+        self.pending=0
+        self.lock=threading.Lock()
+        self.finished=threading.Event()
+        self.finished.set()
         self.started=threading.Event()
         self.error_happened=threading.Event()
         self.jid=None
@@ -120,23 +169,28 @@ class PupyJob(object):
         self.interrupt()
 
     def module_worker(self, module, args):
+        """ runs in a JobPool worker, returns the status of the task """
         try:
             module.import_dependencies()
             module.run(args)
         except PupyModuleExit as e:
-            return
+            pass
         except PupyModuleError as e:
             self.error_happened.set()
             module.error(str(e))
+            return "error"
         except KeyboardInterrupt:
             pass
         except Exception as e:
             self.error_happened.set()
             module.error(str(e))
+            return "error"
+        return "finished"
 
     def start(self, args):
         #if self.started.is_set():
         #    raise RuntimeError("job %s has already been started !"%str(self))
+        tasks=[]
         for m in self.pupymodules:
             try:
                 margs=m.arg_parser.parse_args(args)
@@ -155,32 +209,58 @@ class PupyJob(object):
             if not comp:
                 m.error("Compatibility error : %s"%comp_exp)
                 continue
-            self.worker_pool.apply_async(self.module_worker, (m, margs))
+            tasks.append(JobTask(self, m, margs, self.timeout))
+
+        with self.lock:
+            self.tasks.extend(tasks)
+            self.pending+=len(tasks)
+            if self.pending:
+                self.finished.clear()
+
+        for task in tasks:
+            self.pupsrv.job_pool.submit(task)
         self.started.set()
 
+    def task_done(self, task):
+        self.results.put(task)
+        with self.lock:
+            self.pending-=1
+            if not self.pending:
+                self.finished.set()
+
+    def iter_results(self):
+        """ tasks as they finish, until all of them did """
+        while True:
+            try:
+                yield self.results.get(timeout=0.5)
+            except Empty:
+                if self.finished.is_set() and self.results.empty():
+                    return
+
     def interrupt(self):
-        if not self.started:
+        if not self.started.is_set():
             raise RuntimeError("can't interrupt. job %s has not been started"%str(self))
 
-        #calling the interrupt method is one is defined for the module instead of killing the thread
-        if hasattr(self.pupymodules[0],'interrupt'):
-            for m in self.pupymodules:
-                m.interrupt()
-        else:
-            self.worker_pool.interrupt_all()
-            self.wait()
+        for task in self.tasks:
+            task.cancel()
+        self.wait()
 
     def interactive_wait(self):
-        while True:
-            if self.is_finished():
-                break
-            time.sleep(0.1)
+        # with a timeout, so ^C still gets through
+        while not self.finished.wait(0.5):
+            pass
         if self.error_happened.is_set():
             return True
         return False
 
     def wait(self):
-        self.worker_pool.join()
+        while True:
+            try:
+                if self.finished.wait(0.5):
+                    break
+            except KeyboardInterrupt:
+                print "Press [ENTER] to interrupt the job"
+
         for m in self.pupymodules:
             while True:
                 if not m.client:
@@ -201,7 +281,48 @@ class PupyJob(object):
                     break
 
     def is_finished(self):
-        return self.worker_pool.all_finished()
+        return self.finished.is_set()
+
+    def latency_histogram(self):
+        """ [(bucket upper bound or None, number of clients), ...] of the finished tasks """
+        counts=[0]*(len(LATENCY_BUCKETS)+1)
+        for task in self.tasks:
+            latency=task.latency
+            if latency is None or task.status=="cancelled":
+                continue
+            for i, bound in enumerate(LATENCY_BUCKETS):
+                if latency < bound:
+                    counts[i]+=1
+                    break
+            else:
+                counts[-1]+=1
+        return zip(LATENCY_BUCKETS+(None,), counts)
+
+    def latency_summary(self):
+        latencies=sorted(x.latency for x in self.tasks if x.latency is not None and x.status!="cancelled")
+        if not latencies:
+            return ""
+        statuses={}
+        for task in self.tasks:
+            statuses[task.status]=statuses.get(task.status, 0)+1
+
+        res="%d client(s): %s\n"%(len(self.tasks), ", ".join("%s %d"%x for x in sorted(statuses.iteritems())))
+        res+="latency p50 %.2fs, p90 %.2fs, max %.2fs\n"%(
+            latencies[len(latencies)//2], latencies[int(len(latencies)*0.9)], latencies[-1])
+        widest=max(x for _, x in self.latency_histogram()) or 1
+        for bound, count in self.latency_histogram():
+            label="< %ss"%bound if bound is not None else ">= %ss"%LATENCY_BUCKETS[-1]
+            res+="%8s %5d %s\n"%(label, count, "#"*int(round(40.0*count/widest)))
+        return res
+
+    def module_result(self, m):
+        """ what a module wrote since the last call, under its client's title """
+        res=m.formatter.format_section(str(m.client))
+        gv=m.stdout.getvalue()
+        res+=gv.encode('utf8', errors="replace")
+        res+="\n"
+        m.stdout.truncate(0)
+        return res
 
     def raw_result(self):
         if len(self.pupymodules)>1:
@@ -214,11 +335,7 @@ class PupyJob(object):
     def result_summary(self):
         res=""
         for m in self.pupymodules:
-            res+=m.formatter.format_section(str(m.client))
-            gv=m.stdout.getvalue()
-            res+=gv.encode('utf8', errors="replace")
-            res+="\n"
-            m.stdout.truncate(0)
+            res+=self.module_result(m)
         return res
 
     def __del__(self):
@@ -0,0 +1,81 @@
+#!/usr/bin/env python
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" content addressed packages for load_package. Every file of a package version is
+hashed once, clients are asked which blobs they miss and only those are sent, in
+chunks (see pupyimporter.pupy_missing_blobs) """
+
+import os
+import hashlib
+import marshal
+import threading
+
+# upper bound of a pupy_add_blobs call, blobs bigger than this are split
+CHUNK_SIZE=256*1024
+
+class PupyPackageVersion(object):
+    def __init__(self, signature, files):
+        self.signature=signature
+        self.manifest={}
+        self.blobs={}
+        for path, filepath in files.iteritems():
+            content=b""
+            if filepath:
+                with open(filepath, 'rb') as f:
+                    content=f.read()
+            digest=hashlib.sha1(content).hexdigest()
+            self.manifest[path]=digest
+            self.blobs[digest]=content
+        self.size=sum(len(self.blobs[x]) for x in self.manifest.itervalues())
+
+    def get_dic(self):
+        """ the whole package, as pupy_add_package wants it """
+        return dict((path, self.blobs[digest]) for path, digest in self.manifest.iteritems())
+
+    def chunks(self, digests, chunk_size=CHUNK_SIZE):
+        """ marshalled lists of (digest, piece), pieces of a blob come in order """
+        chunk=[]
+        used=0
+        for digest in digests:
+            content=self.blobs[digest]
+            for offset in xrange(0, max(len(content), 1), chunk_size):
+                piece=content[offset:offset+chunk_size]
+                if chunk and used+len(piece) > chunk_size:
+                    yield marshal.dumps(chunk)
+                    chunk=[]
+                    used=0
+                chunk.append((digest, piece))
+                used+=len(piece)
+        if chunk:
+            yield marshal.dumps(chunk)
+
+class PupyPackagesCache(object):
+    """ package versions by (search path, start path, pure python only). A version is
+    identified by the names, sizes and mtimes of its files, files are only read and
+    hashed again when one of them changes """
+
+    def __init__(self):
+        self.lock=threading.Lock()
+        self.versions={}
+
+    def get(self, key, files):
+        """ files: {path in the package: file to read, None for an empty file} """
+        signature=[]
+        for path, filepath in files.iteritems():
+            if filepath:
+                st=os.stat(filepath)
+                signature.append((path, st.st_size, st.st_mtime))
+            else:
+                signature.append((path, 0, 0))
+        signature=tuple(sorted(signature))
+
+        # hashing under the lock: pushing to many clients at once reads the files only once
+        with self.lock:
+            version=self.versions.get(key)
+            if version is None or version.signature!=signature:
+                version=PupyPackageVersion(signature, files)
+                self.versions[key]=version
+        return version
+
+packages_cache=PupyPackagesCache()
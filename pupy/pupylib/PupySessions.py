@@ -0,0 +1,164 @@
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" Registry of the connected sessions. Changes are made under a lock, searches and
+listings work on a frozen snapshot without it. The snapshot is rebuilt by the first
+reader after a change, a mass reconnect doesn't copy the registry once per session.
+Lookups by id or connection read the live maps, a single dict access is atomic """
+
+import threading
+from collections import OrderedDict
+
+# fields with an index: value -> sessions. A field:value search on them only looks at
+# the distinct values, not at every session
+INDEXED=("platform", "os_arch", "proc_arch", "user", "hostname", "transport")
+
+def _searchable(value):
+    """ the lower case unicode a search compares with """
+    if isinstance(value, unicode):
+        return value.lower()
+    if not isinstance(value, str):
+        value=str(value)
+    return value.decode('utf8', 'replace').lower()
+
+def _values(client):
+    return dict((field, _searchable(value)) for field, value in client.desc.iteritems() if field != "conn")
+
+class _Snapshot(object):
+    __slots__=("clients", "indexes", "values")
+
+    def __init__(self, clients, indexes, values):
+        self.clients=clients # in registration order
+        self.indexes=indexes # field -> {searchable value: frozenset of clients}
+        self.values=values # client -> {field: searchable value}
+
+class SessionStore(object):
+    def __init__(self):
+        self.lock=threading.Lock()
+        self.current_id=1
+        self.by_conn=OrderedDict()
+        self.by_id={}
+        self.values={}
+        self.indexes=dict((field, {}) for field in INDEXED)
+        self.snapshot=None
+
+    def __len__(self):
+        return len(self.by_conn)
+
+    def __iter__(self):
+        return iter(self._snapshot().clients)
+
+    def list(self):
+        return list(self._snapshot().clients)
+
+    def _snapshot(self):
+        snapshot=self.snapshot
+        if snapshot is None:
+            with self.lock:
+                if self.snapshot is None:
+                    self.snapshot=_Snapshot(
+                        tuple(self.by_conn.itervalues()),
+                        dict((field, dict((value, frozenset(clients)) for value, clients in buckets.iteritems()))
+                            for field, buckets in self.indexes.iteritems()),
+                        dict(self.values))
+                snapshot=self.snapshot
+        return snapshot
+
+    def _index(self, client, values, add):
+        for field in INDEXED:
+            value=values.get(field)
+            if value is None:
+                continue
+            buckets=self.indexes[field]
+            if add:
+                buckets.setdefault(value, set()).add(client)
+            else:
+                buckets[value].discard(client)
+                if not buckets[value]:
+                    del buckets[value]
+
+    def next_id(self):
+        with self.lock:
+            id=self.current_id
+            self.current_id+=1
+            return id
+
+    def get(self, id):
+        return self.by_id.get(id)
+
+    def get_by_conn(self, conn):
+        return self.by_conn.get(conn)
+
+    def add(self, client):
+        values=_values(client)
+        with self.lock:
+            self.by_conn[client.conn]=client
+            self.by_id[client.desc["id"]]=client
+            self.values[client]=values
+            self._index(client, values, True)
+            self.snapshot=None
+
+    def remove(self, conn):
+        """ the session of conn, None if it wasn't registered """
+        with self.lock:
+            client=self.by_conn.pop(conn, None)
+            if client is None:
+                return None
+
+            # a migrated session may have taken the id over already
+            if self.by_id.get(client.desc["id"]) is client:
+                del self.by_id[client.desc["id"]]
+            self._index(client, self.values.pop(client), False)
+            self.snapshot=None
+            return client
+
+    def renumber(self, client, id):
+        """ give client the id of another session, which it replaces """
+        with self.lock:
+            if self.by_id.get(client.desc["id"]) is client:
+                del self.by_id[client.desc["id"]]
+            client.desc["id"]=id
+            self.by_id[id]=client
+            if client in self.values:
+                self.values[client]=_values(client)
+            self.snapshot=None
+
+    def find(self, search_criteria):
+        """ sessions matching every term of search_criteria, in registration order. A term
+        is field:value, value being part of the field, or text found in any field """
+        snapshot=self._snapshot()
+        candidates=None
+        terms=[]
+        for term in search_criteria.split():
+            field, sep, value=term.partition(":")
+            if sep and field in INDEXED:
+                value=_searchable(value)
+                matches=set()
+                for indexed, clients in snapshot.indexes[field].iteritems():
+                    if value in indexed:
+                        matches.update(clients)
+                candidates=matches if candidates is None else candidates & matches
+                if not candidates:
+                    return []
+            else:
+                terms.append((field, sep, _searchable(value), _searchable(term)))
+
+        if candidates is None:
+            if not terms:
+                return []
+            clients=snapshot.clients
+        else:
+            clients=[c for c in snapshot.clients if c in candidates]
+
+        found=[]
+        for client in clients:
+            values=snapshot.values[client]
+            for field, sep, value, term in terms:
+                if sep and field in values:
+                    if value not in values[field]:
+                        break
+                elif not any(term in v for v in values.itervalues()):
+                    break
+            else:
+                found.append(client)
+        return found
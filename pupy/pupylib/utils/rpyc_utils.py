@@ -17,6 +17,7 @@
 import sys
 from contextlib import contextmanager
 from rpyc.utils.helpers import restricted
+from rpyc.core.netref import BaseNetref
 import textwrap
 import json
 
@@ -31,6 +32,85 @@ def safe_obtain(proxy):
 def obtain(proxy):
     return safe_obtain(proxy)
 
+PLAIN_TYPES=(type(None), bool, int, long, float, complex, str, unicode)
+
+def batch_fetch(conn, target, paths=None, project=None, args=None):
+    """ plain values from the client in a single request, where netrefs would take a
+    round trip per attribute or element. See exposed_batch_fetch in pp.py, ex:
+    batch_fetch(conn, 'os', ('getuid()', 'getgid()')) """
+    try:
+        fetch=conn.batch_fetch
+    except AttributeError:
+        # clients built before batch_fetch: kept as None like the other aliases, the
+        # lookup fails once per connection
+        conn.batch_fetch=fetch=None
+
+    if fetch is None:
+        return _legacy_fetch(conn, target, paths, project, args)
+
+    return fetch(
+        target,
+        tuple(paths) if paths is not None else None,
+        project,
+        tuple(args) if args is not None else None
+    )
+
+def fetch_records(conn, target, fields, project='', args=None):
+    """ {field: value} of every object of a remote iterable, in a single request """
+    return [ dict(zip(fields, values)) for values in batch_fetch(conn, target, fields, project, args) ]
+
+def _resolve(obj, path):
+    """ _resolve of pp.py, on netrefs """
+    for name in (path.split('.') if path else ()):
+        call=name.endswith('()')
+        if call:
+            name=name[:-2]
+        if isinstance(obj, dict) and name in obj:
+            obj=obj[name]
+        else:
+            obj=getattr(obj, name)
+        if call:
+            obj=obj()
+    return obj
+
+def _plain(obj, paths=None):
+    """ _plain of pp.py, on netrefs. Values json can carry are obtained at once, the
+    others are walked with a round trip per attribute or element """
+    if isinstance(obj, BaseNetref):
+        try:
+            obj=obtain(obj)
+        except Exception:
+            pass
+    if isinstance(obj, PLAIN_TYPES):
+        return obj
+    sequence=isinstance(obj, (list, tuple, set, frozenset, xrange)) or hasattr(obj, 'next')
+    if paths is not None and not sequence:
+        values=[]
+        for path in paths:
+            try:
+                values.append(_plain(_resolve(obj, path)))
+            except Exception:
+                values.append(None)
+        return tuple(values)
+    if isinstance(obj, dict):
+        return tuple((_plain(k), _plain(v)) for k, v in obj.iteritems())
+    if sequence:
+        return tuple(_plain(x, paths) for x in obj)
+    return repr(obj)
+
+def _legacy_fetch(conn, target, paths=None, project=None, args=None):
+    """ what exposed_batch_fetch does, done from here through conn.modules """
+    if isinstance(target, basestring):
+        module, _, path=target.partition(':')
+        target=_resolve(conn.modules[module], path)
+    if args is not None:
+        target=target(*args)
+    if project is not None:
+        return _plain(_resolve(target, project), paths)
+    if paths is None:
+        return _plain(target)
+    return tuple(_plain(_resolve(target, path)) for path in paths)
+
 def hotpatch_oswrite(conn):
     """ some scripts/libraries use os.write(1, ...) instead of sys.stdout.write to write to stdout """
     conn.execute(textwrap.dedent("""
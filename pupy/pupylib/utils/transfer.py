@@ -0,0 +1,156 @@
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" server side of the pipelined transfers of pupyutils.transfer: the client pushes
+downloads to a TransferSink and pulls uploads from a TransferSource. Both are passed
+to the client as callables, the client drives the window """
+
+import os
+import stat
+import zlib
+import hashlib
+
+def _local(root, rel):
+    """ rel comes from the client, it must not leave root """
+    if not rel:
+        return root
+    path=os.path.normpath(os.path.join(root, *rel.split('/')))
+    if not path.startswith(os.path.join(os.path.normpath(root), '')):
+        raise ValueError("%s is outside of %s"%(rel, root))
+    return path
+
+def _sha1(path, digest=None, size=-1, chunk_size=1024*1024):
+    digest=digest or hashlib.sha1()
+    with open(path, 'rb') as f:
+        while size:
+            data=f.read(chunk_size if size < 0 else min(size, chunk_size))
+            if not data:
+                break
+            digest.update(data)
+            size-=len(data)
+    return digest
+
+def local_offsets(root):
+    """ ((relative path, size), ...) of what a previous download left in root """
+    if os.path.isfile(root):
+        return (('', os.path.getsize(root)),)
+
+    offsets=[]
+    for path, dirs, files in os.walk(root):
+        rel=os.path.relpath(path, root)
+        rel='' if rel == '.' else rel.replace(os.sep, '/')
+        for name in files:
+            offsets.append(('/'.join(x for x in (rel, name) if x), os.path.getsize(os.path.join(path, name))))
+    return tuple(offsets)
+
+class TransferSink(object):
+    """ writes what pupyutils.transfer.download sends, checking every file's sha1 """
+    def __init__(self, root):
+        self.root=root
+        self.f=None
+        self.path=None
+        self.digest=None
+        self.files=0
+        self.failed=[] # files whose hash doesn't match
+        self.errors=[] # (file, error) the client couldn't read
+
+    def __call__(self, event, *args):
+        getattr(self, 'on_'+event)(*args)
+
+    def on_dir(self, rel, mode):
+        path=_local(self.root, rel)
+        if not os.path.isdir(path):
+            os.makedirs(path)
+
+    def on_file(self, rel, size, mode, offset):
+        self.path=_local(self.root, rel)
+        parent=os.path.dirname(self.path)
+        if parent and not os.path.isdir(parent):
+            os.makedirs(parent)
+
+        self.digest=hashlib.sha1()
+        if offset and os.path.isfile(self.path):
+            _sha1(self.path, self.digest, offset)
+            self.f=open(self.path, 'r+b')
+            self.f.seek(offset)
+            self.f.truncate()
+        else:
+            self.f=open(self.path, 'wb')
+
+    def on_data(self, compressed, data):
+        if compressed:
+            data=zlib.decompress(data)
+        self.f.write(data)
+        self.digest.update(data)
+
+    def on_end(self, digest):
+        self.f.close()
+        self.f=None
+        self.files+=1
+        if self.digest.hexdigest() != digest:
+            self.failed.append(self.path)
+
+    def on_error(self, rel, error):
+        self.errors.append((rel or self.root, error))
+
+    def close(self):
+        if self.f:
+            self.f.close()
+            self.f=None
+
+class TransferSource(object):
+    """ serves pupyutils.transfer.upload the files of root, a file or a tree """
+    def __init__(self, root):
+        self.root=root
+        self.f=None
+        self.path=None
+
+    def __call__(self, event, *args):
+        return getattr(self, 'on_'+event)(*args)
+
+    def entries(self):
+        if not os.path.isdir(self.root):
+            yield 'file', '', self.root
+            return
+
+        for path, dirs, files in os.walk(self.root):
+            rel=os.path.relpath(path, self.root)
+            rel='' if rel == '.' else rel.replace(os.sep, '/')
+            for name in dirs:
+                yield 'dir', '/'.join(x for x in (rel, name) if x), os.path.join(path, name)
+            for name in files:
+                fullpath=os.path.join(path, name)
+                if os.path.isfile(fullpath):
+                    yield 'file', '/'.join(x for x in (rel, name) if x), fullpath
+
+    def on_list(self):
+        """ (kind, relative path, size, mode, sha1) of everything to send """
+        entries=[]
+        for kind, rel, path in self.entries():
+            st=os.stat(path)
+            if kind == 'dir':
+                entries.append((kind, rel, 0, stat.S_IMODE(st.st_mode), ''))
+            else:
+                entries.append((kind, rel, st.st_size, stat.S_IMODE(st.st_mode), _sha1(path).hexdigest()))
+        return tuple(entries)
+
+    def on_read(self, rel, offset, size, compress):
+        path=_local(self.root, rel)
+        if path != self.path:
+            self.close()
+            self.f=open(path, 'rb')
+            self.path=path
+
+        self.f.seek(offset)
+        data=self.f.read(size)
+        if compress:
+            packed=zlib.compress(data, 1)
+            if len(packed) < len(data):
+                return True, packed
+        return False, data
+
+    def close(self):
+        if self.f:
+            self.f.close()
+            self.f=None
+            self.path=None
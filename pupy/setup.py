@@ -0,0 +1,32 @@
+#!/usr/bin/env python
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" native helpers of the server, optional. Clients have them built in, the server
+picks them up when they were built next to pupysh.py:
+
+    python setup.py build_ext --inplace
+
+_pupybrine: rpyc's brine codec, see network/lib/brine.py
+_pupycrypto: AES/HMAC/PBKDF2 of the transports without pycrypto, see
+network/lib/transports/cryptoutils """
+
+import os
+from distutils.core import setup, Extension
+
+ROOT=os.path.abspath(os.path.dirname(__file__))
+SOURCES=os.path.normpath(os.path.join(ROOT, '..', 'client', 'sources' if os.name=='nt' else 'sources-linux'))
+
+setup(
+    name='pupy-native',
+    ext_modules=[
+        Extension('_pupybrine',
+            sources=[os.path.join(SOURCES, '_pupybrine.c')],
+            define_macros=[('STANDALONE', None)],
+        ),
+        Extension('_pupycrypto',
+            sources=[os.path.join(SOURCES, '_pupycrypto.c')],
+            define_macros=[('STANDALONE', None)],
+        ),
+    ],
+)
@@ -0,0 +1,169 @@
+#!/usr/bin/env python
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" throughput of the crypto the transports use without pycrypto: AES-CBC/CTR,
+HMAC-SHA256 and PBKDF2 of the builtin _pupycrypto against pyaes and the pure
+python pbkdf2 (network/lib/transports/cryptoutils). Both are checked against the
+FIPS-197 and SP 800-38A vectors, RFC 4231 and RFC 7914 first. Needs _pupycrypto
+built for this python (python setup.py build_ext --inplace in pupy/), only the
+python versions run otherwise:
+
+    python tests/bench_crypto.py [-s 1048576] [-t 1] """
+
+import os
+import sys
+import hmac
+import time
+import hashlib
+import argparse
+
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..')))
+
+from network.lib.transports import cryptoutils
+from network.lib.transports.cryptoutils import pyaes, pbkdf2
+
+try:
+    import _pupycrypto
+except ImportError:
+    _pupycrypto = None
+
+def unhex(s):
+    return s.replace(' ', '').decode('hex')
+
+# FIPS-197 appendix C: key, plaintext, ciphertext
+FIPS197 = (
+    ('000102030405060708090a0b0c0d0e0f',
+     '00112233445566778899aabbccddeeff', '69c4e0d86a7b0430d8cdb78070b4c55a'),
+    ('000102030405060708090a0b0c0d0e0f1011121314151617',
+     '00112233445566778899aabbccddeeff', 'dda97ca4864cdfe06eaf70a0ec0d7191'),
+    ('000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f',
+     '00112233445566778899aabbccddeeff', '8ea2b7ca516745bfeafc49904b496089'),
+)
+
+# SP 800-38A F.2.1 and F.5.1, AES-128
+SP800_38A_KEY = '2b7e151628aed2a6abf7158809cf4f3c'
+SP800_38A_PLAIN = ('6bc1bee22e409f96e93d7e117393172a ae2d8a571e03ac9c9eb76fac45af8e51 '
+                   '30c81c46a35ce411e5fbc1191a0a52ef f69f2445df4f9b17ad2b417be66c3710')
+SP800_38A_CBC = ('000102030405060708090a0b0c0d0e0f',
+    '7649abac8119b246cee98e9b12e9197d 5086cb9b507219ee95db113a917678b2 '
+    '73bed6b8e3c1743b7116e69e22229516 3ff1caa1681fac09120eca307586e1a7')
+SP800_38A_CTR = ('f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff',
+    '874d6191b620e3261bef6864990db6ce 9806f66b7970fdff8617187bb9fffdff '
+    '5ae4df3edbd5d35e5b4f09020db03eab 1e031dda2fbe03d1792170a0f3009cee')
+
+# RFC 4231 test case 2
+HMAC_SHA256 = ('Jefe', 'what do ya want for nothing?',
+    '5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843')
+
+# RFC 7914 section 11
+PBKDF2_SHA256 = ('passwd', 'salt', 1, 64,
+    '55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc'
+    '49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783')
+
+class PyaesCBC(pyaes.AESModeOfOperationCBC):
+    """ pyaes CBC only takes a single block per call """
+
+    def encrypt(self, data):
+        return ''.join(pyaes.AESModeOfOperationCBC.encrypt(self, data[i:i+16]) for i in xrange(0, len(data), 16))
+
+    def decrypt(self, data):
+        return ''.join(pyaes.AESModeOfOperationCBC.decrypt(self, data[i:i+16]) for i in xrange(0, len(data), 16))
+
+def pyaes_ctr(key, counter):
+    return pyaes.AESModeOfOperationCTR(key, pyaes.Counter(int(counter.encode('hex'), 16)))
+
+def implementations():
+    """ (name, cbc(key, iv), ctr(key, counter block), hmac_sha256, pbkdf2_sha256) """
+    found = [ ('python', PyaesCBC, pyaes_ctr,
+        lambda key, data: hmac.new(key, data, hashlib.sha256).digest(),
+        lambda password, salt, iterations, keylen: pbkdf2.pbkdf2_bin(password, salt, iterations, keylen, hashlib.sha256)) ]
+
+    if _pupycrypto and cryptoutils.NATIVE:
+        found.append(( 'native' + (' (AES-NI)' if _pupycrypto.aesni() else ''),
+            cryptoutils.AESModeOfOperationCBC,
+            lambda key, counter: cryptoutils.AESModeOfOperationCTR(key, int(counter.encode('hex'), 16)),
+            _pupycrypto.hmac_sha256, _pupycrypto.pbkdf2_sha256 ))
+
+    return found
+
+def check(name, what, got, expected):
+    if got != expected:
+        raise AssertionError('{}: {} gives {}, expected {}'.format(name, what, got.encode('hex'), expected.encode('hex')))
+
+def check_vectors(name, cbc, ctr, hmac_sha256, pbkdf2_sha256):
+    for key, plain, cipher in FIPS197:
+        key, plain, cipher = unhex(key), unhex(plain), unhex(cipher)
+        # a single block with a zero IV is the raw cipher
+        check(name, 'FIPS-197 AES-{} encrypt'.format(len(key)*8), cbc(key, '\0'*16).encrypt(plain), cipher)
+        check(name, 'FIPS-197 AES-{} decrypt'.format(len(key)*8), cbc(key, '\0'*16).decrypt(cipher), plain)
+
+    key, plain = unhex(SP800_38A_KEY), unhex(SP800_38A_PLAIN)
+    for mode, new, (iv, cipher) in (('CBC', cbc, SP800_38A_CBC), ('CTR', ctr, SP800_38A_CTR)):
+        iv, cipher = unhex(iv), unhex(cipher)
+        check(name, 'SP 800-38A {} encrypt'.format(mode), new(key, iv).encrypt(plain), cipher)
+        check(name, 'SP 800-38A {} decrypt'.format(mode), new(key, iv).decrypt(cipher), plain)
+
+        # the state carries over between calls, in pieces that don't match the blocks
+        encryptor = new(key, iv)
+        pieces = (16, 32, 16) if mode == 'CBC' else (5, 16, 27, 16)
+        offset, parts = 0, []
+        for size in pieces:
+            parts.append(encryptor.encrypt(plain[offset:offset+size]))
+            offset += size
+        check(name, 'SP 800-38A {} encrypt in pieces'.format(mode), ''.join(parts), cipher)
+
+    key, data, digest = HMAC_SHA256
+    check(name, 'RFC 4231 HMAC-SHA256', hmac_sha256(key, data), unhex(digest))
+
+    password, salt, iterations, keylen, derived = PBKDF2_SHA256
+    check(name, 'RFC 7914 PBKDF2-HMAC-SHA256', pbkdf2_sha256(password, salt, iterations, keylen), unhex(derived))
+
+def rate(func, amount, seconds):
+    """ amount per second of func, run for at least seconds """
+    func()
+    count = 0
+    started = time.time()
+    while True:
+        func()
+        count += 1
+        elapsed = time.time() - started
+        if elapsed >= seconds:
+            return count * amount / elapsed
+
+def bench(name, cbc, ctr, hmac_sha256, pbkdf2_sha256, args):
+    # pure python AES is slow enough for a smaller block to do
+    size = args.size if name != 'python' else min(args.size, 16384)
+    data = os.urandom(size - size % 16)
+    key, iv = os.urandom(32), os.urandom(16)
+    mb = len(data) / float(1 << 20)
+
+    encryptor, decryptor, counter = cbc(key, iv), cbc(key, iv), ctr(key, iv)
+    print '{}:'.format(name)
+    print '  AES-256-CBC encrypt  {:10.2f} MB/s'.format(rate(lambda: encryptor.encrypt(data), mb, args.time))
+    print '  AES-256-CBC decrypt  {:10.2f} MB/s'.format(rate(lambda: decryptor.decrypt(data), mb, args.time))
+    print '  AES-256-CTR          {:10.2f} MB/s'.format(rate(lambda: counter.encrypt(data), mb, args.time))
+    print '  HMAC-SHA256          {:10.2f} MB/s'.format(rate(lambda: hmac_sha256(key, data), mb, args.time))
+    print '  HMAC-SHA256 64 bytes {:10.0f} /s'.format(rate(lambda: hmac_sha256(key, data[:64]), 1, args.time))
+    iterations = 10000 if name != 'python' else 1000
+    print '  PBKDF2-HMAC-SHA256   {:10.0f} iterations/s'.format(
+        rate(lambda: pbkdf2_sha256('password', 'salt', iterations, 32), iterations, args.time))
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('-s', '--size', type=int, default=1 << 20, help='bytes per call')
+    parser.add_argument('-t', '--time', type=float, default=1, help='seconds per measure')
+    args = parser.parse_args()
+
+    found = implementations()
+    for implementation in found:
+        check_vectors(*implementation)
+    print 'known answers: {} ok'.format(', '.join(name for name, _, _, _, _ in found))
+    if len(found) == 1:
+        print '_pupycrypto is not built, python only'
+
+    for implementation in found:
+        bench(*(implementation + (args,)))
+
+if __name__ == '__main__':
+    main()
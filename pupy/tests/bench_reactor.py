@@ -0,0 +1,187 @@
+#!/usr/bin/env python
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" load benchmark of the session serving of PupyTCPServer. Loopback clients send one
+rpyc sized frame per round and wait for it to come back, sessions are served by the
+reactor (network/lib/reactor.py) or by a thread each like the threaded mode. rpyc's
+dispatch is replaced by an echo, what is measured is the transport and scheduling.
+The clients run in a child process, the server has its own file descriptors as it
+would with real sessions:
+
+    python tests/bench_reactor.py [-n 1000] [-r 20] [--threads] """
+
+import os
+import sys
+import time
+import struct
+import socket
+import argparse
+import threading
+import resource
+
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..')))
+
+from rpyc.core import Channel
+from network.lib import reactor
+from network.lib.streams.PupySocketStream import PupySocketStream
+from network.lib.transports.dummy import DummyPupyTransport
+
+class EchoConnection(object):
+    """ what the reactor needs from a PupyConnection, serve() sends every frame back """
+
+    def __init__(self, stream):
+        self.stream = stream
+        self.closed = False
+        self._connection_serve_lock = threading.RLock()
+        self._serve_released = None
+
+    def serve(self, timeout):
+        if not self.stream.poll(timeout):
+            return False
+        header = self.stream.read(Channel.FRAME_HEADER.size)
+        length, _ = Channel.FRAME_HEADER.unpack(header)
+        self.stream.write(header + self.stream.read(length + len(Channel.FLUSHER)))
+        return True
+
+    def close(self):
+        self.closed = True
+        self.stream.close()
+
+class Server(object):
+    def __init__(self, sock, threaded, reactor_threads, workers):
+        self.sock = sock
+        self.threaded = threaded
+        self.sessions = 0
+        self.closed = 0
+        self.failed = 0
+        self.max_threads = 0
+        self.lock = threading.Lock()
+        if not threaded:
+            self.reactor = reactor.PupyReactor(reactor_threads, workers)
+            self.stream_class = reactor.reactor_stream(PupySocketStream)
+
+        t = threading.Thread(target=self._accept)
+        t.daemon = True
+        t.start()
+
+    def _on_close(self, failed=False):
+        with self.lock:
+            self.closed += 1
+            self.failed += failed
+
+    def _accept(self):
+        while True:
+            sock, _ = self.sock.accept()
+            self.sessions += 1
+            if self.threaded:
+                t = threading.Thread(target=self._serve, args=(sock,))
+                t.daemon = True
+                t.start()
+            else:
+                stream = self.stream_class(sock, DummyPupyTransport, {})
+                self.reactor.register(stream, EchoConnection(stream), on_close=self._on_close)
+            self.max_threads = max(self.max_threads, threading.active_count())
+
+    def _serve(self, sock):
+        connection = EchoConnection(PupySocketStream(sock, DummyPupyTransport, {}))
+        try:
+            while True:
+                connection.serve(10)
+        except EOFError:
+            self._on_close()
+        except Exception:
+            # select() in the threaded mode can't poll descriptors above FD_SETSIZE
+            self._on_close(failed=True)
+            sock.close()
+
+def recv_frame(client, size):
+    data = ''
+    while len(data) < size:
+        chunk = client.recv(size - len(data))
+        if not chunk:
+            raise EOFError()
+        data += chunk
+    return data
+
+def run_clients(port, args):
+    header = struct.Struct('!LB') # rpyc's Channel.FRAME_HEADER, the echo doesn't look inside
+    started = time.time()
+    clients = [ socket.create_connection(('127.0.0.1', port)) for _ in xrange(args.clients) ]
+    print '{} clients connected in {:.2f}s'.format(args.clients, time.time() - started)
+
+    frames = dict((client, header.pack(args.size, 1) + ('%*d' % (args.size, i))[:args.size] + '\n')
+        for i, client in enumerate(clients))
+    lost = set()
+    rounds = []
+    messages = 0
+    started = time.time()
+    for _ in xrange(args.rounds):
+        round_started = time.time()
+        for client in clients:
+            try:
+                client.sendall(frames[client])
+            except socket.error:
+                lost.add(client)
+        for client in clients:
+            if client in lost:
+                continue
+            try:
+                assert recv_frame(client, len(frames[client])) == frames[client]
+                messages += 1
+            except (EOFError, socket.error):
+                lost.add(client)
+        clients = [ client for client in clients if client not in lost ]
+        rounds.append(time.time() - round_started)
+
+    elapsed = time.time() - started
+    rounds.sort()
+    print '{} frames in {:.2f}s: {:.0f} frames/s, round p50 {:.1f}ms, max {:.1f}ms, {} sessions lost'.format(
+        messages, elapsed, messages / elapsed, rounds[len(rounds)//2]*1000, rounds[-1]*1000, len(lost))
+
+    for client in clients:
+        client.close()
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('-n', '--clients', type=int, default=1000)
+    parser.add_argument('-r', '--rounds', type=int, default=20)
+    parser.add_argument('-s', '--size', type=int, default=100, help='frame payload size')
+    parser.add_argument('--threads', action='store_true', help='a thread per session instead of the reactor')
+    parser.add_argument('--reactor-threads', type=int, default=1)
+    parser.add_argument('--workers', type=int, default=16)
+    args = parser.parse_args()
+
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if soft < args.clients + 64:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (min(args.clients + 64, hard), hard))
+
+    sock = socket.socket()
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(('127.0.0.1', 0))
+    sock.listen(4096)
+    port = sock.getsockname()[1]
+
+    # before any thread is started
+    pid = os.fork()
+    if not pid:
+        sock.close()
+        try:
+            run_clients(port, args)
+        finally:
+            sys.stdout.flush()
+            os._exit(0)
+
+    server = Server(sock, args.threads, args.reactor_threads, args.workers)
+    os.waitpid(pid, 0)
+
+    deadline = time.time() + 10
+    while server.closed < server.sessions and time.time() < deadline:
+        time.sleep(0.1)
+
+    print 'server: {} sessions, {} closed, {} failed, {} threads at most, max RSS {:.1f}MB'.format(
+        server.sessions, server.closed, server.failed, server.max_threads,
+        resource.getrusage(resource.RUSAGE_SELF).ru_maxrss / 1024.)
+
+if __name__ == '__main__':
+    main()
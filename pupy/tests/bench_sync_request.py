@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" latency benchmark of the sync requests of PupyConnection (network/lib/servers.py):
+netref attribute reads over a loopback connection, one round trip each. With several
+threads they share the connection, one of them reads it and wakes the others when
+their replies are in. --rpyc measures rpyc's own Connection instead:
+
+    python tests/bench_sync_request.py [-n 20000] [-t 1] [--rpyc] """
+
+import os
+import sys
+import time
+import socket
+import argparse
+import threading
+
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..')))
+
+from rpyc.core import Channel, Connection, Service
+from network.lib.servers import PupyConnection
+from network.lib.streams.PupySocketStream import PupySocketStream
+from network.lib.transports.dummy import DummyPupyTransport
+
+class Target(object):
+    value = 42
+
+class TargetService(Service):
+    """ the client side, what the server reads """
+    def exposed_target(self):
+        return Target()
+
+def connect(args):
+    listener = socket.socket()
+    listener.bind(('127.0.0.1', 0))
+    listener.listen(1)
+    client = socket.create_connection(listener.getsockname())
+    server, _ = listener.accept()
+    listener.close()
+    for sock in (client, server):
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    peer = Connection(TargetService, Channel(PupySocketStream(client, DummyPupyTransport, {})),
+        config=dict(allow_public_attrs=True))
+    t = threading.Thread(target=peer.serve_all)
+    t.daemon = True
+    t.start()
+
+    channel = Channel(PupySocketStream(server, DummyPupyTransport, {}))
+    if args.rpyc:
+        return Connection(Service, channel)
+
+    connection = PupyConnection(threading.RLock(), Service, channel, _lazy=True)
+    connection._init_service()
+    return connection
+
+def run(target, count, samples):
+    for _ in xrange(count):
+        started = time.time()
+        target.value
+        samples.append(time.time() - started)
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('-n', '--requests', type=int, default=20000)
+    parser.add_argument('-t', '--threads', type=int, default=1, help='threads sharing the connection')
+    parser.add_argument('--rpyc', action='store_true', help="rpyc's Connection instead of PupyConnection")
+    args = parser.parse_args()
+
+    connection = connect(args)
+    target = connection.root.target
+    run(target, 100, []) # warm up
+
+    samples = [ [] for _ in xrange(args.threads) ]
+    threads = [ threading.Thread(target=run, args=(target, args.requests // args.threads, s)) for s in samples ]
+    started = time.time()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.time() - started
+
+    samples = sorted(sum(samples, []))
+    def percentile(p):
+        return samples[min(int(len(samples) * p), len(samples) - 1)] * 1000000
+
+    print '{}, {} thread(s): {} round trips in {:.2f}s, {:.0f}/s'.format(
+        'rpyc' if args.rpyc else 'PupyConnection', args.threads, len(samples), elapsed, len(samples) / elapsed)
+    print 'latency: p50 {:.0f}us, p90 {:.0f}us, p99 {:.0f}us, max {:.0f}us'.format(
+        percentile(0.5), percentile(0.9), percentile(0.99), samples[-1] * 1000000)
+
+    connection.close()
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,150 @@
+#!/usr/bin/env python
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" load benchmark of the ingress of PupyUDPServer (network/lib/udpingress.py and the
+session queues of network/lib/servers.py). Loopback peers each send a timestamped
+datagram per round and wait for it to come back, the sessions echo it from their
+workers: packets/s and latency percentiles. With --slow one more peer sends 100
+datagrams/s, each taking 50ms of transport work, and must not stall the others.
+The peers run in a child process:
+
+    python tests/bench_udp.py [-p 300] [-r 20] [--slow] [--shards 1] [--recvfrom] """
+
+import os
+import sys
+import time
+import struct
+import socket
+import argparse
+import threading
+import resource
+
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..')))
+
+from network.lib import servers, udpingress
+from network.lib.buffer import Buffer
+
+STAMP = struct.Struct('d')
+SLOW = 'slow'
+
+class EchoStream(object):
+    """ what PupyUDPServer needs from a session stream, the transport sends back what
+    it is given. What the slow peer sends takes 50ms """
+
+    def __init__(self, sock, transport_class, transport_kwargs, client_side=True):
+        self.sock, self.addr = sock
+        self.downstream_lock = threading.Lock()
+        self.buf_in = Buffer()
+        self.transport = self
+        self.closed = False
+
+    def downstream_recv(self, data):
+        data = data.read()
+        if data.startswith(SLOW):
+            time.sleep(0.05)
+        try:
+            self.sock.sendto(data, self.addr)
+        except socket.error:
+            # closed with the server, the slow peer's datagrams may still be queued
+            pass
+
+    def close(self):
+        self.closed = True
+
+def run_peers(port, args):
+    peers = []
+    for _ in xrange(args.peers):
+        peer = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        peer.settimeout(1)
+        peer.connect(('127.0.0.1', port))
+        peers.append(peer)
+
+    done = threading.Event()
+    if args.slow:
+        slow = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        slow.connect(('127.0.0.1', port))
+        def send_slow():
+            while not done.is_set():
+                slow.send(SLOW)
+                time.sleep(0.01)
+        t = threading.Thread(target=send_slow)
+        t.daemon = True
+        t.start()
+
+    payload = 'x' * args.size
+    latencies = []
+    lost = 0
+    started = time.time()
+    for _ in xrange(args.rounds):
+        for peer in peers:
+            peer.send(STAMP.pack(time.time()) + payload)
+        for peer in peers:
+            try:
+                data = peer.recv(65536)
+            except socket.timeout:
+                lost += 1
+                continue
+            latencies.append(time.time() - STAMP.unpack_from(data)[0])
+
+    elapsed = time.time() - started
+    done.set()
+
+    latencies.sort()
+    count = len(latencies)
+    def percentile(p):
+        return latencies[min(int(count * p), count - 1)] * 1000 if count else 0
+
+    print '{} peers{}: {:.0f} pkt/s echoed, latency p50 {:.2f}ms p99 {:.2f}ms p99.9 {:.2f}ms max {:.2f}ms, {} lost'.format(
+        args.peers, ' and a slow one' if args.slow else '', count / elapsed,
+        percentile(0.5), percentile(0.99), percentile(0.999), percentile(1), lost)
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('-p', '--peers', type=int, default=300)
+    parser.add_argument('-r', '--rounds', type=int, default=20)
+    parser.add_argument('-s', '--size', type=int, default=100, help='datagram payload size')
+    parser.add_argument('--slow', action='store_true', help='add a peer whose datagrams take 50ms each')
+    parser.add_argument('--shards', type=int, default=1)
+    parser.add_argument('--workers', type=int, default=8)
+    parser.add_argument('--recvfrom', action='store_true', help='recvfrom instead of recvmmsg')
+    args = parser.parse_args()
+
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if soft < args.peers + 64:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (min(args.peers + 64, hard), hard))
+
+    # before any thread is started, the port comes through the pipe
+    ready, notify = os.pipe()
+    pid = os.fork()
+    if not pid:
+        os.close(notify)
+        try:
+            run_peers(int(os.read(ready, 16)), args)
+        finally:
+            sys.stdout.flush()
+            os._exit(0)
+    os.close(ready)
+
+    if args.recvfrom:
+        udpingress.NATIVE = False
+
+    server = servers.PupyUDPServer(None, stream=EchoStream, transport=None, transport_kwargs={},
+        hostname='127.0.0.1', port=0, shards=args.shards, workers=args.workers)
+    server.listen()
+    server.active = True
+    receivers = [ threading.Thread(target=server._receive_loop, args=(sock,)) for sock in server.sockets ]
+    for t in receivers:
+        t.daemon = True
+        t.start()
+
+    os.write(notify, str(server.sock.getsockname()[1]))
+    os.waitpid(pid, 0)
+    server.close()
+
+    # quiet at exit
+    for t in receivers + server.workers.threads:
+        t.join(1)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,152 @@
+#!/usr/bin/env python
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" the native brine codec against rpyc's: same bytes for random nested objects, same
+objects back, same errors. Needs _pupybrine built for this python (python setup.py
+build_ext --inplace in pupy/), it is skipped otherwise:
+
+    python tests/test_brine.py [-v] """
+
+import os
+import sys
+import imp
+import random
+import unittest
+
+ROOT=os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
+sys.path.insert(0, ROOT)
+
+from rpyc.core import brine
+
+try:
+    import _pupybrine
+except ImportError:
+    _pupybrine = None
+
+ROUNDS=10000
+SEED=int(os.environ.get('BRINE_SEED', 1234))
+
+def random_int(rng):
+    return rng.choice((
+        lambda: rng.randint(-0x30, 0x9f),
+        lambda: rng.randint(-2**31, 2**31-1),
+        lambda: rng.randint(-sys.maxint-1, sys.maxint),
+        lambda: long(rng.randint(-1000, 1000)),
+        lambda: rng.randint(-2**200, 2**200),
+    ))()
+
+def random_bytes(rng, size):
+    return ('%0*x' % (size*2, rng.getrandbits(size*8))).decode('hex') if size else ''
+
+def random_str(rng):
+    return random_bytes(rng, rng.choice((0, 1, 2, 3, 4, 5, rng.randint(6, 255), rng.randint(256, 5000))))
+
+def random_unicode(rng):
+    size=rng.choice((0, 1, 4, rng.randint(5, 300)))
+    return u''.join(unichr(rng.choice((rng.randint(0x20, 0x7e), rng.randint(0xa0, 0xd7ff)))) for _ in xrange(size))
+
+def random_scalar(rng):
+    return rng.choice((
+        lambda: None, lambda: True, lambda: False,
+        lambda: NotImplemented, lambda: Ellipsis,
+        lambda: random_int(rng),
+        lambda: random_str(rng),
+        lambda: random_unicode(rng),
+        lambda: rng.uniform(-1e300, 1e300),
+        lambda: rng.choice((0.0, -0.0, 1e-310, float('inf'), float('-inf'))),
+        lambda: complex(rng.uniform(-1e10, 1e10), rng.uniform(-1e10, 1e10)),
+    ))()
+
+def random_object(rng, depth=0):
+    if depth > 4 or rng.random() < 0.4:
+        return random_scalar(rng)
+
+    kind=rng.randint(0, 3)
+    if kind == 0:
+        size=rng.choice((0, 1, 2, 3, 4, 5, rng.randint(6, 16)))
+        if rng.random() < 0.05:
+            # long tuples, flat or it never ends
+            return tuple(random_scalar(rng) for _ in xrange(rng.choice((255, 256, 300))))
+        return tuple(random_object(rng, depth+1) for _ in xrange(size))
+    elif kind == 1:
+        return frozenset(random_int(rng) if rng.random() < 0.5 else random_str(rng) for _ in xrange(rng.randint(0, 10)))
+    elif kind == 2:
+        return slice(*(rng.choice((None, random_int(rng))) for _ in xrange(3)))
+    return random_scalar(rng)
+
+class Undumpable(object):
+    pass
+
+@unittest.skipIf(_pupybrine is None, '_pupybrine is not built')
+class BrineCompatibility(unittest.TestCase):
+    def assertSameObject(self, first, second):
+        # the bytes are compared too: 0.0 == -0.0, 1 == 1L, True == 1
+        self.assertEqual(first, second)
+        self.assertEqual(brine.dump(first), brine.dump(second))
+
+    def test_random_roundtrip(self):
+        rng=random.Random(SEED)
+        for i in xrange(ROUNDS):
+            obj=random_object(rng)
+            data=brine.dump(obj)
+            self.assertEqual(_pupybrine.dump(obj), data, 'round {} (seed {}): {!r}'.format(i, SEED, obj))
+            self.assertSameObject(_pupybrine.load(data), brine.load(data))
+            self.assertTrue(_pupybrine.dumpable(obj))
+
+    def test_edges(self):
+        for obj in (0x9f, 0xa0, -0x30, -0x31, 2**31, -2**31-1, 2**63, -2**63-1,
+                    'x'*255, 'x'*256, u'€'*300, tuple(range(255)), tuple(range(256)),
+                    slice(None), frozenset(), (((((),),),),)):
+            data=brine.dump(obj)
+            self.assertEqual(_pupybrine.dump(obj), data, repr(obj))
+            self.assertSameObject(_pupybrine.load(data), obj)
+
+    def test_undumpable(self):
+        for obj in (Undumpable(), [1], {1: 2}, set([1]), (1, [2]), frozenset([(1, Undumpable())]),
+                    slice(1, [2]), type, True.__class__, bytearray('a')):
+            self.assertEqual(_pupybrine.dumpable(obj), brine.dumpable(obj), repr(obj))
+            self.assertRaises(TypeError, brine.dump, obj)
+            self.assertRaises(TypeError, _pupybrine.dump, obj)
+
+    def test_subclasses(self):
+        # brine dispatches on the exact type
+        class Int(int): pass
+        class Str(str): pass
+        class Tuple(tuple): pass
+        for obj in (Int(1), Str('a'), Tuple((1,))):
+            self.assertFalse(_pupybrine.dumpable(obj))
+            self.assertRaises(TypeError, _pupybrine.dump, obj)
+
+    def test_malformed(self):
+        rng=random.Random(SEED)
+        for i in xrange(ROUNDS):
+            data=brine.dump(random_object(rng))
+            cut=data[:rng.randint(0, len(data)-1)] if len(data) > 1 else ''
+            try:
+                _pupybrine.load(cut)
+            except Exception:
+                pass
+
+            garbage=random_bytes(rng, rng.randint(0, 32))
+            try:
+                _pupybrine.load(garbage)
+            except Exception:
+                pass
+
+        for data in ('', '\x0f\xff\xff\xff\xff', '\x15\xff\xff\xff\xff', '\x07', '\x19\x02'):
+            self.assertRaises(Exception, _pupybrine.load, data)
+
+    def test_install(self):
+        saved=brine.dump, brine.load, brine.dumpable
+        try:
+            # without network.lib and the transports it imports, installs on import
+            pupybrine=imp.load_source('pupybrine', os.path.join(ROOT, 'network', 'lib', 'brine.py'))
+            self.assertTrue(pupybrine.NATIVE)
+            self.assertTrue(brine.dump is _pupybrine.dump)
+        finally:
+            # the other tests compare with rpyc's own codec
+            brine.dump, brine.load, brine.dumpable=saved
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,187 @@
+#!/usr/bin/env python
+# -*- coding: UTF8 -*-
+# Pupy is under the BSD 3-Clause license. see the LICENSE file at the root of the project for the detailed licence terms
+
+""" ReliableTransport (network/lib/transports/reliable.py) between two endpoints joined
+in process by a shim that drops, delays and reorders their packets: what is written on
+one side comes out whole and in order on the other, a single loss in a parity group is
+repaired without a retransmit. -v prints the transport stats of every case:
+
+    python tests/test_reliable.py [-v] """
+
+import os
+import sys
+import time
+import heapq
+import random
+import threading
+import unittest
+
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..')))
+
+from network.lib.buffer import Buffer
+from network.lib.transports.reliable import ReliableTransport, HEADER, PACKET_DATA, FLAG_PROTECTED, TICKER, TICK
+
+SEED=int(os.environ.get('RELIABLE_SEED', 1234))
+DEADLINE=60 # seconds for a transfer to complete
+
+class Shim(object):
+    """ the link: every packet a transport writes is lost with probability loss, or
+    delivered after delay +- jitter, in the order of the delivery times. drop(src, f)
+    loses the packets of src for which f(kind, flags, seq) is true """
+
+    def __init__(self, rng, loss=0.0, delay=0.0, jitter=0.0):
+        self.rng=rng
+        self.loss=loss
+        self.delay=delay
+        self.jitter=jitter
+        self.filters={}
+        self.packets=[]
+        self.sent=0
+        self.dropped=0
+        self.cond=threading.Condition()
+        self.active=True
+        self.thread=threading.Thread(target=self._deliver)
+        self.thread.daemon=True
+        self.thread.start()
+
+    def connect(self, a, b):
+        a.downstream=Buffer(on_write=lambda: self._send(a, b))
+        b.downstream=Buffer(on_write=lambda: self._send(b, a))
+
+    def drop(self, src, func):
+        self.filters[src]=func
+
+    def _send(self, src, dst):
+        # the transport writes a single packet at a time
+        packet=src.downstream.read()
+        kind, flags, _, seq, _=HEADER.unpack_from(packet)
+        with self.cond:
+            self.sent+=1
+            func=self.filters.get(src)
+            if ( func and func(kind, flags, seq) ) or self.rng.random() < self.loss:
+                self.dropped+=1
+                return
+
+            due=time.time()+max(self.delay+self.rng.uniform(-self.jitter, self.jitter), 0)
+            heapq.heappush(self.packets, (due, self.sent, dst, packet))
+            self.cond.notify()
+
+    def _deliver(self):
+        while True:
+            with self.cond:
+                while self.active and not self.packets:
+                    self.cond.wait()
+                if not self.active:
+                    return
+
+                due, _, dst, packet=self.packets[0]
+                now=time.time()
+                if due > now:
+                    self.cond.wait(due-now)
+                    continue
+                heapq.heappop(self.packets)
+
+            dst.downstream_recv(Buffer(packet))
+
+    def close(self):
+        with self.cond:
+            self.active=False
+            self.cond.notify()
+        self.thread.join()
+
+def tearDownModule():
+    # the closed transports leave the ticker, let it go idle before the interpreter exits
+    while TICKER.active.is_set():
+        time.sleep(TICK)
+
+class ReliableOverShim(unittest.TestCase):
+    def setUp(self):
+        self.rng=random.Random(SEED)
+
+    def link(self, loss=0.0, delay=0.0, jitter=0.0, **kwargs):
+        self.shim=Shim(self.rng, loss, delay, jitter)
+        self.a=ReliableTransport(None, **kwargs)
+        self.b=ReliableTransport(None, **kwargs)
+        self.shim.connect(self.a, self.b)
+        self.addCleanup(self._unlink)
+
+    def _unlink(self):
+        self.shim.close()
+        self.a.on_close()
+        self.b.on_close()
+        if '-v' in sys.argv:
+            print '\n  {}: {} packets, {} dropped\n  a: {}\n  b: {}'.format(
+                self.id().rsplit('.', 1)[-1], self.shim.sent, self.shim.dropped, self.a.stats, self.b.stats)
+
+    def transfer(self, size, src=None, dst=None):
+        """ write size random bytes in random pieces, return what dst received """
+        src=src or self.a
+        dst=dst or self.b
+        data=('%0*x' % (size*2, self.rng.getrandbits(size*8))).decode('hex')
+        offset=0
+        while offset < len(data):
+            piece=self.rng.randint(1, 8000)
+            src.upstream_recv(Buffer(data[offset:offset+piece]))
+            offset+=piece
+
+        received=[]
+        length=0
+        deadline=time.time()+DEADLINE
+        while length < size and time.time() < deadline:
+            if dst.upstream.wait(0.1):
+                chunk=dst.upstream.read()
+                received.append(chunk)
+                length+=len(chunk)
+
+        received=''.join(received)
+        self.assertEqual(len(received), size, 'got {} of {} bytes'.format(len(received), size))
+        self.assertTrue(received == data, 'corrupted or out of order')
+        return received
+
+    def test_lossless(self):
+        self.link(delay=0.005)
+        self.transfer(200000)
+        self.assertEqual(self.a.stats['retransmitted'], 0)
+
+    def test_reordering(self):
+        # no loss, but packets overtake each other
+        self.link(delay=0.02, jitter=0.02)
+        self.transfer(200000)
+
+    def test_loss(self):
+        self.link(loss=0.05, delay=0.01, jitter=0.005)
+        self.transfer(300000)
+        self.assertTrue(self.shim.dropped)
+        self.assertTrue(self.a.stats['retransmitted'])
+
+    def test_heavy_loss(self):
+        self.link(loss=0.2, delay=0.01, jitter=0.01)
+        self.transfer(50000)
+
+    def test_both_ways(self):
+        self.link(loss=0.05, delay=0.01, jitter=0.005)
+        self.transfer(50000, self.a, self.b)
+        self.transfer(50000, self.b, self.a)
+
+    def test_fec_repair(self):
+        # a large RTO: whatever arrives was repaired, not sent again
+        self.link(delay=0.01, fec=4, mss=100)
+        self.a.rto=5.0
+        lost=set()
+        def first_protected(kind, flags, seq):
+            if kind == PACKET_DATA and flags & FLAG_PROTECTED and seq == 1 and seq not in lost:
+                lost.add(seq)
+                return True
+            return False
+        self.shim.drop(self.a, first_protected)
+
+        started=time.time()
+        self.transfer(300, src=self.a, dst=self.b) # a group of small segments
+        self.assertTrue(lost)
+        self.assertEqual(self.b.stats['repaired'], 1)
+        self.assertEqual(self.a.stats['retransmitted'], 0)
+        self.assertTrue(time.time()-started < 1)
+
+if __name__ == '__main__':
+    unittest.main()